@@ -1,180 +1,258 @@
 #include "esp_log.h"
-#include "esp_private/i2c_platform.h"
-#include "driver/i2c_master.h"
+#include "driver/gpio.h"
 
 #include "cat9555.h"
 #include "i2c_user.h"
 
 static const char *TAG = "CAT";
 
-esp_err_t initlizeCat(cat_state_t *dev, uint8_t address, i2c_port_num_t i2c_port)
+static void cat_on_write(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx)
 {
-    if ((address <= 0b0100111) && (address >= 0b0100000))
-    {
-        dev->dev_address = address;
-    }
-    else
+    cat_state_t *dev = (cat_state_t *)ctx;
+
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Invalid address (%02x)", address);
-        return ESP_FAIL;
+        ESP_LOGE(TAG, "I2C Transaction failed");
+        // the device no longer matches the shadow, rewrite everything on the next sync
+        dev->write_failed = true;
     }
+    dev->writes_done++;
+}
 
-    dev->mutex = xSemaphoreCreateMutex();
-    if (dev->mutex == NULL)
+// queue a write of one register pair, only the ports that differ from the device are sent
+static esp_err_t cat_write_register(cat_state_t *dev, cat_command_t reg_0, uint16_t value, uint16_t *written)
+{
+    uint16_t changed = value ^ *written;
+    if (changed == 0)
     {
-        ESP_LOGE(TAG, "Failed to create Mutex");
-        return ESP_FAIL;
+        return ESP_OK;
     }
-    xSemaphoreTake(dev->mutex, portMAX_DELAY);
 
-    i2c_device_config_t dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = dev->dev_address,
-        .scl_speed_hz = 400000,
+    i2c_user_transaction_t transaction = {
+        .dev = dev->i2c_dev,
+        .callback = cat_on_write,
+        .ctx = dev,
     };
 
-    i2c_master_bus_handle_t bus_handle;
-    esp_err_t err = i2c_master_get_bus_handle(i2c_port, &bus_handle);
-    if (err != ESP_OK)
+    if ((changed & 0x00ff) && (changed & 0xff00))
     {
-        ESP_LOGE(TAG, "Failed to get I2C Bus handle");
-        return err;
+        // the register pointer auto-increments within a pair
+        transaction.tx[0] = reg_0;
+        transaction.tx[1] = value & 0xff;
+        transaction.tx[2] = value >> 8;
+        transaction.tx_len = 3;
     }
-
-    err = i2c_master_probe(bus_handle, address, I2C_USER_TIMEOUT_MS);
-    if (err != ESP_OK)
+    else if (changed & 0x00ff)
     {
-        ESP_LOGE(TAG, "Cannot find device at address %02x", address);
-        return err;
+        transaction.tx[0] = reg_0;
+        transaction.tx[1] = value & 0xff;
+        transaction.tx_len = 2;
     }
-
-    err = i2c_master_bus_add_device(bus_handle, &dev_cfg, &(dev->i2c_dev));
-    if (err != ESP_OK)
+    else
     {
-        ESP_LOGE(TAG, "Failed to register I2C device");
-        return err;
+        transaction.tx[0] = reg_0 + 1;
+        transaction.tx[1] = value >> 8;
+        transaction.tx_len = 2;
     }
 
-    // TODO do this more elegantly
-    uint8_t tx_buffer[3];
-    tx_buffer[0] = CAT_CMD_CONFIG_0;
-    tx_buffer[1] = 0x00;
-    tx_buffer[2] = 0x00;
-    i2c_master_transmit(dev->i2c_dev, tx_buffer, 3, I2C_USER_TIMEOUT_MS);
-    tx_buffer[0] = CAT_CMD_POLARITY_0;
-    i2c_master_transmit(dev->i2c_dev, tx_buffer, 3, I2C_USER_TIMEOUT_MS);
-    tx_buffer[0] = CAT_CMD_OUTPUT_0;
-    i2c_master_transmit(dev->i2c_dev, tx_buffer, 3, I2C_USER_TIMEOUT_MS);
-
-    ESP_LOGI(TAG, "Initilized device");
-
-    xSemaphoreGive(dev->mutex);
+    ESP_LOGD(TAG, "Write %02x: %04x", reg_0, value);
 
-    return ESP_OK;
+    esp_err_t ret = i2c_user_submit(&transaction);
+    if (ret == ESP_OK)
+    {
+        *written = value;
+        dev->writes_queued++;
+    }
+    return ret;
 }
 
-esp_err_t setDirection(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_direction_t dir)
+// bring the device in line with the shadow registers, called with the mutex held
+static esp_err_t cat_sync(cat_state_t *dev)
 {
-    xSemaphoreTake(dev->mutex, portMAX_DELAY);
-
-    dev->directions[port * 8 + pin] = dir;
+    if (dev->transaction_depth > 0)
+    {
+        return ESP_OK;
+    }
 
-    uint8_t tx_buffer[2];
+    if (dev->write_failed)
+    {
+        dev->write_failed = false;
+        dev->output_written = ~dev->output;
+        dev->polarity_written = ~dev->polarity;
+        dev->config_written = ~dev->config;
+    }
 
-    if (port == CAT_PORT_0)
+    // outputs first so pins switched to output start at the intended level
+    esp_err_t ret = cat_write_register(dev, CAT_CMD_OUTPUT_0, dev->output, &dev->output_written);
+    if (ret == ESP_OK)
     {
-        tx_buffer[0] = CAT_CMD_CONFIG_0;
+        ret = cat_write_register(dev, CAT_CMD_POLARITY_0, dev->polarity, &dev->polarity_written);
     }
-    else
+    if (ret == ESP_OK)
     {
-        tx_buffer[0] = CAT_CMD_CONFIG_1;
+        ret = cat_write_register(dev, CAT_CMD_CONFIG_0, dev->config, &dev->config_written);
     }
 
-    tx_buffer[1] = 0x00;
-    for (uint8_t lpin = 0; lpin <= 7; lpin++)
+    return ret;
+}
+
+// gives up with ESP_ERR_TIMEOUT if the device lock is not free within wait
+static esp_err_t cat_try_modify(cat_state_t *dev, uint16_t *reg, uint16_t clear, uint16_t set, uint16_t toggle, TickType_t wait)
+{
+    if (xSemaphoreTakeRecursive(dev->mutex, wait) != pdTRUE)
     {
-        uint8_t bit = dev->directions[port * 8 + lpin] == CAT_DIR_INPUT ? 1 : 0;
-        tx_buffer[1] |= bit << lpin;
+        return ESP_ERR_TIMEOUT;
     }
 
-    ESP_LOGD(TAG, "Direction: %04x %04x", tx_buffer[0], tx_buffer[1]);
+    *reg = ((*reg & ~clear) | set) ^ toggle;
+    esp_err_t ret = cat_sync(dev);
 
-    esp_err_t ret = i2c_master_transmit(dev->i2c_dev, tx_buffer, 2, I2C_USER_TIMEOUT_MS);
-
-    xSemaphoreGive(dev->mutex);
+    xSemaphoreGiveRecursive(dev->mutex);
 
     return ret;
 }
 
-esp_err_t setPolarity(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_polarity_t pol)
+static esp_err_t cat_modify(cat_state_t *dev, uint16_t *reg, uint16_t clear, uint16_t set, uint16_t toggle)
 {
-    xSemaphoreTake(dev->mutex, portMAX_DELAY);
-
-    dev->polarities[port * 8 + pin] = pol;
-
-    uint8_t tx_buffer[2];
+    return cat_try_modify(dev, reg, clear, set, toggle, portMAX_DELAY);
+}
 
-    if (port == CAT_PORT_0)
+esp_err_t initlizeCat(cat_state_t *dev, uint8_t address)
+{
+    if ((address <= 0b0100111) && (address >= 0b0100000))
     {
-        tx_buffer[0] = CAT_CMD_POLARITY_0;
+        dev->dev_address = address;
     }
     else
     {
-        tx_buffer[0] = CAT_CMD_POLARITY_1;
+        ESP_LOGE(TAG, "Invalid address (%02x)", address);
+        return ESP_FAIL;
     }
 
-    tx_buffer[1] = 0x00;
-    for (uint8_t lpin = 0; lpin <= 7; lpin++)
+    dev->mutex = xSemaphoreCreateRecursiveMutex();
+    if (dev->mutex == NULL)
     {
-        uint8_t bit = dev->polarities[port * 8 + lpin] == CAT_POLARITY_NORMAL ? 1 : 0;
-        tx_buffer[1] |= bit << lpin;
+        ESP_LOGE(TAG, "Failed to create Mutex");
+        return ESP_FAIL;
     }
+    xSemaphoreTakeRecursive(dev->mutex, portMAX_DELAY);
 
-    ESP_LOGD(TAG, "Polarity: %04x %04x", tx_buffer[0], tx_buffer[1]);
+    esp_err_t err = i2c_user_add_device(dev->dev_address, 400000, &(dev->i2c_dev));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register I2C device");
+        xSemaphoreGiveRecursive(dev->mutex);
+        return err;
+    }
 
-    esp_err_t ret = i2c_master_transmit(dev->i2c_dev, tx_buffer, 2, I2C_USER_TIMEOUT_MS);
+    // all pins outputs, low and not inverted
+    dev->output = 0x0000;
+    dev->polarity = 0x0000;
+    dev->config = 0x0000;
+    dev->write_failed = true;
+    dev->writes_queued = 0;
+    dev->writes_done = 0;
+    dev->transaction_depth = 0;
+    dev->int_pin = -1;
+    dev->input = 0;
+    dev->input_valid = false;
+    dev->input_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    dev->subscription_count = 0;
+    err = cat_sync(dev);
 
-    xSemaphoreGive(dev->mutex);
+    ESP_LOGI(TAG, "Initilized device");
 
-    return ret;
+    xSemaphoreGiveRecursive(dev->mutex);
+
+    return err;
 }
 
-esp_err_t setLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_level_t level)
+esp_err_t catBeginTransaction(cat_state_t *dev)
 {
-    xSemaphoreTake(dev->mutex, portMAX_DELAY);
+    xSemaphoreTakeRecursive(dev->mutex, portMAX_DELAY);
+    dev->transaction_depth++;
 
-    dev->outputs[port * 8 + pin] = level;
-
-    uint8_t tx_buffer[2];
+    return ESP_OK;
+}
 
-    if (port == CAT_PORT_0)
-    {
-        tx_buffer[0] = CAT_CMD_OUTPUT_0;
-    }
-    else
+esp_err_t catCommitTransaction(cat_state_t *dev)
+{
+    if (dev->transaction_depth == 0)
     {
-        tx_buffer[0] = CAT_CMD_OUTPUT_1;
+        return ESP_ERR_INVALID_STATE;
     }
 
-    tx_buffer[1] = 0x00;
-    for (uint8_t lpin = 0; lpin <= 7; lpin++)
-    {
-        uint8_t bit = dev->outputs[port * 8 + lpin] == CAT_LEVEL_HIGH ? 1 : 0;
-        tx_buffer[1] |= bit << lpin;
-    }
+    dev->transaction_depth--;
+    esp_err_t ret = cat_sync(dev);
+    xSemaphoreGiveRecursive(dev->mutex);
+
+    return ret;
+}
 
-    ESP_LOGD(TAG, "Outputs: %04x %04x", tx_buffer[0], tx_buffer[1]);
+esp_err_t setPins(cat_state_t *dev, uint16_t mask)
+{
+    return cat_modify(dev, &dev->output, 0, mask, 0);
+}
 
-    esp_err_t ret = i2c_master_transmit(dev->i2c_dev, tx_buffer, 2, I2C_USER_TIMEOUT_MS);
+esp_err_t clearPins(cat_state_t *dev, uint16_t mask)
+{
+    return cat_modify(dev, &dev->output, mask, 0, 0);
+}
 
-    xSemaphoreGive(dev->mutex);
+esp_err_t togglePins(cat_state_t *dev, uint16_t mask)
+{
+    return cat_modify(dev, &dev->output, 0, 0, mask);
+}
 
-    return ret;
+esp_err_t writePins(cat_state_t *dev, uint16_t mask, uint16_t levels)
+{
+    return cat_modify(dev, &dev->output, mask, levels & mask, 0);
+}
+
+esp_err_t tryWritePins(cat_state_t *dev, uint16_t mask, uint16_t levels)
+{
+    return cat_try_modify(dev, &dev->output, mask, levels & mask, 0, 0);
+}
+
+bool catWritesComplete(cat_state_t *dev)
+{
+    return dev->writes_done == dev->writes_queued && !dev->write_failed;
+}
+
+esp_err_t setDirections(cat_state_t *dev, uint16_t mask, cat_direction_t dir)
+{
+    // a set configuration bit makes the pin an input
+    return cat_modify(dev, &dev->config, mask, (dir == CAT_DIR_INPUT) ? mask : 0, 0);
+}
+
+esp_err_t setPolarities(cat_state_t *dev, uint16_t mask, cat_polarity_t pol)
+{
+    return cat_modify(dev, &dev->polarity, mask, (pol == CAT_POLARITY_INVERT) ? mask : 0, 0);
+}
+
+esp_err_t setDirection(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_direction_t dir)
+{
+    return setDirections(dev, CAT_PIN_MASK(port, pin), dir);
+}
+
+esp_err_t setPolarity(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_polarity_t pol)
+{
+    return setPolarities(dev, CAT_PIN_MASK(port, pin), pol);
+}
+
+esp_err_t setLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_level_t level)
+{
+    return writePins(dev, CAT_PIN_MASK(port, pin), (level == CAT_LEVEL_HIGH) ? 0xffff : 0x0000);
 }
 
 cat_level_t getLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin)
 {
-    xSemaphoreTake(dev->mutex, portMAX_DELAY);
+    if (dev->input_valid)
+    {
+        return (getInputs(dev) & CAT_PIN_MASK(port, pin)) ? CAT_LEVEL_HIGH : CAT_LEVEL_LOW;
+    }
+
+    xSemaphoreTakeRecursive(dev->mutex, portMAX_DELAY);
 
     uint8_t tx_buffer[1];
     uint8_t rx_buffer[1];
@@ -190,7 +268,7 @@ cat_level_t getLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin)
         tx_buffer[0] = CAT_CMD_INPUT_1;
     }
 
-    esp_err_t err = i2c_master_transmit_receive(dev->i2c_dev, tx_buffer, 1, rx_buffer, 1, I2C_USER_TIMEOUT_MS);
+    esp_err_t err = i2c_user_transfer(dev->i2c_dev, tx_buffer, 1, rx_buffer, 1, I2C_USER_TRANSFER_TIMEOUT_MS);
 
     if(err != ESP_OK)   {
         ESP_LOGE(TAG, "I2C Transaction failed");
@@ -203,7 +281,7 @@ cat_level_t getLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin)
 
     uint8_t bit = rx_buffer[0] & (1 << pin);
 
-    xSemaphoreGive(dev->mutex);
+    xSemaphoreGiveRecursive(dev->mutex);
 
     if (bit >= 1)
     {
@@ -214,3 +292,153 @@ cat_level_t getLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin)
         return CAT_LEVEL_LOW;
     }
 }
+
+static void cat_on_inputs(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx)
+{
+    cat_state_t *dev = (cat_state_t *)ctx;
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read inputs");
+        // fall back to direct reads until the next successful refresh
+        dev->input_valid = false;
+        return;
+    }
+
+    uint16_t levels = rx[0] | (rx[1] << 8);
+
+    taskENTER_CRITICAL(&dev->input_lock);
+    uint16_t changed = dev->input_valid ? (dev->input ^ levels) : 0;
+    dev->input = levels;
+    dev->input_valid = true;
+    taskEXIT_CRITICAL(&dev->input_lock);
+
+    for (uint8_t i = 0; i < dev->subscription_count && changed; i++)
+    {
+        cat_subscription_t *sub = &dev->subscriptions[i];
+        uint16_t rising = (sub->edge & CAT_EDGE_RISING) ? (changed & levels) : 0;
+        uint16_t falling = (sub->edge & CAT_EDGE_FALLING) ? (changed & ~levels) : 0;
+        uint16_t matched = (rising | falling) & sub->mask;
+
+        if (matched)
+        {
+            sub->callback(dev, matched, levels, sub->ctx);
+        }
+    }
+}
+
+static inline void cat_read_inputs_transaction(cat_state_t *dev, i2c_user_transaction_t *transaction)
+{
+    // both input registers in one auto-incrementing read, reading also clears INT
+    *transaction = (i2c_user_transaction_t){
+        .dev = dev->i2c_dev,
+        .tx = {CAT_CMD_INPUT_0},
+        .tx_len = 1,
+        .rx_len = 2,
+        .callback = cat_on_inputs,
+        .ctx = dev,
+    };
+}
+
+static void IRAM_ATTR cat_isr_handler(void *arg)
+{
+    cat_state_t *dev = (cat_state_t *)arg;
+    i2c_user_transaction_t transaction;
+    BaseType_t woken = pdFALSE;
+
+    cat_read_inputs_transaction(dev, &transaction);
+    i2c_user_submit_from_isr(&transaction, &woken);
+
+    if (woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+esp_err_t catEnableInterrupt(cat_state_t *dev, int int_pin)
+{
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << int_pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure INT pin %d", int_pin);
+        return err;
+    }
+
+    // the service may already be installed by another driver
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service");
+        return err;
+    }
+
+    err = gpio_isr_handler_add(int_pin, cat_isr_handler, dev);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to add INT handler");
+        return err;
+    }
+    dev->int_pin = int_pin;
+
+    // prime the cache, this also releases an INT that is already asserted
+    i2c_user_transaction_t transaction;
+    cat_read_inputs_transaction(dev, &transaction);
+    err = i2c_user_submit(&transaction);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read inputs");
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Interrupt enabled on GPIO %d", int_pin);
+    return ESP_OK;
+}
+
+uint16_t getInputs(cat_state_t *dev)
+{
+    taskENTER_CRITICAL(&dev->input_lock);
+    uint16_t levels = dev->input;
+    taskEXIT_CRITICAL(&dev->input_lock);
+
+    return levels;
+}
+
+esp_err_t catSubscribe(cat_state_t *dev, uint16_t mask, cat_edge_t edge, cat_edge_callback_t callback, void *ctx)
+{
+    if (callback == NULL || mask == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTakeRecursive(dev->mutex, portMAX_DELAY);
+
+    esp_err_t ret = ESP_OK;
+    if (dev->subscription_count >= CAT_MAX_SUBSCRIPTIONS)
+    {
+        ESP_LOGE(TAG, "Too many subscriptions");
+        ret = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        dev->subscriptions[dev->subscription_count] = (cat_subscription_t){
+            .mask = mask,
+            .edge = edge,
+            .callback = callback,
+            .ctx = ctx,
+        };
+        // publish the entry before the bus task can see the new count
+        __sync_synchronize();
+        dev->subscription_count++;
+    }
+
+    xSemaphoreGiveRecursive(dev->mutex);
+
+    return ret;
+}
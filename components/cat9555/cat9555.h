@@ -3,7 +3,9 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
-#include "driver/i2c_master.h"
+#include "freertos/semphr.h"
+
+#include "i2c_user.h"
 
 #define MAGIC_BYTE 0xf2
 
@@ -55,18 +57,86 @@ typedef enum
     CAT_POLARITY_INVERT = 1
 } cat_polarity_t;
 
+typedef enum
+{
+    CAT_EDGE_RISING = 1,
+    CAT_EDGE_FALLING = 2,
+    CAT_EDGE_ANY = 3
+} cat_edge_t;
+
+#define CAT_MAX_SUBSCRIPTIONS 8
+
+typedef struct cat_state cat_state_t;
+
+// runs on the I2C bus task, keep it short
+typedef void (*cat_edge_callback_t)(cat_state_t *dev, uint16_t changed, uint16_t levels, void *ctx);
+
 typedef struct
+{
+    uint16_t mask;
+    cat_edge_t edge;
+    cat_edge_callback_t callback;
+    void *ctx;
+} cat_subscription_t;
+
+// pin masks cover both ports, pin n of port 1 is bit n + 8
+#define CAT_PIN_MASK(port, pin) ((uint16_t)(1U << ((port) * 8 + (pin))))
+
+struct cat_state
 {
     uint8_t dev_address;
     SemaphoreHandle_t mutex;
-    i2c_master_dev_handle_t i2c_dev;
-    cat_level_t outputs[16];
-    cat_polarity_t polarities[16];
-    cat_direction_t directions[16];
-} cat_state_t;
+    i2c_user_device_t *i2c_dev;
+
+    // shadow registers and their state on the device
+    uint16_t output;
+    uint16_t polarity;
+    uint16_t config;
+    uint16_t output_written;
+    uint16_t polarity_written;
+    uint16_t config_written;
+    volatile bool write_failed;
+    // register writes put on the bus and finished, equal once the device caught up with the shadow
+    volatile uint32_t writes_queued;
+    volatile uint32_t writes_done;
+
+    uint8_t transaction_depth;
 
-esp_err_t initlizeCat(cat_state_t *dev, uint8_t address, i2c_port_num_t i2c_port);
+    // input registers, refreshed when the INT line signals a change
+    int int_pin;
+    volatile uint16_t input;
+    volatile bool input_valid;
+    portMUX_TYPE input_lock;
+    cat_subscription_t subscriptions[CAT_MAX_SUBSCRIPTIONS];
+    uint8_t subscription_count;
+};
+
+esp_err_t initlizeCat(cat_state_t *dev, uint8_t address);
 esp_err_t setDirection(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_direction_t dir);
 esp_err_t setPolarity(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_polarity_t pol);
 esp_err_t setLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin, cat_level_t level);
+
+// masked multi-pin operations, each costs at most one write per changed register
+esp_err_t setPins(cat_state_t *dev, uint16_t mask);
+esp_err_t clearPins(cat_state_t *dev, uint16_t mask);
+esp_err_t togglePins(cat_state_t *dev, uint16_t mask);
+esp_err_t writePins(cat_state_t *dev, uint16_t mask, uint16_t levels);
+// writePins for callers that must not block: returns ESP_ERR_TIMEOUT instead of waiting for the device lock,
+// the write itself is only queued on the bus
+esp_err_t tryWritePins(cat_state_t *dev, uint16_t mask, uint16_t levels);
+// true once every queued write reached the device, false after a failed write until it was repeated
+bool catWritesComplete(cat_state_t *dev);
+esp_err_t setDirections(cat_state_t *dev, uint16_t mask, cat_direction_t dir);
+esp_err_t setPolarities(cat_state_t *dev, uint16_t mask, cat_polarity_t pol);
+
+// changes between begin and commit only touch the shadow registers and are written in one go,
+// transactions nest and hold the device lock
+esp_err_t catBeginTransaction(cat_state_t *dev);
+esp_err_t catCommitTransaction(cat_state_t *dev);
 cat_level_t getLevel(cat_state_t *dev, cat_port_t port, cat_pin_t pin);
+
+// wire the active low INT output to a GPIO, inputs are then only read when the chip reports a change
+// and getLevel answers from the cache
+esp_err_t catEnableInterrupt(cat_state_t *dev, int int_pin);
+uint16_t getInputs(cat_state_t *dev);
+esp_err_t catSubscribe(cat_state_t *dev, uint16_t mask, cat_edge_t edge, cat_edge_callback_t callback, void *ctx);
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+// a simulated device answering transfers of the sim transport
+// returning ESP_ERR_INVALID_STATE behaves like a NACK
+typedef struct
+{
+    const char *name;
+    uint8_t address;
+    void (*reset)(void);
+    esp_err_t (*transfer)(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+} sim_model_t;
+
+extern const sim_model_t sim_sht3x_model;
+extern const sim_model_t sim_cat9555_model;
+extern const sim_model_t sim_scd4x_model;
+
+// environment reported by the simulated SHT3x, noise is the standard deviation of both values
+void sim_sht3x_set_environment(float temperature, float humidity, float noise);
+// chance between 0 and 1 of a corrupted checksum per returned word
+void sim_sht3x_set_crc_error_rate(float rate);
+
+// co2 concentration reported by the simulated SCD4x, noise is its standard deviation in ppm
+void sim_scd4x_set_environment(float co2_ppm, float noise);
+
+// levels seen on the input pins of the simulated CAT9555, before polarity inversion
+void sim_cat9555_set_inputs(uint16_t inputs);
+uint16_t sim_cat9555_get_outputs(void);
+
+// deterministic pseudo random numbers shared by all models
+uint32_t sim_random(void);
+float sim_random_gaussian(void);
+bool sim_chance(float probability);
+
+#endif
@@ -0,0 +1,91 @@
+#include "i2c/sim.h"
+
+#define SIM_CAT9555_ADDRESS 0b0100111
+
+#define SIM_CAT9555_REGISTERS 8
+
+static struct
+{
+    uint8_t registers[SIM_CAT9555_REGISTERS];
+    uint8_t pointer;
+    uint16_t inputs;
+} sim;
+
+static void sim_cat9555_reset(void)
+{
+    sim.pointer = 0;
+    sim.inputs = 0xffff;
+    // power up defaults: outputs high, no inversion, all inputs
+    sim.registers[0] = 0xff;
+    sim.registers[1] = 0xff;
+    sim.registers[2] = 0xff;
+    sim.registers[3] = 0xff;
+    sim.registers[4] = 0x00;
+    sim.registers[5] = 0x00;
+    sim.registers[6] = 0xff;
+    sim.registers[7] = 0xff;
+}
+
+static uint8_t sim_cat9555_input_port(uint8_t port)
+{
+    uint8_t inputs = (sim.inputs >> (8 * port)) & 0xff;
+    uint8_t outputs = sim.registers[2 + port];
+    uint8_t config = sim.registers[6 + port];
+
+    // output pins read back their driven level
+    uint8_t level = (inputs & config) | (outputs & ~config);
+    return level ^ sim.registers[4 + port];
+}
+
+// the pointer toggles within a register pair on auto increment
+static void sim_cat9555_advance(void)
+{
+    sim.pointer ^= 1;
+}
+
+static esp_err_t sim_cat9555_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len > 0)
+    {
+        if (tx[0] >= SIM_CAT9555_REGISTERS)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        sim.pointer = tx[0];
+
+        for (size_t i = 1; i < tx_len; i++)
+        {
+            // input registers are read only
+            if (sim.pointer >= 2)
+            {
+                sim.registers[sim.pointer] = tx[i];
+            }
+            sim_cat9555_advance();
+        }
+    }
+
+    for (size_t i = 0; i < rx_len; i++)
+    {
+        rx[i] = (sim.pointer < 2) ? sim_cat9555_input_port(sim.pointer) : sim.registers[sim.pointer];
+        sim_cat9555_advance();
+    }
+
+    return ESP_OK;
+}
+
+void sim_cat9555_set_inputs(uint16_t inputs)
+{
+    sim.inputs = inputs;
+}
+
+uint16_t sim_cat9555_get_outputs(void)
+{
+    return sim.registers[2] | (sim.registers[3] << 8);
+}
+
+const sim_model_t sim_cat9555_model = {
+    .name = "cat9555",
+    .address = SIM_CAT9555_ADDRESS,
+    .reset = sim_cat9555_reset,
+    .transfer = sim_cat9555_transfer,
+};
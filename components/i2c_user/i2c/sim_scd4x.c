@@ -0,0 +1,127 @@
+#include "esp_timer.h"
+
+#include "i2c/sim.h"
+#include "sensirion_crc.h"
+
+#define SIM_SCD4X_ADDRESS 0x62
+#define SIM_SCD4X_PERIOD_US 5000000LL
+
+static struct
+{
+    float co2;
+    float noise;
+    bool periodic;
+    int64_t started;
+    // index of the last result read, a new one is due every period
+    int64_t consumed;
+    uint16_t last_command;
+} sim;
+
+static void sim_scd4x_reset(void)
+{
+    sim.co2 = 420.0f;
+    sim.noise = 5.0f;
+    sim.periodic = false;
+    sim.consumed = 0;
+    sim.last_command = 0;
+}
+
+static int64_t sim_scd4x_available(void)
+{
+    if (!sim.periodic)
+    {
+        return sim.consumed;
+    }
+    return (esp_timer_get_time() - sim.started) / SIM_SCD4X_PERIOD_US;
+}
+
+static void sim_put_word(uint8_t *rx, uint16_t word)
+{
+    rx[0] = word >> 8;
+    rx[1] = word & 0xff;
+    rx[2] = sensirion_crc8(rx, 2);
+}
+
+static esp_err_t sim_scd4x_read(uint8_t *rx, size_t rx_len)
+{
+    int64_t available = sim_scd4x_available();
+
+    switch (sim.last_command)
+    {
+    case 0xe4b8:
+        if (rx_len != 3)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        sim_put_word(rx, (available > sim.consumed) ? 0x8006 : 0x8000);
+        return ESP_OK;
+    case 0xec05:
+    {
+        if (rx_len != 9 || available <= sim.consumed)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        sim.consumed = available;
+
+        float co2 = sim.co2 + sim.noise * sim_random_gaussian();
+        float temperature = 25.0f + 0.1f * sim_random_gaussian();
+        float humidity = 50.0f + 0.5f * sim_random_gaussian();
+        sim_put_word(rx, (co2 > 0.0f) ? (uint16_t)co2 : 0);
+        sim_put_word(rx + 3, (uint16_t)((temperature + 45.0f) / 175.0f * 65535.0f));
+        sim_put_word(rx + 6, (uint16_t)(humidity / 100.0f * 65535.0f));
+        return ESP_OK;
+    }
+    default:
+        return ESP_ERR_INVALID_STATE;
+    }
+}
+
+static esp_err_t sim_scd4x_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len == 2)
+    {
+        uint16_t command = (tx[0] << 8) | tx[1];
+        sim.last_command = command;
+
+        switch (command)
+        {
+        case 0x21b1:
+            sim.periodic = true;
+            sim.started = esp_timer_get_time();
+            sim.consumed = 0;
+            break;
+        case 0x3f86:
+            sim.periodic = false;
+            break;
+        case 0x3646:
+            sim_scd4x_reset();
+            break;
+        default:
+            break;
+        }
+    }
+    else if (tx_len != 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (rx_len > 0)
+    {
+        return sim_scd4x_read(rx, rx_len);
+    }
+
+    return ESP_OK;
+}
+
+void sim_scd4x_set_environment(float co2_ppm, float noise)
+{
+    sim.co2 = co2_ppm;
+    sim.noise = noise;
+}
+
+const sim_model_t sim_scd4x_model = {
+    .name = "scd4x",
+    .address = SIM_SCD4X_ADDRESS,
+    .reset = sim_scd4x_reset,
+    .transfer = sim_scd4x_transfer,
+};
@@ -0,0 +1,207 @@
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "i2c/sim.h"
+#include "sensirion_crc.h"
+
+#define SIM_SHT3X_ADDRESS 0x44
+
+static struct
+{
+    float temperature;
+    float humidity;
+    float noise;
+    float crc_error_rate;
+    uint16_t periodic_mode;
+    int64_t period_us;
+    int64_t last_sample;
+    uint16_t last_command;
+    uint16_t status;
+    bool heater;
+} sim;
+
+static void sim_put_word(uint8_t *rx, uint16_t word)
+{
+    rx[0] = word >> 8;
+    rx[1] = word & 0xff;
+    rx[2] = sensirion_crc8(rx, 2);
+
+    if (sim_chance(sim.crc_error_rate))
+    {
+        rx[2] ^= 0x5a;
+    }
+}
+
+static uint16_t sim_encode(float value, float offset, float span)
+{
+    float raw = (value + offset) / span * 65535.0f;
+    if (raw < 0.0f)
+    {
+        return 0;
+    }
+    if (raw > 65535.0f)
+    {
+        return 0xffff;
+    }
+    return (uint16_t)raw;
+}
+
+static void sim_put_measurement(uint8_t *rx)
+{
+    float temperature = sim.temperature + sim.noise * sim_random_gaussian();
+    float humidity = sim.humidity + sim.noise * sim_random_gaussian();
+
+    sim_put_word(rx, sim_encode(temperature, 45.0f, 175.0f));
+    sim_put_word(rx + 3, sim_encode(humidity, 0.0f, 100.0f));
+}
+
+static int64_t sim_period_us(uint16_t mode)
+{
+    switch (mode >> 8)
+    {
+    case 0x20:
+        return 2000000;
+    case 0x21:
+        return 1000000;
+    case 0x22:
+        return 500000;
+    case 0x23:
+        return 250000;
+    case 0x27:
+        return 100000;
+    default:
+        // art runs at 4 mps
+        return 250000;
+    }
+}
+
+static void sim_sht3x_reset(void)
+{
+    sim.temperature = 25.0f;
+    sim.humidity = 50.0f;
+    sim.noise = 0.05f;
+    sim.crc_error_rate = 0.0f;
+    sim.periodic_mode = 0;
+    sim.last_command = 0;
+    // system reset detected after power up
+    sim.status = 0x8010;
+    sim.heater = false;
+}
+
+static esp_err_t sim_sht3x_read(uint8_t *rx, size_t rx_len)
+{
+    int64_t now = esp_timer_get_time();
+
+    switch (sim.last_command)
+    {
+    case 0xe000:
+        // no result yet is signalled with a NACK
+        if (sim.periodic_mode == 0 || now - sim.last_sample < sim.period_us || rx_len > 6)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        sim.last_sample += ((now - sim.last_sample) / sim.period_us) * sim.period_us;
+        sim_put_measurement(rx);
+        return ESP_OK;
+    case 0xf32d:
+        if (rx_len > 3)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        sim_put_word(rx, sim.status | (sim.heater ? 0x2000 : 0));
+        return ESP_OK;
+    default:
+        // single shot measurements are ready immediately
+        if ((sim.last_command >> 8) == 0x2c || (sim.last_command >> 8) == 0x24)
+        {
+            sim.last_command = 0;
+            sim_put_measurement(rx);
+            return ESP_OK;
+        }
+        return ESP_ERR_INVALID_STATE;
+    }
+}
+
+static void sim_sht3x_command(uint16_t command)
+{
+    uint8_t msb = command >> 8;
+
+    sim.last_command = command;
+
+    if ((msb >= 0x20 && msb <= 0x27) || command == 0x2b32)
+    {
+        sim.periodic_mode = command;
+        sim.period_us = sim_period_us(command);
+        sim.last_sample = esp_timer_get_time();
+        return;
+    }
+
+    switch (command)
+    {
+    case 0x3093:
+        sim.periodic_mode = 0;
+        break;
+    case 0x30a2:
+        sim.periodic_mode = 0;
+        sim.heater = false;
+        sim.status |= 0x0010;
+        break;
+    case 0x306d:
+        sim.heater = true;
+        break;
+    case 0x3066:
+        sim.heater = false;
+        break;
+    case 0x3041:
+        sim.status = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+static esp_err_t sim_sht3x_transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    if (tx_len == 1 && tx[0] == 0x06)
+    {
+        // general call reset
+        sim_sht3x_reset();
+        return ESP_OK;
+    }
+
+    if (tx_len == 2)
+    {
+        sim_sht3x_command((tx[0] << 8) | tx[1]);
+    }
+    else if (tx_len != 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (rx_len > 0)
+    {
+        return sim_sht3x_read(rx, rx_len);
+    }
+
+    return ESP_OK;
+}
+
+void sim_sht3x_set_environment(float temperature, float humidity, float noise)
+{
+    sim.temperature = temperature;
+    sim.humidity = humidity;
+    sim.noise = noise;
+}
+
+void sim_sht3x_set_crc_error_rate(float rate)
+{
+    sim.crc_error_rate = rate;
+}
+
+const sim_model_t sim_sht3x_model = {
+    .name = "sht3x",
+    .address = SIM_SHT3X_ADDRESS,
+    .reset = sim_sht3x_reset,
+    .transfer = sim_sht3x_transfer,
+};
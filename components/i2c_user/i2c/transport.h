@@ -0,0 +1,27 @@
+#pragma once
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+// backend executing the bus manager's transactions
+// transfer is called from the bus task only and returns once the transaction finished
+typedef struct
+{
+    const char *name;
+    esp_err_t (*init)(void);
+    esp_err_t (*add_device)(uint8_t address, uint32_t scl_speed_hz, void **handle);
+    esp_err_t (*transfer)(void *handle, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len);
+} i2c_transport_t;
+
+// ESP-IDF I2C master in asynchronous mode
+extern const i2c_transport_t i2c_transport_idf;
+// simulated device models, see i2c/sim.h
+extern const i2c_transport_t i2c_transport_sim;
+// plays back a trace captured with CONFIG_I2C_TRANSPORT_RECORD
+extern const i2c_transport_t i2c_transport_replay;
+
+#endif
@@ -0,0 +1,116 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "driver/i2c_master.h"
+
+#include "i2c_user.h"
+#include "i2c/transport.h"
+
+static const char *TAG = "I2C IDF";
+
+static i2c_master_bus_handle_t bus_handle = NULL;
+static TaskHandle_t waiting_task = NULL;
+static volatile i2c_master_event_t last_event;
+
+static bool IRAM_ATTR idf_on_done(i2c_master_dev_handle_t dev, const i2c_master_event_data_t *edata, void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    last_event = edata->event;
+    vTaskNotifyGiveFromISR(waiting_task, &woken);
+    return woken == pdTRUE;
+}
+
+static esp_err_t idf_init(void)
+{
+    i2c_master_bus_config_t i2c_mst_config = {
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .i2c_port = I2C_USER_PORT,
+        .scl_io_num = I2C_USER_MASTER_SCL_IO,
+        .sda_io_num = I2C_USER_MASTER_SDA_IO,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = I2C_USER_QUEUE_LENGTH,
+        .flags.enable_internal_pullup = true,
+    };
+
+    return i2c_new_master_bus(&i2c_mst_config, &bus_handle);
+}
+
+static esp_err_t idf_add_device(uint8_t address, uint32_t scl_speed_hz, void **handle)
+{
+    esp_err_t err = i2c_master_probe(bus_handle, address, I2C_USER_TIMEOUT_MS);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = scl_speed_hz,
+    };
+
+    i2c_master_dev_handle_t dev_handle;
+    err = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev_handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    // completion is signalled to the bus task
+    i2c_master_event_callbacks_t callbacks = {
+        .on_trans_done = idf_on_done,
+    };
+    err = i2c_master_register_event_callbacks(dev_handle, &callbacks, NULL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register I2C callbacks");
+        return err;
+    }
+
+    *handle = dev_handle;
+    return ESP_OK;
+}
+
+static esp_err_t idf_transfer(void *handle, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    esp_err_t err;
+    i2c_master_dev_handle_t dev_handle = (i2c_master_dev_handle_t)handle;
+
+    waiting_task = xTaskGetCurrentTaskHandle();
+
+    // the bus runs in asynchronous mode, these only start the transfer
+    if (tx_len > 0 && rx_len > 0)
+    {
+        err = i2c_master_transmit_receive(dev_handle, tx, tx_len, rx, rx_len, I2C_USER_TIMEOUT_MS);
+    }
+    else if (tx_len > 0)
+    {
+        err = i2c_master_transmit(dev_handle, tx, tx_len, I2C_USER_TIMEOUT_MS);
+    }
+    else
+    {
+        err = i2c_master_receive(dev_handle, rx, rx_len, I2C_USER_TIMEOUT_MS);
+    }
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(I2C_USER_TIMEOUT_MS)) == 0)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // a NACK is reported like the synchronous driver does
+    return (last_event == I2C_EVENT_DONE) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+const i2c_transport_t i2c_transport_idf = {
+    .name = "esp-idf",
+    .init = idf_init,
+    .add_device = idf_add_device,
+    .transfer = idf_transfer,
+};
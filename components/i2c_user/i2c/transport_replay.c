@@ -0,0 +1,143 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "i2c_user.h"
+#include "i2c/transport.h"
+
+static const char *TAG = "I2C REPLAY";
+
+// captured with CONFIG_I2C_TRANSPORT_RECORD, see i2c_user.c for the line format
+extern const char i2c_trace_start[] asm("_binary_i2c_trace_txt_start");
+
+typedef struct
+{
+    uint8_t address;
+    const char *cursor;
+} replay_handle_t;
+
+static replay_handle_t handles[I2C_USER_MAX_DEVICES];
+static uint8_t handle_count = 0;
+
+typedef struct
+{
+    uint8_t address;
+    uint8_t tx[I2C_USER_MAX_TX];
+    size_t tx_len;
+    uint8_t rx[I2C_USER_MAX_RX];
+    size_t rx_len;
+    esp_err_t err;
+} replay_record_t;
+
+static const char *replay_parse_hex(const char *line, const char *key, uint8_t *out, size_t max_len, size_t *len)
+{
+    const char *p = strstr(line, key);
+    *len = 0;
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    p += strlen(key);
+
+    char byte[3] = {0};
+    while (p[0] && p[1] && strchr("0123456789abcdef", p[0]) && strchr("0123456789abcdef", p[1]))
+    {
+        if (*len >= max_len)
+        {
+            return NULL;
+        }
+        byte[0] = p[0];
+        byte[1] = p[1];
+        out[(*len)++] = (uint8_t)strtoul(byte, NULL, 16);
+        p += 2;
+    }
+    return p;
+}
+
+// finds the next record of this device, the trace of other devices may be interleaved
+static bool replay_next(replay_handle_t *handle, replay_record_t *record)
+{
+    const char *line;
+
+    while ((line = strchr(handle->cursor, '@')) != NULL)
+    {
+        const char *end = strchr(line, '\n');
+        handle->cursor = (end != NULL) ? end + 1 : line + strlen(line);
+
+        record->address = (uint8_t)strtoul(line + 1, NULL, 16);
+        if (record->address != handle->address)
+        {
+            continue;
+        }
+
+        if (replay_parse_hex(line, " w:", record->tx, sizeof(record->tx), &record->tx_len) == NULL ||
+            replay_parse_hex(line, " r:", record->rx, sizeof(record->rx), &record->rx_len) == NULL)
+        {
+            ESP_LOGW(TAG, "Malformed trace line");
+            continue;
+        }
+
+        const char *err = strstr(line, " e:");
+        record->err = (err != NULL) ? (esp_err_t)strtol(err + 3, NULL, 16) : ESP_OK;
+        return true;
+    }
+
+    return false;
+}
+
+static esp_err_t replay_init(void)
+{
+    handle_count = 0;
+    return ESP_OK;
+}
+
+static esp_err_t replay_add_device(uint8_t address, uint32_t scl_speed_hz, void **handle)
+{
+    if (handle_count >= I2C_USER_MAX_DEVICES)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    handles[handle_count] = (replay_handle_t){
+        .address = address,
+        .cursor = i2c_trace_start,
+    };
+    *handle = &handles[handle_count++];
+    return ESP_OK;
+}
+
+static esp_err_t replay_transfer(void *handle, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    replay_handle_t *replay = (replay_handle_t *)handle;
+    replay_record_t record;
+
+    if (!replay_next(replay, &record))
+    {
+        ESP_LOGW(TAG, "Trace of %02x exhausted", replay->address);
+        return ESP_FAIL;
+    }
+
+    // the firmware has to issue exactly what was recorded
+    if (record.tx_len != tx_len || memcmp(record.tx, tx, tx_len) != 0 ||
+        (record.err == ESP_OK && record.rx_len != rx_len))
+    {
+        ESP_LOGE(TAG, "Trace of %02x diverged", replay->address);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    if (record.err == ESP_OK && rx_len > 0)
+    {
+        memcpy(rx, record.rx, rx_len);
+    }
+
+    return record.err;
+}
+
+const i2c_transport_t i2c_transport_replay = {
+    .name = "replay",
+    .init = replay_init,
+    .add_device = replay_add_device,
+    .transfer = replay_transfer,
+};
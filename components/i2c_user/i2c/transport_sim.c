@@ -0,0 +1,104 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+
+#include "i2c_user.h"
+#include "i2c/transport.h"
+#include "i2c/sim.h"
+
+static const char *TAG = "I2C SIM";
+
+static const sim_model_t *const models[] = {
+    &sim_sht3x_model,
+    &sim_cat9555_model,
+    &sim_scd4x_model,
+};
+#define SIM_MODEL_COUNT (sizeof(models) / sizeof(models[0]))
+
+typedef struct
+{
+    const sim_model_t *model;
+    uint32_t scl_speed_hz;
+} sim_handle_t;
+
+static sim_handle_t handles[I2C_USER_MAX_DEVICES];
+static uint8_t handle_count = 0;
+
+static uint32_t random_state = 0x2545f491;
+
+uint32_t sim_random(void)
+{
+    // xorshift32, the sequence is the same on every run
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+float sim_random_gaussian(void)
+{
+    // irwin-hall approximation, good enough for sensor noise
+    float sum = 0.0f;
+    for (uint8_t i = 0; i < 12; i++)
+    {
+        sum += (float)(sim_random() & 0xffff) / 65535.0f;
+    }
+    return sum - 6.0f;
+}
+
+bool sim_chance(float probability)
+{
+    return probability > 0.0f && (float)(sim_random() % 10000) < probability * 10000.0f;
+}
+
+static esp_err_t sim_init(void)
+{
+    for (size_t i = 0; i < SIM_MODEL_COUNT; i++)
+    {
+        models[i]->reset();
+        ESP_LOGI(TAG, "Simulating %s at %02x", models[i]->name, models[i]->address);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_add_device(uint8_t address, uint32_t scl_speed_hz, void **handle)
+{
+    if (handle_count >= I2C_USER_MAX_DEVICES)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < SIM_MODEL_COUNT; i++)
+    {
+        if (models[i]->address == address)
+        {
+            handles[handle_count] = (sim_handle_t){
+                .model = models[i],
+                .scl_speed_hz = scl_speed_hz,
+            };
+            *handle = &handles[handle_count++];
+            return ESP_OK;
+        }
+    }
+
+    // same as a failed probe
+    return ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t sim_transfer(void *handle, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len)
+{
+    sim_handle_t *sim = (sim_handle_t *)handle;
+
+    // occupy the bus as long as the real transfer would, 9 clocks per byte including the address
+    size_t bytes = tx_len + rx_len + ((tx_len > 0) ? 1 : 0) + ((rx_len > 0) ? 1 : 0);
+    esp_rom_delay_us((uint32_t)((bytes * 9 * 1000000ULL) / sim->scl_speed_hz));
+
+    return sim->model->transfer(tx, tx_len, rx, rx_len);
+}
+
+const i2c_transport_t i2c_transport_sim = {
+    .name = "sim",
+    .init = sim_init,
+    .add_device = sim_add_device,
+    .transfer = sim_transfer,
+};
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "i2c_user.h"
+#include "i2c/transport.h"
+
+static const char* TAG = "I2C";
+
+struct i2c_user_device
+{
+    uint8_t address;
+    void *handle;
+};
+
+// the unit of the queue, a single transaction is a chain of one
+typedef struct
+{
+    i2c_user_transaction_t steps[I2C_USER_MAX_CHAIN];
+    uint8_t count;
+} i2c_user_chain_t;
+
+// state of a blocking transfer, on the heap since a caller that timed out leaves it to the bus task
+typedef struct
+{
+    SemaphoreHandle_t done;
+    esp_err_t err;
+    uint8_t remaining;
+    bool abandoned;
+    uint8_t rx[I2C_USER_MAX_RX];
+    size_t rx_len;
+} i2c_user_sync_t;
+
+#if CONFIG_I2C_TRANSPORT_SIM
+static const i2c_transport_t *transport = &i2c_transport_sim;
+#elif CONFIG_I2C_TRANSPORT_REPLAY
+static const i2c_transport_t *transport = &i2c_transport_replay;
+#else
+static const i2c_transport_t *transport = &i2c_transport_idf;
+#endif
+
+static bool bus_installed = false;
+static QueueHandle_t transaction_queue = NULL;
+
+static struct i2c_user_device devices[I2C_USER_MAX_DEVICES];
+static uint8_t device_count = 0;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE sync_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// post-command delays wait on a timer, the bus task runs at the highest priority and must not spin
+static esp_timer_handle_t delay_timer = NULL;
+static SemaphoreHandle_t delay_done = NULL;
+static struct
+{
+    int64_t window_start;
+    int64_t busy_us;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t dropped;
+} stats;
+
+#if CONFIG_I2C_TRANSPORT_RECORD
+static void i2c_user_hex(char *out, const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        sprintf(out + 2 * i, "%02x", data[i]);
+    }
+    out[2 * length] = '\0';
+}
+
+// one line per transaction, the replay transport reads these back
+static void i2c_user_record(const i2c_user_transaction_t *t, const uint8_t *rx, esp_err_t err)
+{
+    char tx_hex[2 * I2C_USER_MAX_TX + 1];
+    char rx_hex[2 * I2C_USER_MAX_RX + 1];
+
+    i2c_user_hex(tx_hex, t->tx, t->tx_len);
+    i2c_user_hex(rx_hex, rx, (err == ESP_OK) ? t->rx_len : 0);
+    ESP_LOGI("I2C_TRACE", "@%02x w:%s r:%s e:%x", t->dev->address, tx_hex, rx_hex, err);
+}
+#endif
+
+static void i2c_user_execute(const i2c_user_transaction_t *transaction)
+{
+    uint8_t rx[I2C_USER_MAX_RX];
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = transport->transfer(transaction->dev->handle, transaction->tx, transaction->tx_len, rx, transaction->rx_len);
+    if (transaction->delay_us > 0 && esp_timer_start_once(delay_timer, transaction->delay_us) == ESP_OK)
+    {
+        xSemaphoreTake(delay_done, portMAX_DELAY);
+    }
+    int64_t end = esp_timer_get_time();
+
+#if CONFIG_I2C_TRANSPORT_RECORD
+    i2c_user_record(transaction, rx, err);
+#endif
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Transaction to %02x failed: %s", transaction->dev->address, esp_err_to_name(err));
+    }
+
+    uint32_t latency = (uint32_t)(end - transaction->submitted);
+    taskENTER_CRITICAL(&stats_lock);
+    stats.busy_us += end - start;
+    stats.latency_sum_us += latency;
+    if (latency > stats.latency_max_us)
+    {
+        stats.latency_max_us = latency;
+    }
+    stats.transactions++;
+    if (err != ESP_OK)
+    {
+        stats.errors++;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+
+    if (transaction->callback)
+    {
+        transaction->callback(err, rx, transaction->rx_len, transaction->ctx);
+    }
+}
+
+static void i2c_user_on_delay(void *arg)
+{
+    xSemaphoreGive(delay_done);
+}
+
+static void i2c_user_task(void *pvparameters)
+{
+    static i2c_user_chain_t chain;
+
+    while (1)
+    {
+        if (xQueueReceive(transaction_queue, &chain, portMAX_DELAY) != pdPASS)
+        {
+            continue;
+        }
+
+        // the steps of a chain go out back to back, a failed step does not stop the rest
+        for (uint8_t i = 0; i < chain.count; i++)
+        {
+            i2c_user_execute(&chain.steps[i]);
+        }
+    }
+}
+
+esp_err_t i2c_init()    {
+    esp_err_t ret = transport->init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to install I2C Bus");
+        return ret;
+    }
+    bus_installed = true;
+    ESP_LOGI(TAG, "Installed I2C Bus (%s)", transport->name);
+
+    transaction_queue = xQueueCreate(I2C_USER_QUEUE_LENGTH, sizeof(i2c_user_chain_t));
+    if (transaction_queue == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot create Queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    delay_done = xSemaphoreCreateBinary();
+    const esp_timer_create_args_t delay_timer_args = {
+        .callback = i2c_user_on_delay,
+        .name = "I2C delay",
+    };
+    if (delay_done == NULL || esp_timer_create(&delay_timer_args, &delay_timer) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Cannot create delay timer");
+        return ESP_ERR_NO_MEM;
+    }
+
+    stats.window_start = esp_timer_get_time();
+
+    if (xTaskCreate(&i2c_user_task, "I2C", 3072, NULL, configMAX_PRIORITIES - 1, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Cannot create bus task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ret;
+}
+
+esp_err_t i2c_user_add_device(uint8_t address, uint32_t scl_speed_hz, i2c_user_device_t **dev)
+{
+    if (!bus_installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (device_count >= I2C_USER_MAX_DEVICES)
+    {
+        ESP_LOGE(TAG, "Too many devices");
+        return ESP_ERR_NO_MEM;
+    }
+
+    struct i2c_user_device *device = &devices[device_count];
+    esp_err_t err = transport->add_device(address, scl_speed_hz, &device->handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Cannot add device at address %02x", address);
+        return err;
+    }
+
+    device->address = address;
+    device_count++;
+    *dev = device;
+
+    return ESP_OK;
+}
+
+static bool i2c_user_valid(const i2c_user_transaction_t *transaction)
+{
+    return transaction->tx_len <= I2C_USER_MAX_TX && transaction->rx_len <= I2C_USER_MAX_RX &&
+           (transaction->tx_len > 0 || transaction->rx_len > 0);
+}
+
+esp_err_t i2c_user_submit_chain(i2c_user_transaction_t *steps, size_t count)
+{
+    if (transaction_queue == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (count == 0 || count > I2C_USER_MAX_CHAIN)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_user_chain_t chain = {.count = count};
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!i2c_user_valid(&steps[i]))
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+        steps[i].submitted = now;
+        chain.steps[i] = steps[i];
+    }
+
+    // never wait for the bus, callers must not block on I2C
+    if (xQueueSend(transaction_queue, &chain, 0) != pdPASS)
+    {
+        taskENTER_CRITICAL(&stats_lock);
+        stats.dropped += count;
+        taskEXIT_CRITICAL(&stats_lock);
+        ESP_LOGW(TAG, "Transaction queue full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_user_submit(i2c_user_transaction_t *transaction)
+{
+    return i2c_user_submit_chain(transaction, 1);
+}
+
+esp_err_t IRAM_ATTR i2c_user_submit_from_isr(i2c_user_transaction_t *transaction, BaseType_t *woken)
+{
+    if (transaction_queue == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    i2c_user_chain_t chain = {.count = 1};
+    transaction->submitted = esp_timer_get_time();
+    chain.steps[0] = *transaction;
+
+    if (xQueueSendFromISR(transaction_queue, &chain, woken) != pdPASS)
+    {
+        taskENTER_CRITICAL_ISR(&stats_lock);
+        stats.dropped++;
+        taskEXIT_CRITICAL_ISR(&stats_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+static void i2c_user_sync_step(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx)
+{
+    i2c_user_sync_t *sync = (i2c_user_sync_t *)ctx;
+
+    // the first failure is the result, the response is what the last reading step got
+    if (err != ESP_OK && sync->err == ESP_OK)
+    {
+        sync->err = err;
+    }
+    if (err == ESP_OK && rx_len > 0)
+    {
+        memcpy(sync->rx, rx, rx_len);
+        sync->rx_len = rx_len;
+    }
+
+    taskENTER_CRITICAL(&sync_lock);
+    bool last = (--sync->remaining == 0);
+    bool abandoned = sync->abandoned;
+    taskEXIT_CRITICAL(&sync_lock);
+
+    if (last && abandoned)
+    {
+        vSemaphoreDelete(sync->done);
+        free(sync);
+    }
+    else if (last)
+    {
+        xSemaphoreGive(sync->done);
+    }
+}
+
+esp_err_t i2c_user_transfer_chain(i2c_user_transaction_t *steps, size_t count, uint8_t *rx, size_t rx_len, uint32_t timeout_ms)
+{
+    if (count == 0 || count > I2C_USER_MAX_CHAIN || rx_len > I2C_USER_MAX_RX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_user_sync_t *sync = calloc(1, sizeof(i2c_user_sync_t));
+    if (sync == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    sync->done = xSemaphoreCreateBinary();
+    if (sync->done == NULL)
+    {
+        free(sync);
+        return ESP_ERR_NO_MEM;
+    }
+    sync->err = ESP_OK;
+    sync->remaining = count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        steps[i].callback = i2c_user_sync_step;
+        steps[i].ctx = sync;
+    }
+
+    esp_err_t err = i2c_user_submit_chain(steps, count);
+    if (err != ESP_OK)
+    {
+        vSemaphoreDelete(sync->done);
+        free(sync);
+        return err;
+    }
+
+    if (xSemaphoreTake(sync->done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+    {
+        // the chain still runs, whoever comes last cleans up
+        taskENTER_CRITICAL(&sync_lock);
+        bool finished = (sync->remaining == 0);
+        sync->abandoned = !finished;
+        taskEXIT_CRITICAL(&sync_lock);
+
+        if (!finished)
+        {
+            ESP_LOGW(TAG, "Transfer timed out after %lu ms", (unsigned long)timeout_ms);
+            return ESP_ERR_TIMEOUT;
+        }
+        // the last step completed between the timeout and the lock, its give is imminent
+        xSemaphoreTake(sync->done, portMAX_DELAY);
+    }
+
+    err = sync->err;
+    if (err == ESP_OK && rx_len > 0)
+    {
+        memcpy(rx, sync->rx, rx_len);
+    }
+
+    vSemaphoreDelete(sync->done);
+    free(sync);
+    return err;
+}
+
+esp_err_t i2c_user_transfer(i2c_user_device_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                            uint32_t timeout_ms)
+{
+    if (tx_len > I2C_USER_MAX_TX || rx_len > I2C_USER_MAX_RX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_user_transaction_t transaction = {
+        .dev = dev,
+        .tx_len = tx_len,
+        .rx_len = rx_len,
+    };
+    if (tx_len > 0)
+    {
+        memcpy(transaction.tx, tx, tx_len);
+    }
+
+    return i2c_user_transfer_chain(&transaction, 1, rx, rx_len, timeout_ms);
+}
+
+void i2c_user_get_stats(i2c_user_stats_t *out)
+{
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&stats_lock);
+    int64_t elapsed = now - stats.window_start;
+    out->transactions = stats.transactions;
+    out->errors = stats.errors;
+    out->dropped = stats.dropped;
+    out->utilization = (elapsed > 0) ? (float)stats.busy_us / (float)elapsed : 0.0f;
+    out->latency_avg_us = (stats.transactions > 0) ? (uint32_t)(stats.latency_sum_us / stats.transactions) : 0;
+    out->latency_max_us = stats.latency_max_us;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.window_start = now;
+    taskEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#define I2C_USER_PORT 0
+#define I2C_USER_MASTER_SCL_IO 14
+#define I2C_USER_MASTER_SDA_IO 15
+
+#define I2C_USER_TIMEOUT_MS 500
+// how long drivers wait for a blocking transfer, including the queue ahead of it
+#define I2C_USER_TRANSFER_TIMEOUT_MS 1000
+
+#define I2C_USER_MAX_DEVICES 4
+#define I2C_USER_QUEUE_LENGTH 16
+#define I2C_USER_MAX_TX 8
+#define I2C_USER_MAX_RX 12
+// steps of a sequence that has to reach a device without other transactions in between
+#define I2C_USER_MAX_CHAIN 5
+
+typedef struct i2c_user_device i2c_user_device_t;
+
+// runs on the bus manager task once the transaction finished, rx is only valid during the call
+typedef void (*i2c_user_callback_t)(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx);
+
+// a write, a read or a write followed by a repeated start read
+typedef struct
+{
+    i2c_user_device_t *dev;
+    uint8_t tx[I2C_USER_MAX_TX];
+    uint8_t tx_len;
+    uint8_t rx_len;
+    uint16_t delay_us; // keep the bus idle after the transaction, e.g. for command execution times
+    i2c_user_callback_t callback;
+    void *ctx;
+    int64_t submitted;
+} i2c_user_transaction_t;
+
+typedef struct
+{
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t dropped;
+    float utilization;
+    uint32_t latency_avg_us;
+    uint32_t latency_max_us;
+} i2c_user_stats_t;
+
+esp_err_t i2c_init();
+
+esp_err_t i2c_user_add_device(uint8_t address, uint32_t scl_speed_hz, i2c_user_device_t **dev);
+
+// queue a transaction without waiting for the bus
+esp_err_t i2c_user_submit(i2c_user_transaction_t *transaction);
+esp_err_t i2c_user_submit_from_isr(i2c_user_transaction_t *transaction, BaseType_t *woken);
+// queue up to I2C_USER_MAX_CHAIN steps that run back to back, e.g. a command and the read of its response,
+// every step runs even if an earlier one failed and each callback sees its own result
+esp_err_t i2c_user_submit_chain(i2c_user_transaction_t *steps, size_t count);
+// queue a transaction and wait up to timeout_ms for its completion, blocks only the calling task
+// on ESP_ERR_TIMEOUT the transaction still runs but its result is dropped
+// must not be called from a transaction callback
+esp_err_t i2c_user_transfer(i2c_user_device_t *dev, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                            uint32_t timeout_ms);
+// the same for a chain, the steps' callbacks are replaced, rx receives what the last reading step got
+// and the result is the first error of any step
+esp_err_t i2c_user_transfer_chain(i2c_user_transaction_t *steps, size_t count, uint8_t *rx, size_t rx_len, uint32_t timeout_ms);
+
+// statistics since the previous call
+void i2c_user_get_stats(i2c_user_stats_t *stats);
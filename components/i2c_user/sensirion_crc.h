@@ -0,0 +1,24 @@
+#pragma once
+#ifndef SENSIRION_CRC_H
+#define SENSIRION_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// checksum sent after every 16 bit word by the sensirion sensors (sht3x, scd4x)
+// polynomial 0x31, init 0xff, no reflection and no final xor, 0xbeef gives 0x92
+static inline uint8_t sensirion_crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+#endif
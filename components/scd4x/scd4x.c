@@ -0,0 +1,243 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "scd4x.h"
+#include "i2c_user.h"
+#include "sensirion_crc.h"
+#include "timer.h"
+
+static const char* TAG = "SCD4x";
+
+// every command has to be executed before its response can be read
+#define SCD4X_COMMAND_DELAY_US 1000
+#define SCD4X_STOP_DELAY_MS 500
+
+// ask a bit early, a not ready answer is retried shortly after
+#define SCD4X_READY_MARGIN_US 200000
+#define SCD4X_READY_RETRY_US 250000
+#define SCD4X_ERROR_RETRY_US 1000000
+// a queued data-ready check completes within a few ms
+#define SCD4X_BUSY_WAIT_MS 10
+
+// words are sent MSB first, each followed by its crc
+static esp_err_t scd4x_parse_words(const uint8_t* rx, size_t count, uint16_t words[]) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* word = rx + 3 * i;
+        uint8_t crc = sensirion_crc8(word, 2);
+        if(crc != word[2])  {
+            ESP_LOGE(TAG, "CRC mismatch! Got %02x, Expected %02x", crc, word[2]);
+            return ESP_ERR_INVALID_CRC;
+        }
+        words[i] = (word[0] << 8) | word[1];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t scd4x_write_command(scd4x_device_t* dev, uint16_t command)  {
+    uint8_t tx_buffer[2] = {
+        command >> 8,
+        command & 0xFF
+    };
+
+    return i2c_user_transfer(dev->i2c_dev, tx_buffer, 2, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS);
+}
+
+// a command and the read of its response go out as one chain, nothing else may reach the sensor in between
+static esp_err_t scd4x_queue_query(scd4x_device_t* dev, uint16_t command, uint8_t length, i2c_user_callback_t callback)  {
+    i2c_user_transaction_t steps[] = {
+        {
+            .dev = dev->i2c_dev,
+            .tx = { command >> 8, command & 0xFF },
+            .tx_len = 2,
+            .delay_us = SCD4X_COMMAND_DELAY_US,
+        },
+        {
+            .dev = dev->i2c_dev,
+            .rx_len = length,
+            .callback = callback,
+            .ctx = dev,
+        },
+    };
+
+    return i2c_user_submit_chain(steps, 2);
+}
+
+esp_err_t scd4x_init(scd4x_device_t* dev) {
+    dev->initilized = false;
+    dev->periodic = false;
+    dev->busy = false;
+    dev->crc_errors = 0;
+    dev->not_ready = 0;
+
+    dev->results = xQueueCreate(SCD4X_RESULT_QUEUE_LENGTH, sizeof(scd4x_measurement_t));
+    if(dev->results == NULL)    {
+        ESP_LOGE(TAG, "Cannot create result queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = i2c_user_add_device(SCD4X_ADDRESS, SCD4X_SCL_SPEED_HZ, &(dev->i2c_dev));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register I2C device");
+        return err;
+    }
+
+    // the sensor keeps measuring across a reset of the esp, it only accepts commands once stopped
+    dev->initilized = true;
+    err = scd4x_write_command(dev, SCD4X_COMMAND_STOP_PERIODIC);
+    if(err != ESP_OK)   {
+        ESP_LOGE(TAG, "Failed to stop periodic mode");
+        dev->initilized = false;
+        return err;
+    }
+    vTaskDelay(pdMS_TO_TICKS(SCD4X_STOP_DELAY_MS));
+
+    ESP_LOGI(TAG, "Initilized device");
+    return ESP_OK;
+}
+
+esp_err_t scd4x_start_periodic(scd4x_device_t* dev)  {
+    if(!dev->initilized)    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t ret = scd4x_write_command(dev, SCD4X_COMMAND_START_PERIODIC);
+    if(ret != ESP_OK)   {
+        ESP_LOGE(TAG, "Failed to start periodic mode");
+        return ret;
+    }
+
+    dev->periodic = true;
+    dev->next_check_us = esp_timer_get_time() + SCD4X_PERIOD_MS * 1000LL - SCD4X_READY_MARGIN_US;
+    ESP_LOGI(TAG, "Periodic mode started");
+
+    return ESP_OK;
+}
+
+esp_err_t scd4x_stop_periodic(scd4x_device_t* dev)  {
+    if(!dev->periodic)  {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = scd4x_write_command(dev, SCD4X_COMMAND_STOP_PERIODIC);
+    if(ret != ESP_OK)   {
+        return ret;
+    }
+
+    dev->periodic = false;
+    vTaskDelay(pdMS_TO_TICKS(SCD4X_STOP_DELAY_MS));
+    return ESP_OK;
+}
+
+static void scd4x_on_measurement(esp_err_t err, const uint8_t* rx, size_t rx_len, void* ctx)   {
+    scd4x_device_t* dev = (scd4x_device_t*)ctx;
+    dev->busy = false;
+
+    if(err != ESP_OK)   {
+        ESP_LOGW(TAG, "Failed to read measurement");
+        return;
+    }
+
+    uint16_t words[3];
+    if(scd4x_parse_words(rx, 3, words) != ESP_OK)  {
+        dev->crc_errors++;
+        return;
+    }
+
+    scd4x_measurement_t measurement = {
+        .co2_ppm = words[0],
+        .temperature_degC = -45.0f + 175.0f * ((float)words[1] / (float)UINT16_MAX),
+        .relative_humidity = 100.0f * ((float)words[2] / (float)UINT16_MAX),
+        .timestamp = dev->pending_timestamp,
+    };
+
+    if(xQueueSend(dev->results, &measurement, 0) != pdPASS)  {
+        ESP_LOGW(TAG, "Result queue full, dropping sample");
+    }
+}
+
+static void scd4x_on_data_ready(esp_err_t err, const uint8_t* rx, size_t rx_len, void* ctx)   {
+    scd4x_device_t* dev = (scd4x_device_t*)ctx;
+    int64_t now = esp_timer_get_time();
+
+    uint16_t status;
+    if(err != ESP_OK || scd4x_parse_words(rx, 1, &status) != ESP_OK)   {
+        if(err == ESP_OK)   {
+            dev->crc_errors++;
+        }
+        dev->next_check_us = now + SCD4X_ERROR_RETRY_US;
+        dev->busy = false;
+        return;
+    }
+
+    // the lower 11 bits are zero while no result is waiting
+    if((status & 0x07FF) == 0)  {
+        dev->not_ready++;
+        dev->next_check_us = now + SCD4X_READY_RETRY_US;
+        dev->busy = false;
+        return;
+    }
+
+    // the sample was taken just now, the read below only transports it
+    get_current_time(&dev->pending_timestamp);
+    dev->next_check_us = now + SCD4X_PERIOD_MS * 1000LL - SCD4X_READY_MARGIN_US;
+
+    esp_err_t ret = scd4x_queue_query(dev, SCD4X_COMMAND_READ_MEASUREMENT, 9, scd4x_on_measurement);
+    if(ret != ESP_OK)   {
+        ESP_LOGW(TAG, "Cannot queue read");
+        dev->busy = false;
+    }
+}
+
+esp_err_t scd4x_poll(scd4x_device_t* dev, scd4x_measurement_t* measurement)   {
+    if(!dev->initilized || !dev->periodic)  {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if(xQueueReceive(dev->results, measurement, 0) == pdPASS)  {
+        return ESP_OK;
+    }
+
+    if(dev->busy || esp_timer_get_time() < dev->next_check_us)  {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    dev->busy = true;
+    esp_err_t ret = scd4x_queue_query(dev, SCD4X_COMMAND_GET_DATA_READY, 3, scd4x_on_data_ready);
+    if(ret != ESP_OK)   {
+        ESP_LOGW(TAG, "Cannot queue data-ready check");
+        dev->busy = false;
+        return ret;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t scd4x_wait(scd4x_device_t* dev, scd4x_measurement_t* measurement, uint32_t timeout_ms)    {
+    int64_t deadline = esp_timer_get_time() + timeout_ms * 1000LL;
+
+    while(1)    {
+        esp_err_t ret = scd4x_poll(dev, measurement);
+        if(ret != ESP_ERR_NOT_FOUND)    {
+            return ret;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if(now >= deadline) {
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        // sleep on the result queue until the next check is due, while a check is in flight
+        // its outcome is only known from the driver state, so look again shortly
+        int64_t wake = dev->busy ? now + SCD4X_BUSY_WAIT_MS * 1000LL : dev->next_check_us;
+        if(wake > deadline) {
+            wake = deadline;
+        }
+        TickType_t ticks = pdMS_TO_TICKS((wake - now + 999) / 1000);
+        if(xQueueReceive(dev->results, measurement, (ticks > 0) ? ticks : 1) == pdPASS)  {
+            return ESP_OK;
+        }
+    }
+}
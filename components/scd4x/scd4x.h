@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "i2c_user.h"
+
+#define SCD4X_ADDRESS 0x62
+
+// the sensor only runs up to standard mode
+#define SCD4X_SCL_SPEED_HZ 100000
+
+// interval of the standard periodic mode
+#define SCD4X_PERIOD_MS 5000
+
+#define SCD4X_RESULT_QUEUE_LENGTH 4
+
+typedef enum {
+    SCD4X_COMMAND_START_PERIODIC = 0x21B1,
+    SCD4X_COMMAND_READ_MEASUREMENT = 0xEC05,
+    SCD4X_COMMAND_STOP_PERIODIC = 0x3F86,
+    SCD4X_COMMAND_GET_DATA_READY = 0xE4B8,
+    SCD4X_COMMAND_REINIT = 0x3646
+} scd4x_command_t;
+
+typedef struct {
+    uint16_t co2_ppm;
+    float temperature_degC;
+    float relative_humidity;
+    // wall clock ms at which the sensor reported the result ready
+    uint32_t timestamp;
+} scd4x_measurement_t;
+
+typedef struct {
+    i2c_user_device_t* i2c_dev;
+    bool initilized;
+    bool periodic;
+    QueueHandle_t results;
+
+    // the next data-ready check is only issued once the sensor should have a result
+    int64_t next_check_us;
+    volatile bool busy;
+    uint32_t pending_timestamp;
+
+    uint32_t crc_errors;
+    uint32_t not_ready;
+} scd4x_device_t;
+
+esp_err_t scd4x_init(scd4x_device_t* dev);
+
+esp_err_t scd4x_start_periodic(scd4x_device_t* dev);
+esp_err_t scd4x_stop_periodic(scd4x_device_t* dev);
+
+// returns a buffered result or ESP_ERR_NOT_FOUND and never waits for the bus,
+// asks the sensor for data-ready around the time the next result is due
+esp_err_t scd4x_poll(scd4x_device_t* dev, scd4x_measurement_t* measurement);
+// blocks until a result arrived, issuing the data-ready checks of scd4x_poll on the way,
+// returns ESP_ERR_NOT_FOUND once timeout_ms passed without one
+esp_err_t scd4x_wait(scd4x_device_t* dev, scd4x_measurement_t* measurement, uint32_t timeout_ms);
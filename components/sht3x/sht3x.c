@@ -1,33 +1,13 @@
 #include "esp_log.h"
-#include "esp_private/i2c_platform.h"
-#include "driver/i2c_master.h"
 
 #include "sht3x.h"
 #include "i2c_user.h"
+#include "sensirion_crc.h"
 
 static const char* TAG = "SHT3x";
 
-uint8_t crc8_le(uint8_t crc, uint8_t* buf, size_t length) {
-    for (size_t i = 0; i < length; i++) {
-        crc = crc ^ buf[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x80) {
-                crc = (crc << 1) ^ 0x31;
-            } else {
-                crc = crc << 1;
-            }
-        }
-    }
-    return crc;
-}
-
-uint8_t crc8(uint8_t init, uint8_t* buf, size_t length) {
-    uint8_t crc = ~init;
-    for (size_t i = 0; i < length; i++) {
-        crc = crc8_le(crc, &buf[i], 1);
-    }
-    return ~crc;
-}
+// time the sensor needs to abort a periodic measurement after a break
+#define SHT3X_BREAK_DELAY_US 1000
 
 float temperature_to_float(uint16_t temperature_raw)    {
     return -45.0 + 175.0 * ((float)temperature_raw / (float)UINT16_MAX);
@@ -37,44 +17,24 @@ float humidity_to_float(uint16_t humidity_raw)  {
     return 100.0 * ((float)humidity_raw / (float)UINT16_MAX);
 }
 
-esp_err_t sht3x_init(sht3x_device_t* dev, sht3x_address_t address, i2c_port_num_t i2c_port) {
+esp_err_t sht3x_init(sht3x_device_t* dev, sht3x_address_t address) {
     dev->initilized = false;
-
-    // FIXME remove this
-    uint8_t test_data[] = {
-        0xBE, 0xEF
-    };
-    uint8_t calc_crc= crc8(0xFF, test_data + 3, 2);
-    ESP_LOGI(TAG, "CRC8 Test: %02x", calc_crc);
-
+    dev->periodic = false;
+    dev->last_status.raw = 0;
+    dev->crc_errors = 0;
 
     if(address != address_A && address != address_B )   {
         ESP_LOGE(TAG, "Invalid address %02x", address);
         return ESP_FAIL;
     }
 
-    i2c_device_config_t dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = address,
-        .scl_speed_hz = 400000,
-    };
-
-    i2c_master_bus_handle_t bus_handle;
-    esp_err_t err = i2c_master_get_bus_handle(i2c_port, &bus_handle);
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to get I2C Bus handle");
-        return err;
-    }
-
-    err = i2c_master_probe(bus_handle, address, I2C_USER_TIMEOUT_MS);
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Cannot find device at address %02x", address);
-        return err;
+    dev->results = xQueueCreate(SHT3X_RESULT_QUEUE_LENGTH, sizeof(sht3x_measurement_t));
+    if(dev->results == NULL)    {
+        ESP_LOGE(TAG, "Cannot create result queue");
+        return ESP_ERR_NO_MEM;
     }
 
-    err = i2c_master_bus_add_device(bus_handle, &dev_cfg, &(dev->i2c_dev));
+    esp_err_t err = i2c_user_add_device(address, 400000, &(dev->i2c_dev));
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to register I2C device");
@@ -86,21 +46,71 @@ esp_err_t sht3x_init(sht3x_device_t* dev, sht3x_address_t address, i2c_port_num_
     return ESP_OK;
 }
 
-esp_err_t sht3x_start_measurement(sht3x_device_t* dev, sht3x_measurement_command_t measurement_mode)    {
-    if(!dev->initilized)    {
-        return ESP_FAIL;
+// steps of a chain, a command and the read of its response must not be split by another task's sequence
+// commands are sent MSB first
+static i2c_user_transaction_t sht3x_command_step(sht3x_device_t* dev, uint16_t command, uint16_t delay_us)  {
+    return (i2c_user_transaction_t){
+        .dev = dev->i2c_dev,
+        .tx = { command >> 8, command & 0xFF },
+        .tx_len = 2,
+        .delay_us = delay_us,
+    };
+}
+
+static i2c_user_transaction_t sht3x_read_step(sht3x_device_t* dev, uint8_t length, i2c_user_callback_t callback)   {
+    return (i2c_user_transaction_t){
+        .dev = dev->i2c_dev,
+        .rx_len = length,
+        .callback = callback,
+        .ctx = dev,
+    };
+}
+
+// blocks until the command and its execution time are through, the bus task does the waiting
+static esp_err_t sht3x_write_command(sht3x_device_t* dev, uint16_t command, uint16_t delay_us)  {
+    i2c_user_transaction_t step = sht3x_command_step(dev, command, delay_us);
+    return i2c_user_transfer_chain(&step, 1, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS);
+}
+
+static esp_err_t sht3x_parse_measurement(const uint8_t rx_buffer[6], sht3x_measurement_t* measurement)    {
+    uint8_t temp_crc = sensirion_crc8(rx_buffer + 0, 2);
+    uint8_t humid_crc = sensirion_crc8(rx_buffer + 3, 2);
+
+    if(temp_crc != rx_buffer[2])    {
+        ESP_LOGE(TAG, "Temperature CRC mismatch! Got %02x, Expected %02x", temp_crc, rx_buffer[2]);
+        return ESP_ERR_INVALID_CRC;
     }
+    if(humid_crc != rx_buffer[5])    {
+        ESP_LOGE(TAG, "Humidity CRC mismatch! Got %02x, Expected %02x", humid_crc, rx_buffer[5]);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    measurement->temperature_raw = (rx_buffer[0] << 8) | rx_buffer[1];
+    measurement->humidity_raw = (rx_buffer[3] << 8) | rx_buffer[4];
+
+    measurement->temperature_degC = temperature_to_float(measurement->temperature_raw);
+    measurement->relative_humidity = humidity_to_float(measurement->humidity_raw);
 
-    union {
-        uint16_t value;
-        uint8_t bytes[2];
-    } tx_buffer;
+    return ESP_OK;
+}
 
-    tx_buffer.value = measurement_mode;
+static esp_err_t sht3x_parse_status(const uint8_t rx_buffer[3], sht3x_status_t* status)   {
+    uint8_t status_crc = sensirion_crc8(rx_buffer, 2);
+    if(status_crc != rx_buffer[2])  {
+        ESP_LOGE(TAG, "Status CRC mismatch! Got %02x, Expected %02x", status_crc, rx_buffer[2]);
+        return ESP_ERR_INVALID_CRC;
+    }
 
-    esp_err_t ret = i2c_master_transmit(dev->i2c_dev, tx_buffer.bytes, 2, I2C_USER_TIMEOUT_MS);
+    status->raw = (rx_buffer[0] << 8) | rx_buffer[1];
+    return ESP_OK;
+}
 
-    return ret;
+esp_err_t sht3x_start_measurement(sht3x_device_t* dev, sht3x_measurement_command_t measurement_mode)    {
+    if(!dev->initilized)    {
+        return ESP_FAIL;
+    }
+
+    return sht3x_write_command(dev, measurement_mode, 0);
 }
 
 esp_err_t sht3x_read_measurement(sht3x_device_t* dev, sht3x_measurement_t* measurement) {
@@ -110,42 +120,173 @@ esp_err_t sht3x_read_measurement(sht3x_device_t* dev, sht3x_measurement_t* measu
 
     uint8_t rx_buffer[6];
 
-    esp_err_t ret = i2c_master_receive(dev->i2c_dev, rx_buffer, 6, I2C_USER_TIMEOUT_MS);
+    esp_err_t ret = i2c_user_transfer(dev->i2c_dev, NULL, 0, rx_buffer, 6, I2C_USER_TRANSFER_TIMEOUT_MS);
 
     if(ret != ESP_OK)   {
         ESP_LOGE(TAG, "Failed to get measurement");
         return ret;
     }
 
-    uint8_t temp_crc = crc8(0xFF, rx_buffer + 0, 2);
-    uint8_t humid_crc = crc8(0xFF, rx_buffer + 3, 2);
+    return sht3x_parse_measurement(rx_buffer, measurement);
+}
 
-    if(temp_crc != rx_buffer[2])    {
-        ESP_LOGE(TAG, "Temperature CRC mismatch! Got %02x, Expected %02x", temp_crc, rx_buffer[2]);
+esp_err_t sht3x_start_periodic(sht3x_device_t* dev, sht3x_measurement_command_t periodic_mode)  {
+    if(!dev->initilized)    {
         return ESP_FAIL;
     }
-    if(humid_crc != rx_buffer[5])    {
-        ESP_LOGE(TAG, "Humidity CRC mismatch! Got %02x, Expected %02x", humid_crc, rx_buffer[5]);
-        return ESP_FAIL;
+
+    // all periodic commands have an MSB between 0x20 and 0x27
+    if((periodic_mode >> 8) < 0x20 || (periodic_mode >> 8) > 0x27)   {
+        ESP_LOGE(TAG, "Not a periodic mode %04x", periodic_mode);
+        return ESP_ERR_INVALID_ARG;
     }
 
-    measurement->temperature_raw = (rx_buffer[0] << 8) | rx_buffer[1];
-    measurement->humidity_raw = (rx_buffer[3] << 8) | rx_buffer[4];
+    esp_err_t ret = sht3x_write_command(dev, periodic_mode, 0);
+    if(ret != ESP_OK)   {
+        ESP_LOGE(TAG, "Failed to start periodic mode");
+        return ret;
+    }
 
-    measurement->temperature_degC = temperature_to_float(measurement->temperature_raw);
-    measurement->relative_humidity = humidity_to_float(measurement->humidity_raw);
+    dev->periodic = true;
+    dev->periodic_mode = periodic_mode;
+    ESP_LOGI(TAG, "Periodic mode %04x started", periodic_mode);
 
     return ESP_OK;
 }
 
-esp_err_t sht3x_read_measurements(sht3x_device_t* dev, sht3x_measurement_t measurements[], uint8_t count)   {
-    return  ESP_OK;
+esp_err_t sht3x_stop_periodic(sht3x_device_t* dev)  {
+    if(!dev->periodic)  {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = sht3x_send_command(dev, COMMAND_BREAK);
+    if(ret == ESP_OK)   {
+        dev->periodic = false;
+    }
+
+    return ret;
+}
+
+static void sht3x_on_fetch(esp_err_t err, const uint8_t* rx, size_t rx_len, void* ctx)   {
+    sht3x_device_t* dev = (sht3x_device_t*)ctx;
+
+    // a NACK only means the next periodic result is not ready yet
+    if(err != ESP_OK)   {
+        return;
+    }
+
+    sht3x_measurement_t measurement;
+    if(sht3x_parse_measurement(rx, &measurement) != ESP_OK)  {
+        dev->crc_errors++;
+        return;
+    }
+
+    if(xQueueSend(dev->results, &measurement, 0) != pdPASS)  {
+        ESP_LOGW(TAG, "Result queue full, dropping sample");
+    }
+}
+
+esp_err_t sht3x_read_measurements(sht3x_device_t* dev, sht3x_measurement_t measurements[], uint8_t count, uint8_t* fetched)   {
+    *fetched = 0;
+
+    if(!dev->initilized || !dev->periodic)  {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // results of earlier fetches
+    while(*fetched < count && xQueueReceive(dev->results, &measurements[*fetched], 0) == pdPASS)  {
+        (*fetched)++;
+    }
+
+    // the sensor only holds its latest result, fetch it for the next call
+    i2c_user_transaction_t steps[] = {
+        sht3x_command_step(dev, COMMAND_FETCH, 0),
+        sht3x_read_step(dev, 6, sht3x_on_fetch),
+    };
+    esp_err_t ret = i2c_user_submit_chain(steps, 2);
+    if(ret != ESP_OK)   {
+        ESP_LOGW(TAG, "Cannot queue fetch");
+    }
+
+    return (*fetched > 0) ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
 esp_err_t sht3x_read_status(sht3x_device_t* dev, sht3x_status_t* status)    {
-    return  ESP_OK;
+    if(!dev->initilized)    {
+        return ESP_FAIL;
+    }
+
+    i2c_user_transaction_t steps[] = {
+        sht3x_command_step(dev, COMMAND_READ_STATUS_REG, 0),
+        sht3x_read_step(dev, 3, NULL),
+    };
+    uint8_t rx_buffer[3];
+    esp_err_t ret = i2c_user_transfer_chain(steps, 2, rx_buffer, 3, I2C_USER_TRANSFER_TIMEOUT_MS);
+    if(ret != ESP_OK)   {
+        ESP_LOGE(TAG, "Failed to read status");
+        return ret;
+    }
+
+    return sht3x_parse_status(rx_buffer, status);
+}
+
+static void sht3x_on_status(esp_err_t err, const uint8_t* rx, size_t rx_len, void* ctx)   {
+    sht3x_device_t* dev = (sht3x_device_t*)ctx;
+
+    if(err != ESP_OK)   {
+        ESP_LOGE(TAG, "Failed to read status");
+        return;
+    }
+
+    sht3x_status_t status;
+    if(sht3x_parse_status(rx, &status) != ESP_OK)    {
+        dev->crc_errors++;
+        return;
+    }
+
+    if(status.bits.alert_pending || status.bits.t_tracking_alert || status.bits.rh_tracking_alert)    {
+        ESP_LOGW(TAG, "Alert pending (status %04x)", status.raw);
+    }
+    if(status.bits.system_reset_detect)    {
+        ESP_LOGW(TAG, "Sensor reset detected");
+    }
+    if(status.bits.command_status || status.bits.write_data_checksum_status)  {
+        ESP_LOGW(TAG, "Last command failed (status %04x)", status.raw);
+    }
+
+    dev->last_status = status;
+}
+
+esp_err_t sht3x_check_status(sht3x_device_t* dev, sht3x_status_t* status)   {
+    if(!dev->initilized)    {
+        return ESP_FAIL;
+    }
+
+    *status = dev->last_status;
+
+    i2c_user_transaction_t steps[I2C_USER_MAX_CHAIN];
+    size_t count = 0;
+
+    // the status register cannot be read while the sensor is free-running
+    if(dev->periodic)    {
+        steps[count++] = sht3x_command_step(dev, COMMAND_BREAK, SHT3X_BREAK_DELAY_US);
+    }
+    steps[count++] = sht3x_command_step(dev, COMMAND_READ_STATUS_REG, 0);
+    steps[count++] = sht3x_read_step(dev, 3, sht3x_on_status);
+    steps[count++] = sht3x_command_step(dev, COMMAND_CLEAR_STATUS_REG, 0);
+
+    // re-arm in any case, this also recovers from a sensor reset
+    if(dev->periodic)    {
+        steps[count++] = sht3x_command_step(dev, dev->periodic_mode, 0);
+    }
+
+    return i2c_user_submit_chain(steps, count);
 }
 
 esp_err_t sht3x_send_command(sht3x_device_t* dev, sht3x_command_t command)  {
-    return  ESP_OK;
+    if(!dev->initilized)    {
+        return ESP_FAIL;
+    }
+
+    return sht3x_write_command(dev, command, (command == COMMAND_BREAK) ? SHT3X_BREAK_DELAY_US : 0);
 }
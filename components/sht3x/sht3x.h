@@ -1,8 +1,15 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
-#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "i2c_user.h"
+
+// periodic results buffered between fetches and reads
+#define SHT3X_RESULT_QUEUE_LENGTH 4
 
 typedef enum {
     address_A = 0x44, // addr pin low
@@ -76,17 +83,31 @@ typedef struct {
 } sht3x_measurement_t;
 
 typedef struct {
-    i2c_master_dev_handle_t i2c_dev;
+    i2c_user_device_t* i2c_dev;
     bool initilized;
+    bool periodic;
+    sht3x_measurement_command_t periodic_mode;
+    QueueHandle_t results;
+    sht3x_status_t last_status;
+    uint32_t crc_errors;
 } sht3x_device_t;
 
-esp_err_t sht3x_init(sht3x_device_t* dev, sht3x_address_t address, i2c_port_num_t i2c_port);
+esp_err_t sht3x_init(sht3x_device_t* dev, sht3x_address_t address);
 
 esp_err_t sht3x_start_measurement(sht3x_device_t* dev, sht3x_measurement_command_t measurement_mode);
 
 esp_err_t sht3x_read_measurement(sht3x_device_t* dev, sht3x_measurement_t* measurement);
-esp_err_t sht3x_read_measurements(sht3x_device_t* dev, sht3x_measurement_t measurements[], uint8_t count);
+
+// periodic mode: the sensor free-runs at the given rate and results are fetched without clock stretching
+esp_err_t sht3x_start_periodic(sht3x_device_t* dev, sht3x_measurement_command_t periodic_mode);
+esp_err_t sht3x_stop_periodic(sht3x_device_t* dev);
+// drains up to count buffered periodic results without blocking and queues the next fetch,
+// returns ESP_ERR_NOT_FOUND if none were ready
+esp_err_t sht3x_read_measurements(sht3x_device_t* dev, sht3x_measurement_t measurements[], uint8_t count, uint8_t* fetched);
 
 esp_err_t sht3x_read_status(sht3x_device_t* dev, sht3x_status_t* status);
+// queues a read and clear of the status register and re-arms periodic mode, which also recovers
+// from an unexpected sensor reset; returns the result of the previous check
+esp_err_t sht3x_check_status(sht3x_device_t* dev, sht3x_status_t* status);
 
 esp_err_t sht3x_send_command(sht3x_device_t* dev, sht3x_command_t command);
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <stdint.h>
+
+// running summary of a sample window, updated in O(1) per sample
+// variance is tracked with Welford's method so no samples are kept
+typedef struct
+{
+    uint32_t count;
+    float mean;
+    float m2;
+    float min;
+    float max;
+    uint32_t first_timestamp;
+    uint32_t last_timestamp;
+} aggregator_t;
+
+void aggregator_reset(aggregator_t *agg);
+void aggregator_add(aggregator_t *agg, uint32_t timestamp, float value);
+float aggregator_variance(const aggregator_t *agg);
+
+#endif
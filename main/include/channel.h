@@ -0,0 +1,67 @@
+#pragma once
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "aggregator.h"
+#include "decimator.h"
+#include "median_filter.h"
+#include "series.h"
+
+typedef struct
+{
+    const char *type;
+
+    // Hampel outlier rejection in front of everything else, a window of 0 disables it
+    uint16_t outlier_window;
+    float outlier_threshold;
+    float outlier_min_deviation;
+
+    // CIC decimation in front of the window, a ratio of 0 or 1 disables it
+    uint8_t decimation_order;
+    uint16_t decimation_ratio;
+
+    // report by exception: only publish when the mean moved beyond either deadband
+    // or the heartbeat interval (ms) passed since the last upload, 0 disables each
+    float deadband_absolute;
+    float deadband_relative;
+    uint32_t heartbeat_interval;
+
+    // additionally record every accepted sample into compressed blocks uploaded when full
+    bool raw_series;
+} channel_config_t;
+
+// a single published sensor value
+// samples are folded into the window on update and sent as a summary on publish
+typedef struct
+{
+    const channel_config_t *config;
+    hampel_filter_t outlier_filter;
+    decimator_t decimator;
+    aggregator_t window;
+    uint32_t rejected;
+
+    bool has_published;
+    float last_published;
+    uint32_t last_publish_time;
+    uint32_t suppressed;
+    uint32_t total_suppressed;
+    uint32_t total_empty;
+
+    series_block_t *series;
+} channel_t;
+
+esp_err_t channel_init(channel_t *channel, const channel_config_t *config);
+esp_err_t channel_update(channel_t *channel, float value);
+// for samples whose acquisition time is known, time in ms like get_current_time
+esp_err_t channel_update_at(channel_t *channel, float value, uint32_t time);
+esp_err_t channel_publish(channel_t *channel);
+// channels read from the same sensor are sent as one record
+esp_err_t channel_publish_group(channel_t *const channels[], size_t count);
+
+#endif
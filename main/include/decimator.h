@@ -0,0 +1,30 @@
+#pragma once
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#define DECIMATOR_MAX_ORDER 4
+
+// cascaded integrator-comb decimation filter
+// runs per sample in fixed point, the boxcar of order 1 is the old MVA
+typedef struct
+{
+    uint8_t order;
+    uint16_t ratio;
+    uint16_t phase;
+    uint8_t warmup;
+    int64_t gain;
+    // unsigned so that the integrators wrap around without undefined behaviour
+    uint64_t integrators[DECIMATOR_MAX_ORDER];
+    uint64_t combs[DECIMATOR_MAX_ORDER];
+} decimator_t;
+
+esp_err_t decimator_init(decimator_t *dec, uint8_t order, uint16_t ratio);
+void decimator_reset(decimator_t *dec);
+bool decimator_push(decimator_t *dec, float sample, float *out);
+
+#endif
@@ -2,4 +2,7 @@
 
 #define API_V1_GET_STATE "https://warr.robin-prillwitz.de/api/v1/state/1"
 #define API_V1_POST_IMAGE "http://192.168.178.85:8080/api/v1/image"
+#define API_V1_IMAGE_CHUNK "http://192.168.178.85:8080/api/v1/image/chunk"
 #define API_V1_POST_MEASUREMENT "http://192.168.178.85:8080/api/v1/measurement"
+#define API_V1_POST_SERIES "http://192.168.178.85:8080/api/v1/series"
+#define API_V1_POST_METRICS "http://192.168.178.85:8080/api/v1/metrics"
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef IMAGE_STATS_H
+#define IMAGE_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+// bins per color channel, the 5 and 6 bit rgb565 values are shifted down to fit
+#define IMAGE_HISTOGRAM_BINS 16
+
+// region in pixels of the analysed image
+typedef struct
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+} image_roi_t;
+
+typedef struct
+{
+    uint32_t pixels;
+    uint32_t histogram_r[IMAGE_HISTOGRAM_BINS];
+    uint32_t histogram_g[IMAGE_HISTOGRAM_BINS];
+    uint32_t histogram_b[IMAGE_HISTOGRAM_BINS];
+    // normalized to 0..1
+    float mean_r;
+    float mean_g;
+    float mean_b;
+    float green_red_ratio;
+    // excess green of the mean chromaticity, (2g - r - b) / (r + g + b)
+    float biomass_index;
+} image_stats_t;
+
+// rgb565 as written by jpg2rgb565, high byte first, stride in pixels
+esp_err_t image_stats_rgb565(const uint8_t *pixels, uint16_t width, uint16_t height,
+                             const image_roi_t *roi, image_stats_t *stats);
+
+// difference hash of the luma, 9x8 block means compared left to right, one bit per pair
+// similar images differ in few bits, the image has to be at least 9x8 pixels
+uint64_t image_dhash_rgb565(const uint8_t *pixels, uint16_t width, uint16_t height);
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+#ifndef LOCKIN_H
+#define LOCKIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#define LOCKIN_MAX_PERIOD 64
+
+// synchronous demodulator against a sampled sine and cosine reference
+// samples are signed and the reference repeats every period samples
+typedef struct
+{
+    uint16_t period;
+    uint16_t phase;
+    // q15, every table sums to exactly zero so a constant offset cancels over full periods
+    int16_t sin_table[LOCKIN_MAX_PERIOD];
+    int16_t cos_table[LOCKIN_MAX_PERIOD];
+    int64_t i_sum;
+    int64_t q_sum;
+    int64_t dc_sum;
+    uint32_t count;
+} lockin_t;
+
+typedef struct
+{
+    // of the fundamental, in sample units
+    float amplitude;
+    // radians, relative to the start of the first period
+    float phase;
+    float dc;
+    uint32_t periods;
+} lockin_result_t;
+
+// the period has to be even
+esp_err_t lockin_init(lockin_t *lockin, uint16_t period);
+void lockin_reset(lockin_t *lockin);
+void lockin_push(lockin_t *lockin, const int16_t *samples, size_t count);
+// only whole periods are evaluated
+bool lockin_result(const lockin_t *lockin, lockin_result_t *result);
+
+#endif
@@ -2,13 +2,34 @@
 #ifndef MEASUREMENT_H
 #define MEASUREMENT_H
 
+#include <stdint.h>
+
+#define MEASUREMENT_MAX_VALUES 4
+
+// window summary of one channel, value holds the mean
 typedef struct
 {
-    uint32_t timestamp;
+    const char *type;
     float value;
-    char *type;
+    uint32_t count;
+    float min;
+    float max;
+    float variance;
+    uint32_t first_timestamp;
+    uint32_t last_timestamp;
+    uint32_t rejected;
+    uint32_t suppressed;
+} measurement_value_t;
+
+// channels published together share one queue entry and one request
+typedef struct
+{
+    uint32_t timestamp;
+    uint8_t count;
+    measurement_value_t values[MEASUREMENT_MAX_VALUES];
 } measurement_t;
 
 void send_measurement_task(void *pvparameters);
+void send_series_task(void *pvparameters);
 
 #endif
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MEDIAN_FILTER_H
+#define MEDIAN_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#define MEDIAN_FILTER_MAX_WINDOW 1024
+
+// sliding window median over the last `size` samples
+// the window is split into a max heap (lower half) and a min heap (upper half),
+// every slot remembers its heap position so the oldest sample is removed in O(log n)
+typedef struct
+{
+    uint16_t size;
+    uint16_t count;
+    uint16_t head;
+
+    float *values;
+    int16_t *position; // >= 0 index into lower, < 0 ~index into upper
+
+    uint16_t *lower;
+    uint16_t lower_count;
+    uint16_t *upper;
+    uint16_t upper_count;
+} rolling_median_t;
+
+esp_err_t rolling_median_init(rolling_median_t *rm, uint16_t size);
+void rolling_median_free(rolling_median_t *rm);
+void rolling_median_push(rolling_median_t *rm, float value);
+float rolling_median_get(const rolling_median_t *rm);
+
+// Hampel identifier: rejects samples further than threshold * sigma from the window median,
+// sigma is estimated from the rolling median of recent absolute deviations (scaled MAD)
+typedef struct
+{
+    float threshold;
+    float min_deviation;
+    rolling_median_t values;
+    rolling_median_t deviations;
+    uint32_t accepted;
+    uint32_t rejected;
+} hampel_filter_t;
+
+esp_err_t hampel_init(hampel_filter_t *filter, uint16_t window, float threshold, float min_deviation);
+void hampel_free(hampel_filter_t *filter);
+bool hampel_push(hampel_filter_t *filter, float value);
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <cJSON.h>
+
+#define METRICS_MAX 48
+#define METRICS_HISTOGRAM_BUCKETS 8
+
+typedef enum
+{
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} metric_kind_t;
+
+// one registered metric, its id is the position in the registry
+// values are 32 bit atomics, the histogram sum is 64 bit so it does not wrap, updates never lock
+typedef struct
+{
+    const char *name;
+    metric_kind_t kind;
+    // running total of a counter, float bits of a gauge
+    atomic_uint_least32_t value;
+    // upper bounds of a histogram, ascending, the last bucket takes everything above
+    uint32_t bounds[METRICS_HISTOGRAM_BUCKETS];
+    uint8_t bound_count;
+    atomic_uint_least32_t buckets[METRICS_HISTOGRAM_BUCKETS + 1];
+    atomic_uint_least64_t sum;
+} metric_t;
+
+// registration is meant for init, a name already taken returns the existing metric
+// the name has to outlive the registry, NULL when the registry is full
+metric_t *metrics_counter(const char *name);
+metric_t *metrics_gauge(const char *name);
+metric_t *metrics_histogram(const char *name, const uint32_t *bounds, uint8_t count);
+
+metric_t *metrics_find(const char *name);
+size_t metrics_count();
+metric_t *metrics_get(size_t id);
+
+// safe from any task, a NULL metric is ignored so a failed registration needs no checks
+void metrics_add(metric_t *metric, uint32_t count);
+void metrics_set(metric_t *metric, float value);
+void metrics_observe(metric_t *metric, uint32_t value);
+
+uint32_t metrics_counter_value(const metric_t *metric);
+float metrics_gauge_value(const metric_t *metric);
+uint64_t metrics_histogram_sum(const metric_t *metric);
+
+// every registered metric keyed by name: counters and gauges as numbers,
+// histograms as {bounds, buckets, sum} with one bucket more than bounds
+cJSON *metrics_to_json();
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#ifndef PID_H
+#define PID_H
+
+#include <stdbool.h>
+
+typedef struct
+{
+    float kp;
+    float ki;
+    float kd;
+    float output_min;
+    float output_max;
+    // largest output change per second, 0 disables the limit
+    float slew_rate;
+} pid_config_t;
+
+typedef struct
+{
+    pid_config_t config;
+    float integral;
+    float previous_measurement;
+    float output;
+    bool primed;
+} pid_controller_t;
+
+void pid_init(pid_controller_t *pid, const pid_config_t *config);
+// forget the integral and the derivative history, the output restarts at 0
+void pid_reset(pid_controller_t *pid);
+// dt in seconds
+float pid_update(pid_controller_t *pid, float setpoint, float measurement, float dt);
+
+#endif
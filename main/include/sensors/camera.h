@@ -6,3 +6,8 @@ esp_err_t camera_start();
 esp_err_t camera_update();
 esp_err_t camera_publish();
 esp_err_t camera_end();
+
+// the next capture is uploaded as a full frame whatever the schedule says
+void camera_request_full_frame();
+// a rapid series of full frames, uploaded once the capture is done
+void camera_request_burst();
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SERIES_BLOCK_BYTES 512
+
+// block of (timestamp, value) samples compressed as in Facebook's Gorilla:
+// timestamps as delta-of-delta in variable length buckets, values as XOR against the previous float
+// bitstream is MSB first, starting with the raw 32 bit first timestamp and value
+typedef struct
+{
+    const char *type;
+    uint16_t count;
+    uint16_t bit_length;
+    uint32_t first_timestamp;
+
+    // encoder state
+    uint32_t prev_timestamp;
+    int32_t prev_delta;
+    uint32_t prev_value;
+    uint8_t prev_leading;
+    uint8_t prev_trailing;
+
+    uint8_t data[SERIES_BLOCK_BYTES];
+} series_block_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t length;
+    size_t bit_pos;
+    uint16_t count;
+    uint16_t index;
+
+    uint32_t prev_timestamp;
+    int32_t prev_delta;
+    uint32_t prev_value;
+    uint8_t prev_leading;
+    uint8_t prev_trailing;
+} series_decoder_t;
+
+void series_block_reset(series_block_t *block, const char *type);
+bool series_block_append(series_block_t *block, uint32_t timestamp, float value);
+size_t series_block_size(const series_block_t *block);
+
+void series_decoder_init(series_decoder_t *decoder, const uint8_t *data, size_t length, uint16_t count);
+bool series_decoder_next(series_decoder_t *decoder, uint32_t *timestamp, float *value);
+
+#endif
@@ -33,9 +33,9 @@ interval_task_interface_t task_manager_interface = {
 interval_task_interface_t camera_task_interface = {
     .name = "camera_task",
     .force_publish = 0,
-    .disable_update = true,
+    .disable_update = false,
     .disable_publish = false,
-    .publish_interval = 30ULL * 1000ULL,
+    .publish_interval = 60ULL * 1000ULL,
     .update_interval = 10ULL * 1000ULL,
     .task_interval = 1ULL * 1000ULL,
     .init = camera_init,
@@ -51,8 +51,8 @@ interval_task_interface_t temp_task_interface = {
     .disable_update = false,
     .disable_publish = false,
     .publish_interval = 10ULL * 1000ULL,
-    .update_interval = 100ULL,
-    .task_interval = 25ULL,
+    .update_interval = 500ULL,
+    .task_interval = 100ULL,
     .init = temp_init,
     .start = temp_start,
     .update = temp_update,
@@ -65,8 +65,9 @@ interval_task_interface_t gas_task_interface = {
     .disable_update = false,
     .disable_publish = false,
     .publish_interval = 60ULL * 1000ULL,
-    .update_interval = 1ULL * 1000ULL,
-    .task_interval = 250ULL,
+    // gas_update blocks until the next result, about every 5 s
+    .update_interval = 0ULL,
+    .task_interval = 100ULL,
     .init = gas_init,
     .start = gas_start,
     .update = gas_update,
@@ -81,7 +82,7 @@ interval_task_interface_t od_task_interface = {
     .disable_publish = false,
     .publish_interval = 5ULL * 60ULL * 1000ULL,
     .update_interval = 60ULL * 1000ULL,
-    .task_interval = 1000ULL,
+    .task_interval = 100ULL,
     .init = od_init,
     .start = od_start,
     .update = od_update,
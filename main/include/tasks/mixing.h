@@ -1,8 +1,28 @@
 #pragma once
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+typedef enum
+{
+    MIXING_ACTIVE,
+    MIXING_SETTLING,
+    MIXING_QUIET
+} mixing_phase_t;
+
+// set for the whole quiet window, cleared before the pump and aerator start again
+#define MIXING_QUIET_BIT BIT0
 
 esp_err_t mixing_init();
 esp_err_t mixing_start();
 esp_err_t mixing_update();
 esp_err_t mixing_publish();
 esp_err_t mixing_end();
+
+EventGroupHandle_t mixing_get_events();
+mixing_phase_t mixing_get_phase();
+// the current quiet window in esp_timer time and the mixing cycle it belongs to,
+// false outside of one; without mixing running every moment is quiet
+bool mixing_get_quiet_window(int64_t *since_us, int64_t *until_us, uint32_t *cycle);
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#include "sht3x.h"
+
+// control period, the SHT3x has to run at the same rate
+#define TEC_PERIOD_US 100000ULL
+
+typedef struct
+{
+    float temperature;
+    float humidity;
+    float output;
+} tec_sample_t;
+
+typedef struct
+{
+    uint32_t cycles;
+    uint32_t overruns;
+    uint32_t sensor_misses;
+    uint32_t jitter_avg_us;
+    uint32_t jitter_max_us;
+    uint32_t compute_avg_us;
+    uint32_t compute_max_us;
+} tec_stats_t;
+
+// starts the control loop on the given sensor, which must already run periodically
+// the output stays off until both a setpoint and the gains were set
+esp_err_t tec_init(sht3x_device_t *sensor);
+void tec_set_setpoint(float temperature);
+// NAN until a setpoint was set
+float tec_get_setpoint();
+// restarts the controller if the gains changed
+void tec_set_gains(float kp, float ki, float kd);
+// every reading taken by the loop, never blocks
+bool tec_receive_sample(tec_sample_t *sample);
+// statistics since the previous call
+void tec_get_stats(tec_stats_t *stats);
@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "aggregator.h"
+
+void aggregator_reset(aggregator_t *agg)
+{
+    agg->count = 0;
+    agg->mean = 0.0f;
+    agg->m2 = 0.0f;
+    agg->min = INFINITY;
+    agg->max = -INFINITY;
+    agg->first_timestamp = 0;
+    agg->last_timestamp = 0;
+}
+
+void aggregator_add(aggregator_t *agg, uint32_t timestamp, float value)
+{
+    if (agg->count == 0)
+    {
+        agg->first_timestamp = timestamp;
+    }
+    agg->last_timestamp = timestamp;
+    agg->count++;
+
+    // Welford update
+    float delta = value - agg->mean;
+    agg->mean += delta / (float)agg->count;
+    agg->m2 += delta * (value - agg->mean);
+
+    if (value < agg->min)
+    {
+        agg->min = value;
+    }
+    if (value > agg->max)
+    {
+        agg->max = value;
+    }
+}
+
+float aggregator_variance(const aggregator_t *agg)
+{
+    // sample variance, undefined for less than two samples
+    if (agg->count < 2)
+    {
+        return 0.0f;
+    }
+    return agg->m2 / (float)(agg->count - 1);
+}
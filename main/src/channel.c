@@ -0,0 +1,252 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "timer.h"
+#include "measurement.h"
+#include "channel.h"
+
+static const char *TAG = "Channel";
+
+extern QueueHandle_t xMeasurementQueue;
+extern QueueHandle_t xSeriesQueue;
+
+static bool channel_filters_outliers(const channel_t *channel)
+{
+    return channel->config->outlier_window > 0;
+}
+
+static bool channel_decimates(const channel_t *channel)
+{
+    return channel->config->decimation_ratio > 1;
+}
+
+static bool channel_should_report(const channel_t *channel, float value, uint32_t now)
+{
+    const channel_config_t *config = channel->config;
+
+    if (!channel->has_published)
+    {
+        return true;
+    }
+
+    if (config->deadband_absolute <= 0.0f && config->deadband_relative <= 0.0f)
+    {
+        return true;
+    }
+
+    float delta = fabsf(value - channel->last_published);
+    if (config->deadband_absolute > 0.0f && delta > config->deadband_absolute)
+    {
+        return true;
+    }
+    if (config->deadband_relative > 0.0f && delta > config->deadband_relative * fabsf(channel->last_published))
+    {
+        return true;
+    }
+
+    // heartbeat so the server can tell a quiet channel from a dead one
+    return (config->heartbeat_interval > 0) && ((now - channel->last_publish_time) >= config->heartbeat_interval);
+}
+
+static void channel_record_sample(channel_t *channel, uint32_t time, float value)
+{
+    if (series_block_append(channel->series, time, value))
+    {
+        return;
+    }
+
+    // block is full, hand it over to the upload task and start a new one
+    ESP_LOGD(TAG, "%s: series block full (%u samples, %zu bytes)", channel->config->type,
+             channel->series->count, series_block_size(channel->series));
+
+    if (xSeriesQueue != NULL && xQueueSend(xSeriesQueue, &channel->series, 0) == pdPASS)
+    {
+        channel->series = malloc(sizeof(series_block_t));
+        if (channel->series == NULL)
+        {
+            ESP_LOGE(TAG, "%s: cannot allocate series block, raw series stopped", channel->config->type);
+            return;
+        }
+    }
+    else
+    {
+        ESP_LOGW(TAG, "%s: series queue full, dropping block", channel->config->type);
+    }
+
+    series_block_reset(channel->series, channel->config->type);
+    series_block_append(channel->series, time, value);
+}
+
+esp_err_t channel_init(channel_t *channel, const channel_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+
+    channel->config = config;
+    channel->rejected = 0;
+    channel->has_published = false;
+    channel->last_published = 0.0f;
+    channel->last_publish_time = 0;
+    channel->suppressed = 0;
+    channel->total_suppressed = 0;
+    channel->total_empty = 0;
+    channel->series = NULL;
+    aggregator_reset(&channel->window);
+
+    if (config->raw_series)
+    {
+        channel->series = malloc(sizeof(series_block_t));
+        if (channel->series == NULL)
+        {
+            ESP_LOGE(TAG, "%s: cannot allocate series block", config->type);
+            return ESP_ERR_NO_MEM;
+        }
+        series_block_reset(channel->series, config->type);
+    }
+
+    if (channel_filters_outliers(channel))
+    {
+        ret = hampel_init(&channel->outlier_filter, config->outlier_window,
+                          config->outlier_threshold, config->outlier_min_deviation);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    if (channel_decimates(channel))
+    {
+        ret = decimator_init(&channel->decimator, config->decimation_order, config->decimation_ratio);
+    }
+
+    return ret;
+}
+
+esp_err_t channel_update(channel_t *channel, float value)
+{
+    uint32_t time = 0;
+    esp_err_t ret = get_current_time(&time);
+
+    esp_err_t err = channel_update_at(channel, value, time);
+    return (ret != ESP_OK) ? ret : err;
+}
+
+esp_err_t channel_update_at(channel_t *channel, float value, uint32_t time)
+{
+    if (channel_filters_outliers(channel) && !hampel_push(&channel->outlier_filter, value))
+    {
+        channel->rejected++;
+        ESP_LOGD(TAG, "%s: rejected outlier %f", channel->config->type, value);
+        return ESP_OK;
+    }
+
+    if (channel->series != NULL)
+    {
+        channel_record_sample(channel, time, value);
+    }
+
+    if (channel_decimates(channel) && !decimator_push(&channel->decimator, value, &value))
+    {
+        return ESP_OK;
+    }
+
+    aggregator_add(&channel->window, time, value);
+
+    return ESP_OK;
+}
+
+// folds the window into a summary, false if there is nothing to report
+static bool channel_summarize(channel_t *channel, uint32_t time, measurement_value_t *out)
+{
+    aggregator_t *window = &channel->window;
+
+    if (window->count == 0)
+    {
+        ESP_LOGW(TAG, "%s: no samples in window, skipping (%lu rejected)", channel->config->type, channel->rejected);
+        channel->total_empty++;
+        channel->rejected = 0;
+        return false;
+    }
+
+    if (!channel_should_report(channel, window->mean, time))
+    {
+        channel->suppressed++;
+        channel->total_suppressed++;
+        ESP_LOGD(TAG, "%s: %f within deadband, suppressed (%lu total)", channel->config->type, window->mean, channel->total_suppressed);
+        aggregator_reset(window);
+        channel->rejected = 0;
+        return false;
+    }
+
+    *out = (measurement_value_t){
+        .type = channel->config->type,
+        .value = window->mean,
+        .count = window->count,
+        .min = window->min,
+        .max = window->max,
+        .variance = aggregator_variance(window),
+        .first_timestamp = window->first_timestamp,
+        .last_timestamp = window->last_timestamp,
+        .rejected = channel->rejected,
+        .suppressed = channel->suppressed};
+
+    channel->has_published = true;
+    channel->last_published = window->mean;
+    channel->last_publish_time = time;
+    channel->suppressed = 0;
+
+    aggregator_reset(window);
+    channel->rejected = 0;
+
+    return true;
+}
+
+esp_err_t channel_publish(channel_t *channel)
+{
+    return channel_publish_group(&channel, 1);
+}
+
+esp_err_t channel_publish_group(channel_t *const channels[], size_t count)
+{
+    if (count == 0 || count > MEASUREMENT_MAX_VALUES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t time = 0;
+    get_current_time(&time);
+
+    measurement_t measurement = {
+        .timestamp = time,
+        .count = 0};
+
+    bool all_empty = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        all_empty &= (channels[i]->window.count == 0);
+        if (channel_summarize(channels[i], time, &measurement.values[measurement.count]))
+        {
+            measurement.count++;
+        }
+    }
+
+    if (measurement.count == 0)
+    {
+        return all_empty ? ESP_ERR_NOT_FOUND : ESP_OK;
+    }
+
+    // post window summaries
+    if (xQueueSend(xMeasurementQueue, &measurement, pdMS_TO_TICKS(500)) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Cannot insert message into queue");
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "decimator.h"
+
+static const char *TAG = "Decimator";
+
+// fixed point input is 32 bit, the remaining headroom bounds the bit growth
+#define DECIMATOR_HEADROOM_BITS 31
+
+// samples enter the integrators as fixed point with three decimals
+static int32_t toFixed(float val)
+{
+    return (int32_t)roundf(val * 1000.0f);
+}
+
+static float toFloat(int32_t val)
+{
+    return (float)val / 1000.0f;
+}
+
+esp_err_t decimator_init(decimator_t *dec, uint8_t order, uint16_t ratio)
+{
+    if (order == 0 || order > DECIMATOR_MAX_ORDER || ratio == 0)
+    {
+        ESP_LOGE(TAG, "Invalid configuration (order %u, ratio %u)", order, ratio);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // bit growth is order * log2(ratio)
+    uint8_t ratio_bits = 0;
+    while ((1UL << ratio_bits) < ratio)
+    {
+        ratio_bits++;
+    }
+    if (order * ratio_bits > DECIMATOR_HEADROOM_BITS)
+    {
+        ESP_LOGE(TAG, "Bit growth exceeds accumulator width (order %u, ratio %u)", order, ratio);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    dec->order = order;
+    dec->ratio = ratio;
+    dec->gain = 1;
+    for (uint8_t i = 0; i < order; i++)
+    {
+        dec->gain *= ratio;
+    }
+
+    decimator_reset(dec);
+    return ESP_OK;
+}
+
+void decimator_reset(decimator_t *dec)
+{
+    dec->phase = 0;
+    dec->warmup = dec->order;
+    memset(dec->integrators, 0, sizeof(dec->integrators));
+    memset(dec->combs, 0, sizeof(dec->combs));
+}
+
+bool decimator_push(decimator_t *dec, float sample, float *out)
+{
+    // integrator section at the input rate
+    uint64_t acc = (uint64_t)(int64_t)toFixed(sample);
+    for (uint8_t i = 0; i < dec->order; i++)
+    {
+        dec->integrators[i] += acc;
+        acc = dec->integrators[i];
+    }
+
+    if (++dec->phase < dec->ratio)
+    {
+        return false;
+    }
+    dec->phase = 0;
+
+    // comb section at the output rate
+    for (uint8_t i = 0; i < dec->order; i++)
+    {
+        uint64_t delayed = dec->combs[i];
+        dec->combs[i] = acc;
+        acc -= delayed;
+    }
+
+    // the first outputs still contain the zero initial state
+    if (dec->warmup > 0)
+    {
+        dec->warmup--;
+        return false;
+    }
+
+    *out = toFloat((int32_t)((int64_t)acc / dec->gain));
+    return true;
+}
@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "image_stats.h"
+
+static const char *TAG = "Image Stats";
+
+#define RGB565_MAX_R 31
+#define RGB565_MAX_G 63
+#define RGB565_MAX_B 31
+
+esp_err_t image_stats_rgb565(const uint8_t *pixels, uint16_t width, uint16_t height,
+                             const image_roi_t *roi, image_stats_t *stats)
+{
+    if (roi->width == 0 || roi->height == 0 ||
+        (uint32_t)roi->x + roi->width > width || (uint32_t)roi->y + roi->height > height)
+    {
+        ESP_LOGE(TAG, "ROI %ux%u+%u+%u outside of %ux%u image",
+                 roi->width, roi->height, roi->x, roi->y, width, height);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(stats, 0, sizeof(image_stats_t));
+
+    // a 1600x1200 frame sums to at most 2^27, no overflow in 32 bit
+    uint32_t sum_r = 0;
+    uint32_t sum_g = 0;
+    uint32_t sum_b = 0;
+
+    for (uint16_t row = 0; row < roi->height; row++)
+    {
+        const uint8_t *p = pixels + ((size_t)(roi->y + row) * width + roi->x) * 2;
+
+        // branch free, one load of two bytes per pixel
+        for (uint16_t col = 0; col < roi->width; col++)
+        {
+            uint16_t rgb = ((uint16_t)p[0] << 8) | p[1];
+            p += 2;
+
+            uint8_t r = rgb >> 11;
+            uint8_t g = (rgb >> 5) & 0x3f;
+            uint8_t b = rgb & 0x1f;
+
+            sum_r += r;
+            sum_g += g;
+            sum_b += b;
+
+            stats->histogram_r[r >> 1]++;
+            stats->histogram_g[g >> 2]++;
+            stats->histogram_b[b >> 1]++;
+        }
+    }
+
+    stats->pixels = (uint32_t)roi->width * roi->height;
+    stats->mean_r = (float)sum_r / (float)(stats->pixels * RGB565_MAX_R);
+    stats->mean_g = (float)sum_g / (float)(stats->pixels * RGB565_MAX_G);
+    stats->mean_b = (float)sum_b / (float)(stats->pixels * RGB565_MAX_B);
+
+    // a black roi has no color, report neutral values instead of dividing by zero
+    float total = stats->mean_r + stats->mean_g + stats->mean_b;
+    stats->green_red_ratio = (stats->mean_r > 0.0f) ? stats->mean_g / stats->mean_r : 0.0f;
+    stats->biomass_index = (total > 0.0f) ? (2.0f * stats->mean_g - stats->mean_r - stats->mean_b) / total : 0.0f;
+
+    return ESP_OK;
+}
+
+#define DHASH_COLUMNS 9
+#define DHASH_ROWS 8
+
+uint64_t image_dhash_rgb565(const uint8_t *pixels, uint16_t width, uint16_t height)
+{
+    uint32_t blocks[DHASH_ROWS][DHASH_COLUMNS] = {0};
+    uint32_t block_widths[DHASH_COLUMNS] = {0};
+
+    for (uint16_t col = 0; col < width; col++)
+    {
+        block_widths[(uint32_t)col * DHASH_COLUMNS / width]++;
+    }
+
+    for (uint16_t row = 0; row < height; row++)
+    {
+        const uint8_t *p = pixels + (size_t)row * width * 2;
+        uint32_t *block_row = blocks[(uint32_t)row * DHASH_ROWS / height];
+
+        for (uint16_t col = 0; col < width; col++)
+        {
+            uint16_t rgb = ((uint16_t)p[0] << 8) | p[1];
+            p += 2;
+
+            // bt.601 weights on the 5 and 6 bit channels scaled to 8 bit
+            uint32_t luma = 77 * ((rgb >> 11) << 3) + 150 * (((rgb >> 5) & 0x3f) << 2) + 29 * ((rgb & 0x1f) << 3);
+            block_row[(uint32_t)col * DHASH_COLUMNS / width] += luma;
+        }
+    }
+
+    // neighbours share their height but not always their width, the means are compared cross multiplied
+    uint64_t hash = 0;
+    for (uint8_t row = 0; row < DHASH_ROWS; row++)
+    {
+        for (uint8_t col = 0; col < DHASH_COLUMNS - 1; col++)
+        {
+            uint64_t left = (uint64_t)blocks[row][col] * block_widths[col + 1];
+            uint64_t right = (uint64_t)blocks[row][col + 1] * block_widths[col];
+            hash = (hash << 1) | (left < right);
+        }
+    }
+
+    return hash;
+}
@@ -0,0 +1,97 @@
+#include <math.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "lockin.h"
+
+static const char *TAG = "Lock-In";
+
+#define LOCKIN_Q15 32767
+
+static int16_t lockin_round(float value)
+{
+    // symmetric rounding keeps the second half of the table the exact negative of the first
+    return (int16_t)((value < 0.0f) ? -floorf(-value + 0.5f) : floorf(value + 0.5f));
+}
+
+esp_err_t lockin_init(lockin_t *lockin, uint16_t period)
+{
+    if (period < 2 || period > LOCKIN_MAX_PERIOD || (period & 1))
+    {
+        ESP_LOGE(TAG, "Invalid period %u", period);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    lockin->period = period;
+    for (uint16_t i = 0; i < period / 2; i++)
+    {
+        float angle = 2.0f * (float)M_PI * (float)i / (float)period;
+        lockin->sin_table[i] = lockin_round(sinf(angle) * LOCKIN_Q15);
+        lockin->cos_table[i] = lockin_round(cosf(angle) * LOCKIN_Q15);
+        lockin->sin_table[i + period / 2] = -lockin->sin_table[i];
+        lockin->cos_table[i + period / 2] = -lockin->cos_table[i];
+    }
+
+    lockin_reset(lockin);
+    return ESP_OK;
+}
+
+void lockin_reset(lockin_t *lockin)
+{
+    lockin->phase = 0;
+    lockin->i_sum = 0;
+    lockin->q_sum = 0;
+    lockin->dc_sum = 0;
+    lockin->count = 0;
+}
+
+void lockin_push(lockin_t *lockin, const int16_t *samples, size_t count)
+{
+    // 32 bit products, accumulated in 64 bit for arbitrarily long windows
+    int64_t i_sum = lockin->i_sum;
+    int64_t q_sum = lockin->q_sum;
+    int64_t dc_sum = lockin->dc_sum;
+    uint16_t phase = lockin->phase;
+    const uint16_t period = lockin->period;
+
+    for (size_t n = 0; n < count; n++)
+    {
+        int32_t sample = samples[n];
+        i_sum += sample * (int32_t)lockin->sin_table[phase];
+        q_sum += sample * (int32_t)lockin->cos_table[phase];
+        dc_sum += sample;
+
+        if (++phase == period)
+        {
+            phase = 0;
+        }
+    }
+
+    lockin->i_sum = i_sum;
+    lockin->q_sum = q_sum;
+    lockin->dc_sum = dc_sum;
+    lockin->phase = phase;
+    lockin->count += count;
+}
+
+bool lockin_result(const lockin_t *lockin, lockin_result_t *result)
+{
+    uint32_t periods = lockin->count / lockin->period;
+    if (periods == 0 || lockin->phase != 0)
+    {
+        return false;
+    }
+
+    // a sine of amplitude a correlates to a * n / 2 against the reference
+    float scale = 2.0f / ((float)lockin->count * LOCKIN_Q15);
+    float i = (float)lockin->i_sum * scale;
+    float q = (float)lockin->q_sum * scale;
+
+    result->amplitude = sqrtf(i * i + q * q);
+    result->phase = atan2f(q, i);
+    result->dc = (float)lockin->dc_sum / (float)lockin->count;
+    result->periods = periods;
+    return true;
+}
@@ -37,6 +37,9 @@ static const char *TAG = "MAIN";
 /* NVS fetch and store time period: hours * minutes * seconds * milliseconds * microseconds */
 #define NVS_TIME_PERIOD_US (6ULL * 60ULL * 60ULL * 1000ULL * 1000ULL)
 
+/* open drain INT output of the IO expander */
+#define CAT_PIN_INT 13
+
 cat_state_t cat_device;
 
 void app_main(void)
@@ -73,9 +76,11 @@ void app_main(void)
     ESP_ERROR_CHECK(i2c_init());
 
     // FIXME
-    initlizeCat(&cat_device, 0b0100111, I2C_USER_PORT);
+    initlizeCat(&cat_device, 0b0100111);
+    catEnableInterrupt(&cat_device, CAT_PIN_INT);
 
     xTaskCreate(&send_measurement_task, "Measurement", 4096, (void*)NULL, configMAX_PRIORITIES - 4, NULL);
+    xTaskCreate(&send_series_task, "Series", 4096, (void*)NULL, configMAX_PRIORITIES - 7, NULL);
 
     xTaskCreate(&task, task_manager_interface.name, 4096, (void*)&task_manager_interface, configMAX_PRIORITIES - 3, NULL);
     xTaskCreate(&task, camera_task_interface.name, 8192, (void*)&camera_task_interface, configMAX_PRIORITIES - 5, NULL);
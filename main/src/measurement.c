@@ -8,14 +8,18 @@
 #include "client.h"
 #include "endpoints.h"
 #include "measurement.h"
+#include "metrics.h"
+#include "series.h"
 
 static const char *TAG = "Measure";
 
 #define QUEUE_SIZE 10
+#define SERIES_QUEUE_SIZE 4
 #define TMP_BUFFER_LENGTH 128
 QueueHandle_t xMeasurementQueue;
+QueueHandle_t xSeriesQueue;
 
-cJSON *serialize_measurement(measurement_t *measurement)
+static cJSON *serialize_value(const measurement_value_t *value)
 {
     cJSON *json = cJSON_CreateObject();
     if (json == NULL)
@@ -23,19 +27,50 @@ cJSON *serialize_measurement(measurement_t *measurement)
         return NULL;
     }
 
-    cJSON *measurement_type = cJSON_CreateString(measurement->type);
-    cJSON *value = cJSON_CreateNumber(measurement->value);
-    cJSON *timestamp = cJSON_CreateNumber(measurement->timestamp);
+    if (cJSON_AddStringToObject(json, "measurement_type", value->type) == NULL ||
+        cJSON_AddNumberToObject(json, "value", value->value) == NULL ||
+        // window summary
+        cJSON_AddNumberToObject(json, "count", value->count) == NULL ||
+        cJSON_AddNumberToObject(json, "min", value->min) == NULL ||
+        cJSON_AddNumberToObject(json, "max", value->max) == NULL ||
+        cJSON_AddNumberToObject(json, "variance", value->variance) == NULL ||
+        cJSON_AddNumberToObject(json, "first_timestamp", value->first_timestamp) == NULL ||
+        cJSON_AddNumberToObject(json, "last_timestamp", value->last_timestamp) == NULL ||
+        cJSON_AddNumberToObject(json, "rejected", value->rejected) == NULL ||
+        cJSON_AddNumberToObject(json, "suppressed", value->suppressed) == NULL)
+    {
+        cJSON_Delete(json);
+        return NULL;
+    }
 
-    if (measurement_type == NULL || value == NULL || timestamp == NULL)
+    return json;
+}
+
+cJSON *serialize_measurement(measurement_t *measurement)
+{
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL)
+    {
+        return NULL;
+    }
+
+    cJSON *values = cJSON_AddArrayToObject(json, "values");
+    if (cJSON_AddNumberToObject(json, "timestamp", measurement->timestamp) == NULL || values == NULL)
     {
         cJSON_Delete(json);
         return NULL;
     }
 
-    cJSON_AddItemToObject(json, "measurement_type", measurement_type);
-    cJSON_AddItemToObject(json, "value", value);
-    cJSON_AddItemToObject(json, "timestamp", timestamp);
+    for (uint8_t i = 0; i < measurement->count; i++)
+    {
+        cJSON *value = serialize_value(&measurement->values[i]);
+        if (value == NULL)
+        {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        cJSON_AddItemToArray(values, value);
+    }
 
     return json;
 }
@@ -103,10 +138,53 @@ end:
     return ret;
 }
 
+esp_err_t post_series(series_block_t *block)
+{
+    esp_err_t ret = ESP_FAIL;
+    char tmp_buf[TMP_BUFFER_LENGTH];
+    size_t length = series_block_size(block);
+
+    // get config (blocking)
+    esp_http_client_config_t* config = get_config();
+    config->url = API_V1_POST_SERIES;
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+
+    // assemble request headers
+    sprintf(tmp_buf, "%d", 1); // FIXME
+    esp_http_client_set_header(client, "Device-Id", tmp_buf);
+    sprintf(tmp_buf, "%lu", block->first_timestamp);
+    esp_http_client_set_header(client, "Timestamp", tmp_buf);
+    esp_http_client_set_header(client, "Measurement-Type", block->type);
+    sprintf(tmp_buf, "%u", block->count);
+    esp_http_client_set_header(client, "Sample-Count", tmp_buf);
+    esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+    esp_http_client_set_post_field(client, (const char *)block->data, length);
+
+    // excecute request and wait for response
+    ret = esp_http_client_perform(client);
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "HTTP POST Status = %d, %u samples in %zu bytes",
+                esp_http_client_get_status_code(client), block->count, length);
+    } else {
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(ret));
+    }
+
+    // finalize
+    esp_http_client_cleanup(client);
+    release_config();
+
+    return ret;
+}
+
 void send_measurement_task(void *pvparameters)
 {
     ESP_LOGI(TAG, "Starting measurement task");
 
+    metric_t *posted = metrics_counter("measurement_posts");
+    metric_t *failed = metrics_counter("measurement_failures");
+
     xMeasurementQueue = xQueueCreate(QUEUE_SIZE, sizeof(measurement_t));
     if (xMeasurementQueue == NULL)
     {
@@ -122,8 +200,39 @@ void send_measurement_task(void *pvparameters)
         }
         else
         {
-            ESP_LOGI(TAG, "[%lu] %s: %f", measurement.timestamp, measurement.type, measurement.value);
-            post_measurement(&measurement);
+            for (uint8_t i = 0; i < measurement.count; i++)
+            {
+                measurement_value_t *value = &measurement.values[i];
+                ESP_LOGI(TAG, "[%lu] %s: %f (n=%lu, min=%f, max=%f, var=%f, rejected=%lu, suppressed=%lu)", measurement.timestamp,
+                         value->type, value->value, value->count, value->min, value->max,
+                         value->variance, value->rejected, value->suppressed);
+            }
+            metrics_add(post_measurement(&measurement) == ESP_OK ? posted : failed, 1);
+        }
+    }
+}
+
+void send_series_task(void *pvparameters)
+{
+    ESP_LOGI(TAG, "Starting series task");
+
+    xSeriesQueue = xQueueCreate(SERIES_QUEUE_SIZE, sizeof(series_block_t *));
+    if (xSeriesQueue == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot create Queue");
+    }
+
+    while (1)
+    {
+        series_block_t *block;
+        if (xQueueReceive(xSeriesQueue, &block, portMAX_DELAY) != pdPASS)
+        {
+            ESP_LOGE(TAG, "Failed to get series block from Queue");
+        }
+        else
+        {
+            post_series(block);
+            free(block);
         }
     }
 }
@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "median_filter.h"
+
+static const char *TAG = "Median";
+
+// consistency constant relating the MAD to the standard deviation of a normal distribution
+#define MAD_SCALE 1.4826f
+
+/* heap helpers, lower is a max heap and upper a min heap of slot indices */
+
+static inline bool heap_before(const rolling_median_t *rm, bool is_lower, uint16_t a, uint16_t b)
+{
+    return is_lower ? (rm->values[a] > rm->values[b]) : (rm->values[a] < rm->values[b]);
+}
+
+static inline void heap_place(rolling_median_t *rm, bool is_lower, uint16_t index, uint16_t slot)
+{
+    if (is_lower)
+    {
+        rm->lower[index] = slot;
+        rm->position[slot] = (int16_t)index;
+    }
+    else
+    {
+        rm->upper[index] = slot;
+        rm->position[slot] = (int16_t)~index;
+    }
+}
+
+static void heap_sift_up(rolling_median_t *rm, bool is_lower, uint16_t index)
+{
+    uint16_t *heap = is_lower ? rm->lower : rm->upper;
+    uint16_t slot = heap[index];
+
+    while (index > 0)
+    {
+        uint16_t parent = (index - 1) / 2;
+        if (!heap_before(rm, is_lower, slot, heap[parent]))
+        {
+            break;
+        }
+        heap_place(rm, is_lower, index, heap[parent]);
+        index = parent;
+    }
+    heap_place(rm, is_lower, index, slot);
+}
+
+static void heap_sift_down(rolling_median_t *rm, bool is_lower, uint16_t index)
+{
+    uint16_t *heap = is_lower ? rm->lower : rm->upper;
+    uint16_t count = is_lower ? rm->lower_count : rm->upper_count;
+    uint16_t slot = heap[index];
+
+    while (1)
+    {
+        uint16_t child = 2 * index + 1;
+        if (child >= count)
+        {
+            break;
+        }
+        if (child + 1 < count && heap_before(rm, is_lower, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        if (!heap_before(rm, is_lower, heap[child], slot))
+        {
+            break;
+        }
+        heap_place(rm, is_lower, index, heap[child]);
+        index = child;
+    }
+    heap_place(rm, is_lower, index, slot);
+}
+
+static void heap_insert(rolling_median_t *rm, bool is_lower, uint16_t slot)
+{
+    uint16_t index = is_lower ? rm->lower_count++ : rm->upper_count++;
+    heap_place(rm, is_lower, index, slot);
+    heap_sift_up(rm, is_lower, index);
+}
+
+static uint16_t heap_pop(rolling_median_t *rm, bool is_lower)
+{
+    uint16_t *heap = is_lower ? rm->lower : rm->upper;
+    uint16_t *count = is_lower ? &rm->lower_count : &rm->upper_count;
+    uint16_t top = heap[0];
+
+    (*count)--;
+    if (*count > 0)
+    {
+        heap_place(rm, is_lower, 0, heap[*count]);
+        heap_sift_down(rm, is_lower, 0);
+    }
+    return top;
+}
+
+static void heap_remove(rolling_median_t *rm, uint16_t slot)
+{
+    bool is_lower = rm->position[slot] >= 0;
+    uint16_t index = is_lower ? (uint16_t)rm->position[slot] : (uint16_t)~rm->position[slot];
+    uint16_t *heap = is_lower ? rm->lower : rm->upper;
+    uint16_t *count = is_lower ? &rm->lower_count : &rm->upper_count;
+
+    (*count)--;
+    if (index == *count)
+    {
+        return;
+    }
+
+    // move the last element into the hole and restore the heap property in either direction
+    uint16_t moved = heap[*count];
+    heap_place(rm, is_lower, index, moved);
+    heap_sift_up(rm, is_lower, index);
+
+    int16_t position = rm->position[moved];
+    heap_sift_down(rm, is_lower, is_lower ? (uint16_t)position : (uint16_t)~position);
+}
+
+static void rebalance(rolling_median_t *rm)
+{
+    // keep lower_count == upper_count or lower_count == upper_count + 1
+    while (rm->lower_count > rm->upper_count + 1)
+    {
+        heap_insert(rm, false, heap_pop(rm, true));
+    }
+    while (rm->upper_count > rm->lower_count)
+    {
+        heap_insert(rm, true, heap_pop(rm, false));
+    }
+}
+
+esp_err_t rolling_median_init(rolling_median_t *rm, uint16_t size)
+{
+    if (size == 0 || size > MEDIAN_FILTER_MAX_WINDOW)
+    {
+        ESP_LOGE(TAG, "Invalid window size %u", size);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rm->size = size;
+    rm->count = 0;
+    rm->head = 0;
+    rm->lower_count = 0;
+    rm->upper_count = 0;
+
+    rm->values = calloc(size, sizeof(float));
+    rm->position = calloc(size, sizeof(int16_t));
+    // lower holds up to (size + 1) / 2 samples and briefly one more between insert and rebalance
+    rm->lower = calloc((size + 1) / 2 + 1, sizeof(uint16_t));
+    rm->upper = calloc((size + 1) / 2 + 1, sizeof(uint16_t));
+
+    if (rm->values == NULL || rm->position == NULL || rm->lower == NULL || rm->upper == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot allocate window of %u", size);
+        rolling_median_free(rm);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void rolling_median_free(rolling_median_t *rm)
+{
+    free(rm->values);
+    free(rm->position);
+    free(rm->lower);
+    free(rm->upper);
+    rm->values = NULL;
+    rm->position = NULL;
+    rm->lower = NULL;
+    rm->upper = NULL;
+}
+
+void rolling_median_push(rolling_median_t *rm, float value)
+{
+    uint16_t slot = rm->head;
+    rm->head = (rm->head + 1) % rm->size;
+
+    // evict the oldest sample once the window is full
+    if (rm->count == rm->size)
+    {
+        heap_remove(rm, slot);
+    }
+    else
+    {
+        rm->count++;
+    }
+
+    rm->values[slot] = value;
+    if (rm->lower_count == 0 || value <= rm->values[rm->lower[0]])
+    {
+        heap_insert(rm, true, slot);
+    }
+    else
+    {
+        heap_insert(rm, false, slot);
+    }
+
+    rebalance(rm);
+}
+
+float rolling_median_get(const rolling_median_t *rm)
+{
+    if (rm->count == 0)
+    {
+        return NAN;
+    }
+
+    if (rm->lower_count > rm->upper_count)
+    {
+        return rm->values[rm->lower[0]];
+    }
+    return (rm->values[rm->lower[0]] + rm->values[rm->upper[0]]) / 2.0f;
+}
+
+esp_err_t hampel_init(hampel_filter_t *filter, uint16_t window, float threshold, float min_deviation)
+{
+    filter->threshold = threshold;
+    filter->min_deviation = min_deviation;
+    filter->accepted = 0;
+    filter->rejected = 0;
+
+    esp_err_t ret = rolling_median_init(&filter->values, window);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = rolling_median_init(&filter->deviations, window);
+    if (ret != ESP_OK)
+    {
+        rolling_median_free(&filter->values);
+    }
+
+    return ret;
+}
+
+void hampel_free(hampel_filter_t *filter)
+{
+    rolling_median_free(&filter->values);
+    rolling_median_free(&filter->deviations);
+}
+
+bool hampel_push(hampel_filter_t *filter, float value)
+{
+    if (!isfinite(value))
+    {
+        filter->rejected++;
+        return false;
+    }
+
+    // fill the window before judging anything
+    if (filter->values.count < filter->values.size / 2 + 1)
+    {
+        rolling_median_push(&filter->values, value);
+        filter->accepted++;
+        return true;
+    }
+
+    float median = rolling_median_get(&filter->values);
+    float deviation = fabsf(value - median);
+
+    float limit = filter->threshold * MAD_SCALE * rolling_median_get(&filter->deviations);
+    if (isnan(limit) || limit < filter->min_deviation)
+    {
+        limit = filter->min_deviation;
+    }
+
+    // every sample enters the window so that genuine steps are followed after half a window
+    rolling_median_push(&filter->values, value);
+    rolling_median_push(&filter->deviations, deviation);
+
+    if (deviation > limit)
+    {
+        filter->rejected++;
+        return false;
+    }
+
+    filter->accepted++;
+    return true;
+}
@@ -0,0 +1,205 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "metrics.h"
+
+static const char *TAG = "Metrics";
+
+static metric_t registry[METRICS_MAX];
+// entries below the count are complete, readers never take the lock
+static atomic_size_t registry_count = 0;
+static portMUX_TYPE registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+metric_t *metrics_find(const char *name)
+{
+    size_t count = atomic_load_explicit(&registry_count, memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(registry[i].name, name) == 0)
+        {
+            return &registry[i];
+        }
+    }
+    return NULL;
+}
+
+static metric_t *metrics_register(const char *name, metric_kind_t kind, const uint32_t *bounds, uint8_t bound_count)
+{
+    metric_t *metric = NULL;
+
+    taskENTER_CRITICAL(&registry_lock);
+    size_t count = atomic_load_explicit(&registry_count, memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(registry[i].name, name) == 0)
+        {
+            metric = &registry[i];
+            break;
+        }
+    }
+
+    if (metric == NULL && count < METRICS_MAX)
+    {
+        metric = &registry[count];
+        memset(metric, 0, sizeof(metric_t));
+        metric->name = name;
+        metric->kind = kind;
+        metric->bound_count = bound_count;
+        if (bound_count > 0)
+        {
+            memcpy(metric->bounds, bounds, bound_count * sizeof(uint32_t));
+        }
+        atomic_store_explicit(&registry_count, count + 1, memory_order_release);
+    }
+    taskEXIT_CRITICAL(&registry_lock);
+
+    if (metric == NULL)
+    {
+        ESP_LOGE(TAG, "Registry full, %s not registered", name);
+    }
+    else if (metric->kind != kind)
+    {
+        ESP_LOGE(TAG, "%s already registered as another kind", name);
+        return NULL;
+    }
+    return metric;
+}
+
+metric_t *metrics_counter(const char *name)
+{
+    return metrics_register(name, METRIC_COUNTER, NULL, 0);
+}
+
+metric_t *metrics_gauge(const char *name)
+{
+    return metrics_register(name, METRIC_GAUGE, NULL, 0);
+}
+
+metric_t *metrics_histogram(const char *name, const uint32_t *bounds, uint8_t count)
+{
+    if (count == 0 || count > METRICS_HISTOGRAM_BUCKETS)
+    {
+        ESP_LOGE(TAG, "%s: %u buckets, at most %d", name, count, METRICS_HISTOGRAM_BUCKETS);
+        return NULL;
+    }
+    return metrics_register(name, METRIC_HISTOGRAM, bounds, count);
+}
+
+size_t metrics_count()
+{
+    return atomic_load_explicit(&registry_count, memory_order_acquire);
+}
+
+metric_t *metrics_get(size_t id)
+{
+    return (id < metrics_count()) ? &registry[id] : NULL;
+}
+
+void metrics_add(metric_t *metric, uint32_t count)
+{
+    if (metric)
+    {
+        atomic_fetch_add_explicit(&metric->value, count, memory_order_relaxed);
+    }
+}
+
+void metrics_set(metric_t *metric, float value)
+{
+    if (metric)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        atomic_store_explicit(&metric->value, bits, memory_order_relaxed);
+    }
+}
+
+void metrics_observe(metric_t *metric, uint32_t value)
+{
+    if (!metric)
+    {
+        return;
+    }
+
+    uint8_t bucket = 0;
+    while (bucket < metric->bound_count && value > metric->bounds[bucket])
+    {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&metric->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metric->sum, value, memory_order_relaxed);
+}
+
+uint32_t metrics_counter_value(const metric_t *metric)
+{
+    return atomic_load_explicit(&metric->value, memory_order_relaxed);
+}
+
+uint64_t metrics_histogram_sum(const metric_t *metric)
+{
+    return atomic_load_explicit(&metric->sum, memory_order_relaxed);
+}
+
+float metrics_gauge_value(const metric_t *metric)
+{
+    uint32_t bits = atomic_load_explicit(&metric->value, memory_order_relaxed);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static cJSON *metrics_serialize(const metric_t *metric)
+{
+    if (metric->kind == METRIC_COUNTER)
+    {
+        return cJSON_CreateNumber(metrics_counter_value(metric));
+    }
+    if (metric->kind == METRIC_GAUGE)
+    {
+        return cJSON_CreateNumber(metrics_gauge_value(metric));
+    }
+
+    // a double holds the sum exactly up to 2^53
+    cJSON *json = cJSON_CreateObject();
+    cJSON *bounds = cJSON_AddArrayToObject(json, "bounds");
+    cJSON *buckets = cJSON_AddArrayToObject(json, "buckets");
+    if (json == NULL || bounds == NULL || buckets == NULL ||
+        cJSON_AddNumberToObject(json, "sum", (double)metrics_histogram_sum(metric)) == NULL)
+    {
+        cJSON_Delete(json);
+        return NULL;
+    }
+    for (uint8_t i = 0; i <= metric->bound_count; i++)
+    {
+        if (i < metric->bound_count)
+        {
+            cJSON_AddItemToArray(bounds, cJSON_CreateNumber(metric->bounds[i]));
+        }
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(atomic_load_explicit(&metric->buckets[i], memory_order_relaxed)));
+    }
+    return json;
+}
+
+cJSON *metrics_to_json()
+{
+    cJSON *json = cJSON_CreateObject();
+    if (json == NULL)
+    {
+        return NULL;
+    }
+
+    for (size_t id = 0; id < metrics_count(); id++)
+    {
+        const metric_t *metric = metrics_get(id);
+        cJSON *value = metrics_serialize(metric);
+        if (value == NULL)
+        {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        cJSON_AddItemToObject(json, metric->name, value);
+    }
+    return json;
+}
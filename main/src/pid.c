@@ -0,0 +1,71 @@
+#include "pid.h"
+
+static float pid_clamp(float value, float min, float max)
+{
+    if (value < min)
+    {
+        return min;
+    }
+    if (value > max)
+    {
+        return max;
+    }
+    return value;
+}
+
+void pid_init(pid_controller_t *pid, const pid_config_t *config)
+{
+    pid->config = *config;
+    pid_reset(pid);
+}
+
+void pid_reset(pid_controller_t *pid)
+{
+    pid->integral = 0.0f;
+    pid->previous_measurement = 0.0f;
+    pid->output = 0.0f;
+    pid->primed = false;
+}
+
+float pid_update(pid_controller_t *pid, float setpoint, float measurement, float dt)
+{
+    const pid_config_t *config = &pid->config;
+
+    if (dt <= 0.0f)
+    {
+        return pid->output;
+    }
+
+    float error = setpoint - measurement;
+
+    // derivative on the measurement, setpoint steps do not kick the output
+    float derivative = 0.0f;
+    if (pid->primed)
+    {
+        derivative = -(measurement - pid->previous_measurement) / dt;
+    }
+    pid->previous_measurement = measurement;
+    pid->primed = true;
+
+    float integral = pid->integral + config->ki * error * dt;
+    float unlimited = config->kp * error + integral + config->kd * derivative;
+
+    float output = pid_clamp(unlimited, config->output_min, config->output_max);
+    if (config->slew_rate > 0.0f)
+    {
+        float step = config->slew_rate * dt;
+        output = pid_clamp(output, pid->output - step, pid->output + step);
+    }
+
+    // anti-windup: only integrate while the output is free to follow,
+    // or when the error pulls it back out of the limit
+    bool limited_high = output < unlimited;
+    bool limited_low = output > unlimited;
+    if ((!limited_high && !limited_low) || (limited_high && error < 0.0f) || (limited_low && error > 0.0f))
+    {
+        pid->integral = pid_clamp(integral, config->output_min, config->output_max);
+    }
+
+    pid->output = output;
+    return output;
+}
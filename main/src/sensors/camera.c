@@ -1,29 +1,234 @@
+#include <math.h>
+#include <string.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_tls.h"
 #include "esp_http_client.h"
 #include "esp_pm.h"
 #include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "img_converters.h"
+#include "sdkconfig.h"
+#include <cJSON.h>
 
 #include "timer.h"
+#include "channel.h"
+#include "image_stats.h"
+#include "metrics.h"
 #include "client.h"
 #include "sensors/camera.h"
+#include "tasks/mixing.h"
 #include "interval_task.h"
 #include "http_status_codes.h"
 #include "endpoints.h"
 
 static const char *TAG = "CAM";
 
-/* HTTP multipart form bounadry, refer https://www.ietf.org/rfc/rfc2046.txt */
-#define FILE_BOUNDARY "WarrSpacelabsDataBoundary"
+/* images go out as identified chunks, the server acknowledges the contiguous bytes it stored
+ * a failed chunk is resumed from the acknowledged offset instead of restarting the image */
+#define RESUMABLE_CHUNK_SIZE (32 * 1024)
+/* attempts after a failed chunk, each starts with asking the server for its offset */
+#define UPLOAD_MAX_RETRIES 5
+#define UPLOAD_RETRY_DELAY_MS 2000
+
+/* the chunk is written in place, one piece per tls record */
+#define UPLOAD_CHUNK_SIZE (8 * 1024)
+/* consecutive writes that made no progress before giving up */
+#define UPLOAD_MAX_STALLS 3
+/* wait before repeating a write that made no progress, doubled on every further stall */
+#define UPLOAD_STALL_BACKOFF_MS 50
+
+/* temporary header and response buffer */
+#define TMP_BUFFER_LENGTH (128)
+#define UPLOAD_ID_LENGTH (32)
+#define UPLOAD_URL_LENGTH (sizeof(API_V1_IMAGE_CHUNK) + UPLOAD_ID_LENGTH + 1)
+
+/* a single frame waits for the upload, with CAMERA_DROP_OLDEST a new capture replaces it
+ * deeper queues cost a uxga frame buffer in psram per entry and only delay fresher images */
+#define CAMERA_UPLOAD_QUEUE_LENGTH 1
+/* frames in psram: the queued ones, the one being uploaded and one left for the next capture
+ * every capture path (take_image, take_burst) holds at most one buffer at a time */
+#define CAMERA_FB_COUNT (CAMERA_UPLOAD_QUEUE_LENGTH + 2)
+
+typedef enum
+{
+    CAMERA_DROP_OLDEST, // keep the freshest image when uploads fall behind
+    CAMERA_DROP_NEWEST  // keep a gapless history until the queue drains
+} camera_drop_policy_t;
+#define CAMERA_DROP_POLICY CAMERA_DROP_OLDEST
+
+/* every frame is decoded at 1/8 scale for analysis and change detection, 200x150 rgb565 at UXGA */
+#define PREVIEW_SCALE JPG_SCALE_8X
+#define PREVIEW_SCALE_DIVIDER 8
+
+static uint8_t *preview_buffer = NULL;
+static size_t preview_buffer_size = 0;
+// the frame currently decoded in the preview buffer
+static const camera_fb_t *preview_fb = NULL;
 
-/* temporary assembly and response buffer */
-#define TMP_BUFFER_LENGTH (1024)
-#define TMP_HEAD_LENGTH (512)
-#define TMP_END_LENGTH (128)
+/* frames are taken once the exposure control settled under the flash
+ * settled means the mean luma moved by no more than the tolerance over consecutive frames */
+#define EXPOSURE_TOLERANCE 0.01f
+#define EXPOSURE_STABLE_FRAMES 2
+#define EXPOSURE_TIMEOUT_US (1500LL * 1000LL)
+
+static struct
+{
+    uint32_t converged;
+    uint32_t timeouts;
+    int64_t flash_on_us;
+    int64_t lock_held_us;
+} exposure_stats;
+
+/* routine uploads are skipped while the scene stays the same */
+#define CHANGE_THRESHOLD CONFIG_CAMERA_CHANGE_THRESHOLD
+#define KEYFRAME_INTERVAL_US (CONFIG_CAMERA_KEYFRAME_INTERVAL_S * 1000000LL)
+
+static uint64_t reference_hash = 0;
+static bool has_reference = false;
+static int64_t last_keyframe_time = 0;
+
+#ifdef CONFIG_CAMERA_ANALYSIS
+
+static const channel_config_t green_red_config = {
+    .type = "Green Red Ratio",
+    .deadband_absolute = 0.01f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static const channel_config_t biomass_config = {
+    .type = "Biomass Index",
+    .deadband_absolute = 0.005f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static channel_t channels[2];
+
+#endif
+
+/* routine uploads are cropped or downscaled, full frames only go out now and then */
+typedef enum
+{
+    CAMERA_UPLOAD_NONE,
+    CAMERA_UPLOAD_ROI,
+    CAMERA_UPLOAD_THUMBNAIL,
+    CAMERA_UPLOAD_FULL,
+    CAMERA_UPLOAD_BURST
+} camera_upload_kind_t;
+
+#if defined(CONFIG_CAMERA_ROUTINE_UPLOAD_ROI)
+#define CAMERA_ROUTINE_UPLOAD CAMERA_UPLOAD_ROI
+#elif defined(CONFIG_CAMERA_ROUTINE_UPLOAD_THUMBNAIL)
+#define CAMERA_ROUTINE_UPLOAD CAMERA_UPLOAD_THUMBNAIL
+#elif defined(CONFIG_CAMERA_ROUTINE_UPLOAD_FULL)
+#define CAMERA_ROUTINE_UPLOAD CAMERA_UPLOAD_FULL
+#else
+#define CAMERA_ROUTINE_UPLOAD CAMERA_UPLOAD_NONE
+#define CONFIG_CAMERA_ROUTINE_INTERVAL_S 0
+#endif
+#define ROUTINE_INTERVAL_US (CONFIG_CAMERA_ROUTINE_INTERVAL_S * 1000000LL)
+#define FULL_FRAME_INTERVAL_US (CONFIG_CAMERA_FULL_FRAME_INTERVAL_S * 1000000LL)
+
+static const char *const upload_kind_names[] = {"none", "roi", "thumbnail", "full", "burst"};
+
+/* the roi keeps half of the sensor resolution, 800x600 rgb565 at UXGA before cropping */
+#define ROI_SCALE JPG_SCALE_2X
+#define ROI_SCALE_DIVIDER 2
+#define THUMBNAIL_SCALE JPG_SCALE_8X
+#define THUMBNAIL_SCALE_DIVIDER 8
+
+static uint8_t *derive_buffer = NULL;
+static size_t derive_buffer_size = 0;
+static int64_t last_full_frame_time = 0;
+static int64_t last_routine_time = 0;
+static volatile bool full_frame_requested = false;
+// size of the last upload of each kind, the estimate for what a skipped upload saves
+static volatile size_t last_upload_bytes[CAMERA_UPLOAD_BURST + 1];
+
+/* burst frames are copied out of the driver buffers into one psram block
+ * the block fills during the burst and drains in the background, a new burst waits until it is empty */
+#define BURST_FRAMES CONFIG_CAMERA_BURST_FRAMES
+#define BURST_INTERVAL_MS CONFIG_CAMERA_BURST_INTERVAL_MS
+#define BURST_BUFFER_SIZE (CONFIG_CAMERA_BURST_BUFFER_KB * 1024)
+
+typedef enum
+{
+    BURST_IDLE,
+    BURST_CAPTURING, // only the camera task touches the buffer
+    BURST_UPLOADING  // only the upload task touches the buffer
+} burst_state_t;
+
+typedef struct
+{
+    size_t offset;
+    size_t len;
+    uint32_t timestamp;
+} burst_frame_t;
+
+static struct
+{
+    volatile burst_state_t state;
+    volatile bool requested;
+    uint8_t *buffer;
+    size_t used;
+    burst_frame_t frames[BURST_FRAMES];
+    uint8_t count;
+    uint8_t uploaded;
+    uint32_t completed;
+    uint32_t rejected;
+} burst;
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+/* jpeg quality and frame size follow the upload throughput so the next upload fits the time budget
+ * the prediction uses the size and the measured throughput of the kind that is about to go out
+ * for full frames quality is given up first, resolution only once quality hit its bound, and won back the other way round
+ * derived images are encoded at a fixed quality, for them only the frame size is stepped */
+#define UPLOAD_BUDGET_US (CONFIG_CAMERA_UPLOAD_BUDGET_MS * 1000LL)
+#define QUALITY_BEST CONFIG_CAMERA_QUALITY_BEST
+#define QUALITY_WORST CONFIG_CAMERA_QUALITY_WORST
+#define QUALITY_STEP 4
+// improve once an upload would take less than this share of the budget
+#define ADAPT_HEADROOM 0.5f
+#define THROUGHPUT_SMOOTHING 0.3f
+
+// smallest first, the largest is the init size the driver buffers were allocated for
+static const framesize_t frame_sizes[] = {FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_SXGA, FRAMESIZE_UXGA};
+static const uint16_t frame_widths[] = {640, 800, 1024, 1280, 1600};
+#define FRAME_SIZE_COUNT (sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+
+static struct
+{
+    // bytes per second per upload kind, written by the upload task
+    // small uploads include more request latency, each kind is only predicted from its own samples
+    volatile float throughput[CAMERA_UPLOAD_BURST + 1];
+    volatile uint32_t samples[CAMERA_UPLOAD_BURST + 1];
+    uint32_t used_samples[CAMERA_UPLOAD_BURST + 1];
+    int quality;
+    uint8_t size_index;
+    uint32_t changes;
+} adapt;
+
+static const channel_config_t quality_config = {
+    .type = "JPEG Quality",
+    .deadband_absolute = 0.5f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static const channel_config_t frame_width_config = {
+    .type = "Frame Width",
+    .deadband_absolute = 0.5f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static const channel_config_t throughput_config = {
+    .type = "Upload Throughput",
+    .deadband_relative = 0.1f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static channel_t adapt_channels[3];
+#endif
 
 #define CAM_PIN_FLASH 4
 #define CAM_PIN_PWDN 32  // power down is not used
@@ -71,194 +276,564 @@ static camera_config_t camera_config = {
     .frame_size = FRAMESIZE_UXGA,   // QQVGA-UXGA, For ESP32, do not use sizes above QVGA when not JPEG. The performance of the ESP32-S series has improved a lot, but JPEG mode always gives better frame rates.
 
     .jpeg_quality = 4,                // 0-63, for OV series camera sensors, lower number means higher quality
-    .fb_count = 1,                     // When jpeg mode is used, if fb_count more than one, the driver will work in continuous mode.
+    .fb_count = CAMERA_FB_COUNT,       // When jpeg mode is used, if fb_count more than one, the driver will work in continuous mode.
     .fb_location = CAMERA_FB_IN_PSRAM, // Enable PSRAM support in menuconfig !IMPORTANT
     .grab_mode = CAMERA_GRAB_LATEST    // CAMERA_GRAB_LATEST. Sets when buffers should be filled
 };
 
-static uint32_t timestamp = 0;
-static camera_fb_t *fb = NULL;
-static esp_pm_lock_handle_t cam_power_lock;
-
-camera_fb_t *take_image()
+typedef struct
 {
-    // turn on flash and wait for AGC..settle
-    gpio_set_level(CAM_PIN_FLASH, 1);
-    vTaskDelay(pdMS_TO_TICKS(800)); // TODO figure out minimum AGC flash time
+    camera_fb_t *fb;
+    uint32_t timestamp;
+    camera_upload_kind_t kind;
+    // of the 1/8 scale preview, only valid if the decode worked
+    uint64_t hash;
+    bool has_hash;
+} camera_frame_t;
 
-    esp_pm_lock_acquire(cam_power_lock);
+static esp_pm_lock_handle_t cam_power_lock;
 
-    // acquire a frame
-    camera_fb_t *fb = esp_camera_fb_get();
-    esp_camera_fb_return(fb);
+static const uint32_t upload_ms_bounds[] = {500, 1000, 2000, 5000, 10000, 20000, 60000};
+static metric_t *upload_ms_metric;
+static metric_t *upload_bytes_metric;
+static metric_t *retransmit_bytes_metric;
+static metric_t *upload_failures_metric;
+static QueueHandle_t upload_queue = NULL;
 
-    fb = esp_camera_fb_get();
-    get_current_time(&timestamp);
+static struct
+{
+    uint32_t captured;
+    uint32_t failed;
+    uint32_t dropped;
+    uint32_t uploaded;
+    uint32_t upload_errors;
+    uint64_t bytes_uploaded;
+    uint64_t bytes_captured;
+    uint32_t derive_errors;
+    uint32_t upload_retries;
+    uint64_t bytes_retransmitted;
+    uint32_t skipped;
+    uint64_t bytes_saved;
+    uint8_t last_distance;
+    uint32_t analysed;
+    uint32_t analysis_errors;
+    int64_t analysis_us;
+} pipeline_stats;
 
-    if (!fb)
+// handles short writes, the client may accept less than offered
+// sent counts what the client took, also when the write fails part way
+static esp_err_t write_all(esp_http_client_handle_t client, const uint8_t *data, size_t length, size_t *sent)
+{
+    uint8_t stalls = 0;
+
+    while (length > 0)
     {
-        ESP_LOGE(TAG, "Camera Capture Failed");
-        // blink an error pattern
-        for (uint8_t i = 0; i < 6; i++)
+        size_t chunk = (length < UPLOAD_CHUNK_SIZE) ? length : UPLOAD_CHUNK_SIZE;
+        int written = esp_http_client_write(client, (const char *)data, chunk);
+        if (written < 0)
         {
-            gpio_set_level(CAM_PIN_FLASH, 1);
-            vTaskDelay(pdMS_TO_TICKS(10));
-            gpio_set_level(CAM_PIN_FLASH, 0);
-            vTaskDelay(pdMS_TO_TICKS(70));
+            return ESP_FAIL;
         }
+        if (written == 0)
+        {
+            if (++stalls >= UPLOAD_MAX_STALLS)
+            {
+                return ESP_ERR_TIMEOUT;
+            }
+            // the socket buffer is full, give the stack time to drain it
+            vTaskDelay(pdMS_TO_TICKS(UPLOAD_STALL_BACKOFF_MS << (stalls - 1)));
+            continue;
+        }
+
+        stalls = 0;
+        data += written;
+        length -= written;
+        *sent += written;
+    }
+
+    return ESP_OK;
+}
+
+// reads the small json response of the upload endpoints and takes the acknowledged offset
+// returns the http status, or a negative value if the request failed
+static int read_offset(esp_http_client_handle_t client, size_t *offset)
+{
+    char tmp_buf[TMP_BUFFER_LENGTH];
+
+    int content_length = esp_http_client_fetch_headers(client);
+    if (content_length < 0 || content_length >= TMP_BUFFER_LENGTH)
+    {
+        ESP_LOGE(TAG, "Unexpected response length %d", content_length);
+        return -1;
+    }
+
+    int read_len = esp_http_client_read(client, tmp_buf, TMP_BUFFER_LENGTH - 1);
+    if (read_len < 0)
+    {
+        ESP_LOGE(TAG, "Error read data");
+        return -1;
+    }
+    tmp_buf[read_len] = '\0';
+
+    int status_code = esp_http_client_get_status_code(client);
+    if (status_code == HTTP_STATUS_NOT_FOUND)
+    {
+        // the server has nothing of this image (yet), start over
+        *offset = 0;
+        return status_code;
+    }
+
+    cJSON *root = cJSON_Parse(tmp_buf);
+    cJSON *acked = cJSON_GetObjectItem(root, "offset");
+    if (cJSON_IsNumber(acked) && acked->valuedouble >= 0)
+    {
+        *offset = (size_t)acked->valuedouble;
     }
     else
     {
-        ESP_LOGI(TAG, "Frame Captured");
+        ESP_LOGE(TAG, "No offset in response: %s", tmp_buf);
+        status_code = -1;
+    }
+    cJSON_Delete(root);
 
-        // blink flash..show an image was taken
-        for (uint8_t i = 0; i < 3; i++)
+    return status_code;
+}
+
+// one chunk as its own request, the server answers with the offset it has stored up to
+// sent counts the bytes that actually went out, nothing if the connection did not open
+static esp_err_t send_chunk(esp_http_client_handle_t client, const uint8_t *buf,
+                            size_t offset, size_t chunk, size_t *acked, size_t *sent)
+{
+    char tmp_buf[TMP_BUFFER_LENGTH];
+
+    esp_http_client_set_url(client, API_V1_IMAGE_CHUNK);
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+    sprintf(tmp_buf, "%zu", offset);
+    esp_http_client_set_header(client, "Upload-Offset", tmp_buf);
+
+    esp_err_t ret = esp_http_client_open(client, chunk);
+    if (ret == ESP_OK)
+    {
+        ret = write_all(client, buf + offset, chunk, sent);
+    }
+
+    if (ret == ESP_OK)
+    {
+        int status_code = read_offset(client, acked);
+        // a conflict reports a gap, the offset in it is where to continue
+        if (status_code < 0 || (status_code >= HTTP_STATUS_BAD_REQUEST && status_code != HTTP_STATUS_CONFLICT))
         {
-            gpio_set_level(CAM_PIN_FLASH, 1);
-            vTaskDelay(pdMS_TO_TICKS(20));
-            gpio_set_level(CAM_PIN_FLASH, 0);
-            vTaskDelay(pdMS_TO_TICKS(30));
+            ESP_LOGE(TAG, "Chunk at %zu rejected (%d)", offset, status_code);
+            ret = ESP_FAIL;
         }
     }
 
-    esp_pm_lock_release(cam_power_lock);
-    return fb;
+    esp_http_client_close(client);
+    return ret;
+}
+
+// asks where to resume after a failed chunk
+static esp_err_t query_offset(esp_http_client_handle_t client, const char *upload_id, size_t *acked)
+{
+    char url[UPLOAD_URL_LENGTH];
+    snprintf(url, sizeof(url), "%s/%s", API_V1_IMAGE_CHUNK, upload_id);
+
+    esp_http_client_set_url(client, url);
+    esp_http_client_set_method(client, HTTP_METHOD_GET);
+
+    esp_err_t ret = esp_http_client_open(client, 0);
+    if (ret == ESP_OK && read_offset(client, acked) < 0)
+    {
+        ret = ESP_FAIL;
+    }
+
+    esp_http_client_close(client);
+    return ret;
 }
 
-esp_err_t post_frame(camera_fb_t *fb, uint32_t timestamp)
+// the image stays in its buffer until every byte is acknowledged
+esp_err_t post_image(const uint8_t *buf, size_t len, uint32_t timestamp, camera_upload_kind_t kind)
 {
     esp_err_t ret = ESP_OK;
-    if (!fb)
+    if (!buf)
     {
         ESP_LOGE(TAG, "Cannot publish empty image");
-        return ret;
+        return ESP_ERR_INVALID_ARG;
     }
 
     char tmp_buf[TMP_BUFFER_LENGTH];
-    char HEAD[TMP_HEAD_LENGTH];
-    char END[TMP_END_LENGTH];
+    char upload_id[UPLOAD_ID_LENGTH];
+    int64_t start_time = esp_timer_get_time();
+    configRUN_TIME_COUNTER_TYPE start_cpu = ulTaskGetRunTimeCounter(xTaskGetCurrentTaskHandle());
 
-    // setup client connection (wait for other processses..finish)
-    esp_http_client_config_t *config = get_config();
-    config->url = API_V1_POST_IMAGE;
+    // the same frame always maps to the same upload, also across reboots of the server
+    snprintf(upload_id, sizeof(upload_id), "1-%lu-%s", timestamp, upload_kind_names[kind]);
 
-    esp_http_client_handle_t client = esp_http_client_init(config);
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
+    size_t offset = 0;
+    size_t bytes_sent = 0;
+    uint8_t retries = 0;
 
-    // assemble request headers
-    sprintf(tmp_buf, "%d", 1);
-    esp_http_client_set_header(client, "Device-Id", tmp_buf);
-    sprintf(tmp_buf, "%lu", timestamp);
-    esp_http_client_set_header(client, "Timestamp", tmp_buf);
-    esp_http_client_set_header(client, "Form-Mime", "image/jpeg");
-    sprintf(tmp_buf, "multipart/form-data; boundary=%s", FILE_BOUNDARY);
-    esp_http_client_set_header(client, "Content-Type", tmp_buf);
-
-    // assemble multipart body head
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    sprintf(tmp_buf, "--%s\r\n", FILE_BOUNDARY);
-    strcpy(HEAD, tmp_buf);
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    sprintf(tmp_buf, "Content-Disposition: form-data; name=\"image\"; filename=\"image.jpg\"\r\n");
-    strcat(HEAD, tmp_buf);
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    sprintf(tmp_buf, "Content-Type: application/octet-stream\r\n\r\n");
-    strcat(HEAD, tmp_buf);
-
-    // assemble multipart body end
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    sprintf(tmp_buf, "\r\n--%s--\r\n\r\n", FILE_BOUNDARY);
-    strcpy(END, tmp_buf);
-
-    // write total length of body into the header
-    uint32_t total_len_to_send = fb->len + strnlen(HEAD, TMP_HEAD_LENGTH) + strnlen(END, TMP_END_LENGTH);
-    ESP_LOGI(TAG, "total length: %lu", total_len_to_send);
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    sprintf(tmp_buf, "%lu", total_len_to_send);
-    esp_http_client_set_header(client, "Content-Length", tmp_buf);
-
-    // open the connection
-    ESP_LOGI(TAG, "Opening Connection");
-    esp_http_client_open(client, total_len_to_send);
-
-    // write the HEAD header
-    esp_http_client_write(client, HEAD, strnlen(HEAD, TMP_HEAD_LENGTH));
-
-    // prepare..send the framebuffer
-    uint8_t *buffer = fb->buf;
-    uint8_t send_buffer[MAX_HTTP_OUTPUT_BUFFER];
-    size_t remaining_bytes = fb->len;
-
-    // send fb in chunks
-    while (remaining_bytes > 0)
-    {
-        // calculate the number of bytes..send in this iteration
-        size_t bytes_to_send = (remaining_bytes < MAX_HTTP_OUTPUT_BUFFER) ? remaining_bytes : MAX_HTTP_OUTPUT_BUFFER;
-
-        // copy data from 'buffer'..'send_buffer'
-        memcpy(send_buffer, buffer, bytes_to_send);
-        buffer += bytes_to_send;
-        remaining_bytes -= bytes_to_send;
-
-        // send the incremental package
-        esp_http_client_write(client, (char *)send_buffer, bytes_to_send);
-
-        // zero out buffer for next iteration
-        bzero(send_buffer, MAX_HTTP_OUTPUT_BUFFER);
-    }
-
-    // send multipart end
-    esp_http_client_write(client, END, strnlen(END, TMP_END_LENGTH));
-
-    // read server response
-    int content_length = esp_http_client_fetch_headers(client);
-    if (content_length <= TMP_BUFFER_LENGTH)
+    while (offset < len)
     {
-        int read_len = esp_http_client_read(client, tmp_buf, content_length);
-        if (read_len <= 0)
+        // setup client connection (wait for other processses..finish)
+        esp_http_client_config_t *config = get_config();
+        config->url = API_V1_IMAGE_CHUNK;
+        esp_http_client_handle_t client = esp_http_client_init(config);
+
+        // assemble request headers, only the offset changes between chunks
+        esp_http_client_set_header(client, "Device-Id", "1");
+        sprintf(tmp_buf, "%lu", timestamp);
+        esp_http_client_set_header(client, "Timestamp", tmp_buf);
+        esp_http_client_set_header(client, "Form-Mime", "image/jpeg");
+        esp_http_client_set_header(client, "Image-Kind", upload_kind_names[kind]);
+        esp_http_client_set_header(client, "Upload-Id", upload_id);
+        sprintf(tmp_buf, "%zu", len);
+        esp_http_client_set_header(client, "Upload-Length", tmp_buf);
+        esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+
+        // learn what already arrived before sending anything again
+        if (retries > 0)
         {
-            ESP_LOGE(TAG, "Error read data");
-            ret = ESP_FAIL;
+            size_t acked = offset;
+            if (query_offset(client, upload_id, &acked) == ESP_OK && acked <= len)
+            {
+                ESP_LOGI(TAG, "Resuming %s at %zu of %zu", upload_id, acked, len);
+                offset = acked;
+            }
         }
-        ESP_LOGI(TAG, "read data: %s", tmp_buf);
-        ESP_LOGI(TAG, "read_len = %d", read_len);
+
+        ret = ESP_OK;
+        while (ret == ESP_OK && offset < len)
+        {
+            size_t chunk = (len - offset < RESUMABLE_CHUNK_SIZE) ? len - offset : RESUMABLE_CHUNK_SIZE;
+            size_t acked = offset;
+
+            ret = send_chunk(client, buf, offset, chunk, &acked, &bytes_sent);
+            if (ret == ESP_OK && acked == offset)
+            {
+                // nothing was stored, resending the same chunk forever would not help
+                ESP_LOGE(TAG, "No progress at %zu", offset);
+                ret = ESP_ERR_INVALID_RESPONSE;
+            }
+            else if (ret == ESP_OK)
+            {
+                offset = (acked <= len) ? acked : len;
+            }
+        }
+
+        esp_http_client_cleanup(client);
+        release_config();
+
+        if (ret == ESP_OK)
+        {
+            break;
+        }
+
+        if (++retries > UPLOAD_MAX_RETRIES)
+        {
+            break;
+        }
+        pipeline_stats.upload_retries++;
+        vTaskDelay(pdMS_TO_TICKS(UPLOAD_RETRY_DELAY_MS));
+    }
+
+    int64_t end_time = esp_timer_get_time();
+    configRUN_TIME_COUNTER_TYPE end_cpu = ulTaskGetRunTimeCounter(xTaskGetCurrentTaskHandle());
+
+    // everything beyond the image size went over the air more than once
+    size_t retransmitted = (bytes_sent > len) ? bytes_sent - len : 0;
+    pipeline_stats.bytes_retransmitted += retransmitted;
+    metrics_add(retransmit_bytes_metric, retransmitted);
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+    // effective throughput including retries, a failure halves the estimate
+    if (ret == ESP_OK && end_time > start_time)
+    {
+        float sample = (float)len * 1e6f / (float)(end_time - start_time);
+        adapt.throughput[kind] = (adapt.samples[kind] == 0) ? sample : adapt.throughput[kind] + THROUGHPUT_SMOOTHING * (sample - adapt.throughput[kind]);
+        adapt.samples[kind]++;
+    }
+    else if (ret != ESP_OK && adapt.samples[kind] > 0)
+    {
+        adapt.throughput[kind] *= 0.5f;
+        adapt.samples[kind]++;
+    }
+#endif
+
+    if (ret == ESP_OK)
+    {
+        metrics_observe(upload_ms_metric, (end_time - start_time) / 1000);
+        metrics_add(upload_bytes_metric, len);
+
+        // run time counter ticks are esp_timer microseconds
+        float seconds = (float)(end_time - start_time) / 1e6f;
+        ESP_LOGI(TAG, "Uploaded %s, %zu bytes (%zu resent, %u retries) at %.1f KB/s, %lld ms total, %lu ms cpu",
+                 upload_id, len, retransmitted, retries,
+                 (seconds > 0.0f) ? (float)len / 1024.0f / seconds : 0.0f,
+                 (end_time - start_time) / 1000, (uint32_t)(end_cpu - start_cpu) / 1000);
     }
     else
     {
-        ESP_LOGE(TAG, "Response too long for buffer (%d of %d)", content_length, TMP_BUFFER_LENGTH);
+        metrics_add(upload_failures_metric, 1);
+        ESP_LOGE(TAG, "Giving up on %s at %zu of %zu bytes: %s", upload_id, offset, len, esp_err_to_name(ret));
     }
 
-    // get the response status code
-    int status_code = esp_http_client_get_status_code(client);
-    ESP_LOGI(TAG, "HTTP Status = %d, content_length = %llu",
-             status_code,
-             esp_http_client_get_content_length(client));
+    return ret;
+}
 
-    // finalize the connection no matter what happend
-    esp_http_client_close(client);
+// the configured region of interest in an image of the given size
+static void camera_roi(uint16_t width, uint16_t height, image_roi_t *roi)
+{
+    roi->x = width * CONFIG_CAMERA_ROI_LEFT / 100;
+    roi->y = height * CONFIG_CAMERA_ROI_TOP / 100;
+    roi->width = width * CONFIG_CAMERA_ROI_WIDTH / 100;
+    roi->height = height * CONFIG_CAMERA_ROI_HEIGHT / 100;
 
-    if (status_code >= HTTP_STATUS_BAD_REQUEST)
+    // clip a region reaching past the frame edge
+    if (roi->x + roi->width > width)
     {
-        ESP_LOGE(TAG, "Error sending file!");
-        ret = ESP_FAIL;
+        roi->width = width - roi->x;
     }
+    if (roi->y + roi->height > height)
+    {
+        roi->height = height - roi->y;
+    }
+}
 
-    if (ret == ESP_OK)
+// psram scratch shared by every decode of a task, follows the frame size and only grows
+static uint8_t *camera_scratch(uint8_t **buffer, size_t *buffer_size, size_t size)
+{
+    if (size > *buffer_size)
     {
-        ESP_LOGI(TAG, "HTTPS Status = %d, content_length = %" PRId64,
-                 esp_http_client_get_status_code(client),
-                 esp_http_client_get_content_length(client));
+        heap_caps_free(*buffer);
+        *buffer = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        *buffer_size = (*buffer != NULL) ? size : 0;
+        if (*buffer == NULL)
+        {
+            ESP_LOGE(TAG, "Cannot allocate %zu bytes of scratch", size);
+        }
     }
-    else
+    return *buffer;
+}
+
+// decodes the frame at reduced scale, crops it and encodes it again
+// the returned jpeg is allocated by the encoder and has to be freed
+static esp_err_t derive_image(const camera_frame_t *frame, uint8_t **out, size_t *out_len)
+{
+    int64_t start_time = esp_timer_get_time();
+
+    bool crop = (frame->kind == CAMERA_UPLOAD_ROI);
+    uint8_t divider = crop ? ROI_SCALE_DIVIDER : THUMBNAIL_SCALE_DIVIDER;
+    uint16_t width = frame->fb->width / divider;
+    uint16_t height = frame->fb->height / divider;
+
+    uint8_t *pixels = camera_scratch(&derive_buffer, &derive_buffer_size, (size_t)width * height * 2);
+    if (pixels == NULL)
     {
-        ESP_LOGE(TAG, "Error perform http request %s", esp_err_to_name(ret));
+        return ESP_ERR_NO_MEM;
     }
 
-    // cleanup
-    esp_http_client_cleanup(client);
-    release_config();
+    if (!jpg2rgb565(frame->fb->buf, frame->fb->len, pixels, crop ? ROI_SCALE : THUMBNAIL_SCALE))
+    {
+        ESP_LOGE(TAG, "Cannot decode frame");
+        return ESP_FAIL;
+    }
 
-    return ret;
+    image_roi_t roi = {.x = 0, .y = 0, .width = width, .height = height};
+    if (crop)
+    {
+        camera_roi(width, height, &roi);
+
+        // rows move towards the start of the buffer, never over rows still to be read
+        for (uint16_t row = 0; row < roi.height; row++)
+        {
+            memmove(pixels + (size_t)row * roi.width * 2,
+                    pixels + ((size_t)(roi.y + row) * width + roi.x) * 2,
+                    (size_t)roi.width * 2);
+        }
+    }
+
+    if (!fmt2jpg(pixels, (size_t)roi.width * roi.height * 2, roi.width, roi.height,
+                 PIXFORMAT_RGB565, CONFIG_CAMERA_DERIVED_QUALITY, out, out_len))
+    {
+        ESP_LOGE(TAG, "Cannot encode %s", upload_kind_names[frame->kind]);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "%s %ux%u: %zu KB -> %zu KB in %lld ms", upload_kind_names[frame->kind],
+             roi.width, roi.height, frame->fb->len / 1024, *out_len / 1024,
+             (esp_timer_get_time() - start_time) / 1000);
+    return ESP_OK;
+}
+
+static esp_err_t decode_preview(const camera_frame_t *frame, uint16_t *width, uint16_t *height)
+{
+    *width = frame->fb->width / PREVIEW_SCALE_DIVIDER;
+    *height = frame->fb->height / PREVIEW_SCALE_DIVIDER;
+
+    // the exposure probes already decoded the frame that was kept
+    if (frame->fb == preview_fb)
+    {
+        return ESP_OK;
+    }
+
+    if (camera_scratch(&preview_buffer, &preview_buffer_size, (size_t)*width * *height * 2) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (!jpg2rgb565(frame->fb->buf, frame->fb->len, preview_buffer, PREVIEW_SCALE))
+    {
+        ESP_LOGE(TAG, "Cannot decode preview");
+        return ESP_FAIL;
+    }
+    preview_fb = frame->fb;
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_CAMERA_ANALYSIS
+static esp_err_t analyse_frame(const camera_frame_t *frame, uint16_t width, uint16_t height)
+{
+    int64_t start_time = esp_timer_get_time();
+
+    image_roi_t roi;
+    camera_roi(width, height, &roi);
+
+    image_stats_t stats;
+    esp_err_t ret = image_stats_rgb565(preview_buffer, width, height, &roi, &stats);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    channel_update_at(&channels[0], stats.green_red_ratio, frame->timestamp);
+    channel_update_at(&channels[1], stats.biomass_index, frame->timestamp);
+
+    pipeline_stats.analysis_us = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Analysed %ux%u roi in %lld ms: r %.3f g %.3f b %.3f, g/r %.3f, biomass %.3f",
+             roi.width, roi.height, pipeline_stats.analysis_us / 1000,
+             stats.mean_r, stats.mean_g, stats.mean_b, stats.green_red_ratio, stats.biomass_index);
+
+    // histogram in percent of the roi, one line per channel
+    const uint32_t *histograms[] = {stats.histogram_r, stats.histogram_g, stats.histogram_b};
+    for (uint8_t c = 0; c < 3; c++)
+    {
+        char line[IMAGE_HISTOGRAM_BINS * 4 + 1];
+        size_t length = 0;
+        for (uint8_t bin = 0; bin < IMAGE_HISTOGRAM_BINS; bin++)
+        {
+            length += snprintf(line + length, sizeof(line) - length, " %3lu",
+                               histograms[c][bin] * 100 / stats.pixels);
+        }
+        ESP_LOGD(TAG, "%c:%s", "rgb"[c], line);
+    }
+
+    return ESP_OK;
+}
+#endif
+
+static void upload_burst_frame()
+{
+    const burst_frame_t *frame = &burst.frames[burst.uploaded];
+
+    // a failed frame is retried on the next idle turn, the burst never loses its order
+    if (post_image(burst.buffer + frame->offset, frame->len, frame->timestamp, CAMERA_UPLOAD_BURST) != ESP_OK)
+    {
+        pipeline_stats.upload_errors++;
+        return;
+    }
+
+    pipeline_stats.uploaded++;
+    pipeline_stats.bytes_uploaded += frame->len;
+    last_upload_bytes[CAMERA_UPLOAD_BURST] = frame->len;
+
+    if (++burst.uploaded >= burst.count)
+    {
+        ESP_LOGI(TAG, "Burst of %u frames uploaded", burst.count);
+        burst.completed++;
+        burst.state = BURST_IDLE;
+    }
+}
+
+static void camera_upload_task(void *pvparameters)
+{
+    camera_frame_t frame;
+
+    while (1)
+    {
+        // captured frames go first, a pending burst drains whenever the queue is empty
+        if (xQueueReceive(upload_queue, &frame, pdMS_TO_TICKS(500)) != pdPASS)
+        {
+            if (burst.state == BURST_UPLOADING)
+            {
+                upload_burst_frame();
+            }
+            continue;
+        }
+
+        const uint8_t *buf = frame.fb->buf;
+        size_t len = frame.fb->len;
+        uint8_t *derived = NULL;
+
+        if (frame.kind != CAMERA_UPLOAD_FULL)
+        {
+            if (derive_image(&frame, &derived, &len) != ESP_OK)
+            {
+                pipeline_stats.derive_errors++;
+                esp_camera_fb_return(frame.fb);
+                continue;
+            }
+            buf = derived;
+
+            // the frame is no longer needed, the driver gets it back before the upload
+            esp_camera_fb_return(frame.fb);
+            frame.fb = NULL;
+        }
+
+        if (post_image(buf, len, frame.timestamp, frame.kind) == ESP_OK)
+        {
+            pipeline_stats.uploaded++;
+            pipeline_stats.bytes_uploaded += len;
+            last_upload_bytes[frame.kind] = len;
+        }
+        else
+        {
+            pipeline_stats.upload_errors++;
+        }
+
+        // hands the buffer back to the driver for the next capture
+        if (frame.fb != NULL)
+        {
+            esp_camera_fb_return(frame.fb);
+        }
+        free(derived);
+    }
+}
+
+static void camera_enqueue(camera_frame_t *frame)
+{
+    if (xQueueSend(upload_queue, frame, 0) == pdPASS)
+    {
+        return;
+    }
+
+    camera_frame_t dropped;
+    if (CAMERA_DROP_POLICY == CAMERA_DROP_OLDEST && xQueueReceive(upload_queue, &dropped, 0) == pdPASS)
+    {
+        esp_camera_fb_return(dropped.fb);
+        pipeline_stats.dropped++;
+        ESP_LOGW(TAG, "Upload queue full, dropping frame from %lu", dropped.timestamp);
+
+        if (xQueueSend(upload_queue, frame, 0) == pdPASS)
+        {
+            return;
+        }
+    }
+
+    esp_camera_fb_return(frame->fb);
+    pipeline_stats.dropped++;
+    ESP_LOGW(TAG, "Upload queue full, dropping frame from %lu", frame->timestamp);
 }
 
 esp_err_t camera_init()
@@ -326,38 +901,483 @@ esp_err_t camera_init()
         esp_camera_fb_return(fb);
     }
 
+    upload_ms_metric = metrics_histogram("camera_upload_ms", upload_ms_bounds,
+                                         sizeof(upload_ms_bounds) / sizeof(upload_ms_bounds[0]));
+    upload_bytes_metric = metrics_counter("camera_upload_bytes");
+    retransmit_bytes_metric = metrics_counter("camera_retransmit_bytes");
+    upload_failures_metric = metrics_counter("camera_upload_failures");
+
+    // uploads run behind the capture cadence and never hold it up
+    upload_queue = xQueueCreate(CAMERA_UPLOAD_QUEUE_LENGTH, sizeof(camera_frame_t));
+    if (upload_queue == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot create Queue");
+        esp_pm_lock_release(cam_power_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(&camera_upload_task, "Cam Upload", 4096, NULL, configMAX_PRIORITIES - 6, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Cannot create upload task");
+        esp_pm_lock_release(cam_power_lock);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // reserved up front, a burst must not fail on a fragmented heap
+    burst.buffer = heap_caps_malloc(BURST_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    if (burst.buffer == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot allocate burst buffer, bursts disabled");
+    }
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+    channel_init(&adapt_channels[0], &quality_config);
+    channel_init(&adapt_channels[1], &frame_width_config);
+    channel_init(&adapt_channels[2], &throughput_config);
+    adapt.quality = camera_config.jpeg_quality;
+    adapt.size_index = FRAME_SIZE_COUNT - 1;
+#endif
+
+#ifdef CONFIG_CAMERA_ANALYSIS
+    channel_init(&channels[0], &green_red_config);
+    channel_init(&channels[1], &biomass_config);
+#endif
+
     ESP_LOGI(TAG, "Camera done");
     esp_pm_lock_release(cam_power_lock);
     return ESP_OK;
 }
 
+// full frames at a fixed rate with the flash on, copied out so the driver keeps its buffers
+static void take_burst()
+{
+    if (burst.buffer == NULL || burst.state != BURST_IDLE)
+    {
+        ESP_LOGW(TAG, "Burst rejected, %s", (burst.buffer == NULL) ? "no buffer" : "previous burst still uploading");
+        burst.rejected++;
+        return;
+    }
+
+    burst.state = BURST_CAPTURING;
+    burst.used = 0;
+    burst.count = 0;
+    burst.uploaded = 0;
+
+    gpio_set_level(CAM_PIN_FLASH, 1);
+    esp_pm_lock_acquire(cam_power_lock);
+
+    // the latest buffer may still be from before the flash
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (fb)
+    {
+        esp_camera_fb_return(fb);
+    }
+
+    int64_t first_time = 0;
+    int64_t last_time = 0;
+    TickType_t wake_time = xTaskGetTickCount();
+
+    while (burst.count < BURST_FRAMES)
+    {
+        fb = esp_camera_fb_get();
+        if (!fb)
+        {
+            ESP_LOGE(TAG, "Burst capture failed");
+            break;
+        }
+
+        burst_frame_t *frame = &burst.frames[burst.count];
+        get_current_time(&frame->timestamp);
+        last_time = esp_timer_get_time();
+        if (burst.count == 0)
+        {
+            first_time = last_time;
+        }
+
+        if (burst.used + fb->len > BURST_BUFFER_SIZE)
+        {
+            ESP_LOGW(TAG, "Burst buffer full after %u frames", burst.count);
+            esp_camera_fb_return(fb);
+            break;
+        }
+
+        frame->offset = burst.used;
+        frame->len = fb->len;
+        memcpy(burst.buffer + burst.used, fb->buf, fb->len);
+        burst.used += fb->len;
+        burst.count++;
+        esp_camera_fb_return(fb);
+
+        if (burst.count < BURST_FRAMES)
+        {
+            vTaskDelayUntil(&wake_time, pdMS_TO_TICKS(BURST_INTERVAL_MS));
+        }
+    }
+
+    gpio_set_level(CAM_PIN_FLASH, 0);
+    esp_pm_lock_release(cam_power_lock);
+
+    float seconds = (float)(last_time - first_time) / 1e6f;
+    ESP_LOGI(TAG, "Burst of %u frames at %.2f fps, %zu of %d KB buffer used, %zu KB psram free",
+             burst.count, (burst.count > 1 && seconds > 0.0f) ? (float)(burst.count - 1) / seconds : 0.0f,
+             burst.used / 1024, CONFIG_CAMERA_BURST_BUFFER_KB,
+             heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
+
+    // hands the buffer over to the upload task
+    burst.state = (burst.count > 0) ? BURST_UPLOADING : BURST_IDLE;
+}
+
 esp_err_t camera_start()
 {
+#ifdef CONFIG_CAMERA_BURST_ON_MIXING
+    // a burst at the start of every mixing phase
+    static mixing_phase_t last_phase = MIXING_QUIET;
+    mixing_phase_t phase = mixing_get_phase();
+    if (phase == MIXING_ACTIVE && last_phase != MIXING_ACTIVE)
+    {
+        burst.requested = true;
+    }
+    last_phase = phase;
+#endif
+
+    if (burst.requested)
+    {
+        burst.requested = false;
+        take_burst();
+    }
+
     return ESP_OK;
 }
 
+// flash on, then frames are grabbed until their brightness settles
+// the frame that shows the settled exposure is kept, the ones before are returned
+camera_fb_t *take_image(uint32_t *timestamp)
+{
+    int64_t start_time = esp_timer_get_time();
+    gpio_set_level(CAM_PIN_FLASH, 1);
+
+    esp_pm_lock_acquire(cam_power_lock);
+    int64_t lock_time = esp_timer_get_time();
+
+    camera_fb_t *fb = NULL;
+    float last_luma = -1.0f;
+    uint8_t stable = 0;
+    uint8_t probes = 0;
+    bool converged = false;
+
+    while (1)
+    {
+        fb = esp_camera_fb_get();
+        if (!fb)
+        {
+            break;
+        }
+        get_current_time(timestamp);
+        probes++;
+
+        // mean luma of the preview, a frame that fails to decode counts as unsettled
+        float luma = -1.0f;
+        uint16_t width, height;
+        camera_frame_t probe = {.fb = fb};
+        // the driver refills returned buffers, the same pointer is a new frame here
+        preview_fb = NULL;
+        if (decode_preview(&probe, &width, &height) == ESP_OK)
+        {
+            image_roi_t all = {.x = 0, .y = 0, .width = width, .height = height};
+            image_stats_t stats;
+            if (image_stats_rgb565(preview_buffer, width, height, &all, &stats) == ESP_OK)
+            {
+                luma = 0.299f * stats.mean_r + 0.587f * stats.mean_g + 0.114f * stats.mean_b;
+            }
+        }
+
+        stable = (luma >= 0.0f && last_luma >= 0.0f && fabsf(luma - last_luma) <= EXPOSURE_TOLERANCE) ? stable + 1 : 0;
+        last_luma = luma;
+        ESP_LOGD(TAG, "Exposure probe %u: luma %.3f", probes, luma);
+
+        if (stable >= EXPOSURE_STABLE_FRAMES)
+        {
+            converged = true;
+            break;
+        }
+        // after the timeout the latest frame is taken as is
+        if (esp_timer_get_time() - start_time >= EXPOSURE_TIMEOUT_US)
+        {
+            break;
+        }
+
+        esp_camera_fb_return(fb);
+    }
+
+    int64_t capture_time = esp_timer_get_time();
+    gpio_set_level(CAM_PIN_FLASH, 0);
+
+    if (converged)
+    {
+        exposure_stats.converged++;
+    }
+    else if (fb)
+    {
+        exposure_stats.timeouts++;
+    }
+    exposure_stats.flash_on_us += capture_time - start_time;
+
+    if (!fb)
+    {
+        ESP_LOGE(TAG, "Camera Capture Failed");
+        // blink an error pattern
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            gpio_set_level(CAM_PIN_FLASH, 1);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            gpio_set_level(CAM_PIN_FLASH, 0);
+            vTaskDelay(pdMS_TO_TICKS(70));
+        }
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Frame Captured");
+
+        // blink flash..show an image was taken
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            gpio_set_level(CAM_PIN_FLASH, 1);
+            vTaskDelay(pdMS_TO_TICKS(20));
+            gpio_set_level(CAM_PIN_FLASH, 0);
+            vTaskDelay(pdMS_TO_TICKS(30));
+        }
+    }
+
+    esp_pm_lock_release(cam_power_lock);
+    int64_t release_time = esp_timer_get_time();
+    exposure_stats.lock_held_us += release_time - lock_time;
+
+    // the flash is on from the start until the frame is taken, the blinks aside
+    ESP_LOGI(TAG, "Exposure %s after %u frames, luma %.3f: capture latency and flash on %lld ms, lock held %lld ms",
+             converged ? "settled" : "timed out", probes, last_luma,
+             (capture_time - start_time) / 1000, (release_time - lock_time) / 1000);
+    return fb;
+}
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+// one step per new throughput sample of the kind, applied through the sensor setters for the next capture
+static void adapt_settings(camera_upload_kind_t kind, size_t upload_len)
+{
+    if (upload_len == 0 || adapt.samples[kind] == adapt.used_samples[kind] || adapt.throughput[kind] <= 0.0f)
+    {
+        return;
+    }
+    adapt.used_samples[kind] = adapt.samples[kind];
+
+    bool full = (kind == CAMERA_UPLOAD_FULL);
+    float predicted_us = (float)upload_len * 1e6f / adapt.throughput[kind];
+    int quality = adapt.quality;
+    uint8_t size_index = adapt.size_index;
+
+    if (predicted_us > UPLOAD_BUDGET_US)
+    {
+        if (full && quality < QUALITY_WORST)
+        {
+            quality = (quality + QUALITY_STEP < QUALITY_WORST) ? quality + QUALITY_STEP : QUALITY_WORST;
+        }
+        else if (size_index > 0)
+        {
+            size_index--;
+        }
+    }
+    else if (predicted_us < UPLOAD_BUDGET_US * ADAPT_HEADROOM)
+    {
+        if (size_index < FRAME_SIZE_COUNT - 1)
+        {
+            size_index++;
+        }
+        else if (full && quality > QUALITY_BEST)
+        {
+            quality = (quality - QUALITY_STEP > QUALITY_BEST) ? quality - QUALITY_STEP : QUALITY_BEST;
+        }
+    }
+
+    if (quality == adapt.quality && size_index == adapt.size_index)
+    {
+        return;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (quality != adapt.quality)
+    {
+        s->set_quality(s, quality);
+    }
+    if (size_index != adapt.size_index)
+    {
+        s->set_framesize(s, frame_sizes[size_index]);
+    }
+
+    ESP_LOGI(TAG, "%s of %zu KB at %.1f KB/s would take %lld ms, quality %d -> %d, width %u -> %u",
+             upload_kind_names[kind], upload_len / 1024, adapt.throughput[kind] / 1024.0f, (int64_t)predicted_us / 1000,
+             adapt.quality, quality, frame_widths[adapt.size_index], frame_widths[size_index]);
+
+    adapt.quality = quality;
+    adapt.size_index = size_index;
+    adapt.changes++;
+}
+#endif
+
+// hamming distance of the preview hashes against the last uploaded frame
+static bool frame_changed(const camera_frame_t *frame, int64_t now)
+{
+    if (CHANGE_THRESHOLD == 0 || !frame->has_hash || !has_reference)
+    {
+        return true;
+    }
+
+    pipeline_stats.last_distance = __builtin_popcountll(frame->hash ^ reference_hash);
+    if (pipeline_stats.last_distance >= CHANGE_THRESHOLD)
+    {
+        return true;
+    }
+
+    // a keyframe now and then, in case the change is too slow to ever cross the threshold
+    return (now - last_keyframe_time >= KEYFRAME_INTERVAL_US);
+}
+
 esp_err_t camera_update()
 {
-    fb = take_image();
+    camera_frame_t frame;
+    frame.fb = take_image(&frame.timestamp);
+    if (!frame.fb)
+    {
+        pipeline_stats.failed++;
+        return ESP_FAIL;
+    }
+
+    pipeline_stats.captured++;
+    pipeline_stats.bytes_captured += frame.fb->len;
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+    // the settings this frame was taken with
+    channel_update_at(&adapt_channels[0], adapt.quality, frame.timestamp);
+    channel_update_at(&adapt_channels[1], frame_widths[adapt.size_index], frame.timestamp);
+#endif
+
+    uint16_t width, height;
+    frame.has_hash = false;
+    if (decode_preview(&frame, &width, &height) == ESP_OK)
+    {
+        frame.hash = image_dhash_rgb565(preview_buffer, width, height);
+        frame.has_hash = true;
+
+#ifdef CONFIG_CAMERA_ANALYSIS
+        if (analyse_frame(&frame, width, height) == ESP_OK)
+        {
+            pipeline_stats.analysed++;
+        }
+        else
+        {
+            pipeline_stats.analysis_errors++;
+        }
+#endif
+    }
+
+    // full frames on request and on the slow schedule, routine uploads in between
+    int64_t now = esp_timer_get_time();
+    frame.kind = CAMERA_UPLOAD_NONE;
+    if (full_frame_requested || last_full_frame_time == 0 || now - last_full_frame_time >= FULL_FRAME_INTERVAL_US)
+    {
+        full_frame_requested = false;
+        frame.kind = CAMERA_UPLOAD_FULL;
+        last_full_frame_time = now;
+        last_routine_time = now;
+    }
+    else if (CAMERA_ROUTINE_UPLOAD != CAMERA_UPLOAD_NONE && now - last_routine_time >= ROUTINE_INTERVAL_US)
+    {
+        last_routine_time = now;
+        if (frame_changed(&frame, now))
+        {
+            frame.kind = CAMERA_ROUTINE_UPLOAD;
+        }
+        else
+        {
+            pipeline_stats.skipped++;
+            pipeline_stats.bytes_saved += last_upload_bytes[CAMERA_ROUTINE_UPLOAD];
+            ESP_LOGI(TAG, "Unchanged (distance %u), skipping upload", pipeline_stats.last_distance);
+        }
+    }
+
+    if (frame.kind == CAMERA_UPLOAD_NONE)
+    {
+        esp_camera_fb_return(frame.fb);
+        return ESP_OK;
+    }
+
+#ifdef CONFIG_CAMERA_ADAPTIVE
+    // the settings for the next frame, predicted from what goes out now
+    // a derived image is expected at the size of the last one of its kind
+    if (adapt.samples[frame.kind] > 0)
+    {
+        channel_update_at(&adapt_channels[2], adapt.throughput[frame.kind] / 1024.0f, frame.timestamp);
+    }
+    adapt_settings(frame.kind, (frame.kind == CAMERA_UPLOAD_FULL) ? frame.fb->len : last_upload_bytes[frame.kind]);
+#endif
+
+    // later frames are compared against what the server has seen last
+    if (frame.has_hash)
+    {
+        reference_hash = frame.hash;
+        has_reference = true;
+        last_keyframe_time = now;
+    }
+
+    camera_enqueue(&frame);
     return ESP_OK;
 }
 
 esp_err_t camera_publish()
 {
-    if (!fb)
-    {
-        fb = take_image();
-    }
-    post_frame(fb, timestamp);
+#ifdef CONFIG_CAMERA_ANALYSIS
+    channel_t *const group[] = {&channels[0], &channels[1]};
+    channel_publish_group(group, 2);
+    ESP_LOGI(TAG, "Analysis: %lu frames, %lu errors, last took %lld ms",
+             pipeline_stats.analysed, pipeline_stats.analysis_errors, pipeline_stats.analysis_us / 1000);
+#endif
+
+    ESP_LOGI(TAG, "Pipeline: %lu captured, %lu failed, %lu dropped, %lu uploaded, %lu upload errors, %lu derive errors, %u in flight",
+             pipeline_stats.captured, pipeline_stats.failed, pipeline_stats.dropped,
+             pipeline_stats.uploaded, pipeline_stats.upload_errors, pipeline_stats.derive_errors,
+             uxQueueMessagesWaiting(upload_queue));
+    uint32_t exposures = exposure_stats.converged + exposure_stats.timeouts;
+    ESP_LOGI(TAG, "Exposure: %lu settled, %lu timed out, per frame %lld ms flash on and %lld ms lock held",
+             exposure_stats.converged, exposure_stats.timeouts,
+             (exposures > 0) ? exposure_stats.flash_on_us / exposures / 1000 : 0,
+             (exposures > 0) ? exposure_stats.lock_held_us / exposures / 1000 : 0);
+#ifdef CONFIG_CAMERA_ADAPTIVE
+    channel_t *const adapt_group[] = {&adapt_channels[0], &adapt_channels[1], &adapt_channels[2]};
+    channel_publish_group(adapt_group, 3);
+    ESP_LOGI(TAG, "Adaptive: quality %d, width %u, %.1f KB/s %s, %.1f KB/s full, %lu changes",
+             adapt.quality, frame_widths[adapt.size_index],
+             adapt.throughput[CAMERA_ROUTINE_UPLOAD] / 1024.0f, upload_kind_names[CAMERA_ROUTINE_UPLOAD],
+             adapt.throughput[CAMERA_UPLOAD_FULL] / 1024.0f, adapt.changes);
+#endif
+
+    ESP_LOGI(TAG, "Bursts: %lu uploaded, %lu rejected, %u of %u frames of the current one uploaded",
+             burst.completed, burst.rejected, burst.uploaded, burst.count);
+    ESP_LOGI(TAG, "Uploads: %lu retries, %llu KB retransmitted",
+             pipeline_stats.upload_retries, pipeline_stats.bytes_retransmitted / 1024);
+    ESP_LOGI(TAG, "Bytes: %llu KB captured, %llu KB uploaded, %lu unchanged uploads skipped saving about %llu KB",
+             pipeline_stats.bytes_captured / 1024, pipeline_stats.bytes_uploaded / 1024,
+             pipeline_stats.skipped, pipeline_stats.bytes_saved / 1024);
     return ESP_OK;
 }
 
 esp_err_t camera_end()
 {
-    if (fb)
-    {
-        esp_camera_fb_return(fb);
-        fb = NULL;
-    }
     return ESP_OK;
 }
+
+void camera_request_full_frame()
+{
+    full_frame_requested = true;
+}
+
+void camera_request_burst()
+{
+    burst.requested = true;
+}
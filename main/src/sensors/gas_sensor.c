@@ -1,23 +1,48 @@
-#include <math.h>
-
 #include "freertos/FreeRTOS.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
 
-#include "timer.h"
-#include "measurement.h"
-#include "ringbuffer.h"
+#include "channel.h"
+#include "metrics.h"
 #include "sensors/gas_sensor.h"
 
+#include "scd4x.h"
+
 static const char *TAG = "CO2";
 
-extern QueueHandle_t xMeasurementQueue;
-static ringbuffer_t buffer;
+// gas_update sleeps until the next result, bounded so that publishing still happens on a dead sensor
+#define GAS_WAIT_MS (2 * SCD4X_PERIOD_MS)
+
+// one sample every 5 s, too slow to be worth decimating
+static const channel_config_t channel_config = {
+    .type = "CO2",
+    .outlier_window = 5,
+    .outlier_threshold = 3.0f,
+    .outlier_min_deviation = 20.0f,
+    .deadband_absolute = 10.0f,
+    .deadband_relative = 0.02f,
+    .heartbeat_interval = 10ULL * 60ULL * 1000ULL,
+};
+static channel_t channel;
+
+static scd4x_device_t scd4x_dev;
+
+static metric_t *crc_errors_metric;
+static uint32_t reported_crc_errors = 0;
 
 esp_err_t gas_init()
 {
-    return ESP_OK;
+    channel_init(&channel, &channel_config);
+    crc_errors_metric = metrics_counter("scd4x_crc_errors");
+
+    esp_err_t ret = scd4x_init(&scd4x_dev);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return scd4x_start_periodic(&scd4x_dev);
 }
 
 esp_err_t gas_start()
@@ -25,43 +50,36 @@ esp_err_t gas_start()
     return ESP_OK;
 }
 
-static uint32_t tmp_counter = 0;
 esp_err_t gas_update()
 {
-    // take gas sensor reading
-    float co2 = cosf(tmp_counter++ / 40.0) * 100;
-    buffer_write(&buffer, toFixed(co2));
-    ESP_LOGD(TAG, "gas: %f", co2);
+    // blocks instead of waking the task for every poll, the bus is only touched once the next result is due
+    scd4x_measurement_t measurement;
+    esp_err_t ret = scd4x_wait(&scd4x_dev, &measurement, GAS_WAIT_MS);
+    if (ret == ESP_ERR_NOT_FOUND)
+    {
+        return ESP_OK;
+    }
+    else if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    channel_update_at(&channel, measurement.co2_ppm, measurement.timestamp);
+    ESP_LOGD(TAG, "co2: %u ppm", measurement.co2_ppm);
 
     return ESP_OK;
 }
 
 esp_err_t gas_publish()
 {
-    uint32_t time = 0;
-    get_current_time(&time);
-
-    // decimation filter
-    uint16_t count = 0;
-    float accumulator = 0.0f;
-    int32_t tmp = 0;
-    while (buffer_read(&buffer, &tmp) == ESP_OK)
-    {
-        accumulator += toFloat(tmp);
-        count++;
-    }
-
-    // simple variable MVA
-    float averageCO2 = accumulator / (float)count;
+    channel_publish(&channel);
 
-    // post downsapled sensor reading
-    measurement_t measurement = {
-        .timestamp = time,
-        .type = "CO2",
-        .value = averageCO2};
-    if (xQueueSend(xMeasurementQueue, &measurement, pdTICKS_TO_MS(500)) != pdPASS)
+    uint32_t crc_errors = scd4x_dev.crc_errors;
+    if (crc_errors != reported_crc_errors)
     {
-        ESP_LOGE(TAG, "Cannot insert message into queue");
+        ESP_LOGW(TAG, "%lu CRC errors since last publish", crc_errors - reported_crc_errors);
+        metrics_add(crc_errors_metric, crc_errors - reported_crc_errors);
+        reported_crc_errors = crc_errors;
     }
 
     return ESP_OK;
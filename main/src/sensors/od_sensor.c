@@ -1,71 +1,328 @@
 #include <math.h>
+#include <string.h>
 
 #include "freertos/FreeRTOS.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/gptimer.h"
+#include "esp_adc/adc_oneshot.h"
+#include "sdkconfig.h"
 
-#include "timer.h"
-#include "measurement.h"
-#include "ringbuffer.h"
+#include "channel.h"
+#include "lockin.h"
 #include "sensors/od_sensor.h"
+#include "tasks/mixing.h"
 
 static const char *TAG = "OD";
 
-extern QueueHandle_t xMeasurementQueue;
-static ringbuffer_t buffer;
+// emitter led and photodiode amplifier, the onboard status led on GPIO 33 has to be removed
+#define OD_PIN_LED 2
+#define OD_ADC_UNIT ADC_UNIT_1
+#define OD_ADC_CHANNEL ADC_CHANNEL_5
 
-esp_err_t od_init()
+// 8 kHz sampling, the led is toggled by the same timer at 500 Hz so the reference is phase locked
+#define OD_SAMPLE_FREQUENCY 8000
+#define OD_PERIOD_SAMPLES 16
+// 100 ms spans whole 50 Hz and 60 Hz mains periods, ambient flicker cancels as well
+#define OD_WINDOW_SAMPLES 800
+// photodiode and amplifier settling before samples are kept
+#define OD_SETTLE_SAMPLES (4 * OD_PERIOD_SAMPLES)
+#define OD_ADC_MIDSCALE 2048
+#define OD_ACQUISITION_US ((OD_SETTLE_SAMPLES + OD_WINDOW_SAMPLES) * 1000000LL / OD_SAMPLE_FREQUENCY)
+// the window has to end this long before the pumps start again
+#define OD_QUIET_MARGIN_US 50000LL
+
+// lock-in amplitude through a bottle of blank medium
+#define OD_BLANK_AMPLITUDE ((float)CONFIG_OD_BLANK_AMPLITUDE)
+
+static const channel_config_t channel_config = {
+    .type = "OD",
+    .outlier_window = 5,
+    .outlier_threshold = 3.0f,
+    .outlier_min_deviation = 0.05f,
+    .deadband_relative = 0.01f,
+    .heartbeat_interval = 15ULL * 60ULL * 1000ULL,
+};
+static channel_t channel;
+
+typedef enum
 {
-    return ESP_OK;
+    OD_IDLE,
+    OD_ACQUIRING,
+} od_state_t;
+
+static od_state_t state = OD_IDLE;
+static lockin_t lockin;
+
+// an update only requests a reading, it is taken in the next quiet window of the mixing
+static bool requested = false;
+static bool deferred = false;
+static int64_t request_time = 0;
+static uint32_t acquisition_cycle = 0;
+
+// time from a reading being both requested and allowed to its start
+static struct
+{
+    uint32_t decisions;
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;
+    uint32_t deferred;
+    uint32_t aborted;
+    uint32_t invalid;
+} schedule_stats;
+
+static adc_oneshot_unit_handle_t adc_handle = NULL;
+static gptimer_handle_t timer = NULL;
+
+static int16_t samples[OD_WINDOW_SAMPLES];
+static volatile uint32_t sample_index = 0;
+static volatile bool acquired = false;
+// a missed sample would leave a stale value in the window, the whole window is dropped instead
+static volatile bool sample_failed = false;
+
+// runs from IRAM with the cache disabled, see sdkconfig.defaults
+static bool IRAM_ATTR od_on_sample(gptimer_handle_t gptimer, const gptimer_alarm_event_data_t *edata, void *ctx)
+{
+    uint32_t index = sample_index;
+    int raw = 0;
+
+    if (index >= OD_SETTLE_SAMPLES)
+    {
+        if (adc_oneshot_read_isr(adc_handle, OD_ADC_CHANNEL, &raw) == ESP_OK)
+        {
+            samples[index - OD_SETTLE_SAMPLES] = (int16_t)(raw - OD_ADC_MIDSCALE);
+        }
+        else
+        {
+            sample_failed = true;
+        }
+    }
+    index++;
+
+    if (index >= OD_SETTLE_SAMPLES + OD_WINDOW_SAMPLES)
+    {
+        gptimer_stop(gptimer);
+        gpio_set_level(OD_PIN_LED, 0);
+        acquired = true;
+    }
+    else
+    {
+        // on for the first half of every reference period
+        gpio_set_level(OD_PIN_LED, (index % OD_PERIOD_SAMPLES) < (OD_PERIOD_SAMPLES / 2));
+    }
+
+    sample_index = index;
+    return false;
 }
 
-esp_err_t od_start()
+static esp_err_t od_begin_acquisition()
 {
+    sample_index = 0;
+    acquired = false;
+    sample_failed = false;
+
+    // the timer only holds its pm lock while enabled
+    esp_err_t ret = gptimer_enable(timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    gptimer_set_raw_count(timer, 0);
+
+    gpio_set_level(OD_PIN_LED, 1);
+    ret = gptimer_start(timer);
+    if (ret != ESP_OK)
+    {
+        gpio_set_level(OD_PIN_LED, 0);
+        gptimer_disable(timer);
+        return ret;
+    }
+
+    state = OD_ACQUIRING;
     return ESP_OK;
 }
 
-static uint32_t tmp_counter = 0;
-esp_err_t od_update()
+static void od_try_acquisition()
 {
-    // take od sensor reading
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    float od = cosf(tmp_counter++ / 500.0) * 100;
-    buffer_write(&buffer, toFixed(od));
-    ESP_LOGD(TAG, "od: %f", od);
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    int64_t since, until;
+    uint32_t cycle;
+    int64_t now = esp_timer_get_time();
 
-    return ESP_OK;
+    bool quiet = mixing_get_quiet_window(&since, &until, &cycle);
+    if (!quiet || until - now < OD_ACQUISITION_US + OD_QUIET_MARGIN_US)
+    {
+        if (!deferred)
+        {
+            deferred = true;
+            schedule_stats.deferred++;
+        }
+        return;
+    }
+
+    if (od_begin_acquisition() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start acquisition");
+        return;
+    }
+
+    requested = false;
+    acquisition_cycle = cycle;
+
+    int64_t allowed = (since > request_time) ? since : request_time;
+    uint32_t latency = (uint32_t)(now - allowed);
+    schedule_stats.decisions++;
+    schedule_stats.latency_sum_us += latency;
+    if (latency > schedule_stats.latency_max_us)
+    {
+        schedule_stats.latency_max_us = latency;
+    }
 }
 
-esp_err_t od_publish()
+static void od_finish_acquisition()
+{
+    gptimer_disable(timer);
+    state = OD_IDLE;
+
+    // a window overlapping the mixing is worse than none
+    int64_t since, until;
+    uint32_t cycle;
+    if (!mixing_get_quiet_window(&since, &until, &cycle) || cycle != acquisition_cycle)
+    {
+        ESP_LOGW(TAG, "Mixing started during acquisition, dropping it");
+        schedule_stats.aborted++;
+        return;
+    }
+
+    if (sample_failed)
+    {
+        ESP_LOGW(TAG, "ADC read failed during acquisition, dropping it");
+        schedule_stats.invalid++;
+        return;
+    }
+
+    lockin_reset(&lockin);
+    lockin_push(&lockin, samples, OD_WINDOW_SAMPLES);
+
+    lockin_result_t result;
+    if (!lockin_result(&lockin, &result) || result.amplitude <= 0.0f)
+    {
+        ESP_LOGW(TAG, "No signal");
+        return;
+    }
+
+    float od = log10f(OD_BLANK_AMPLITUDE / result.amplitude);
+    channel_update(&channel, od);
+    ESP_LOGD(TAG, "od: %f (amplitude %f, ambient %f)", od, result.amplitude, result.dc + OD_ADC_MIDSCALE);
+}
+
+esp_err_t od_init()
 {
-    uint32_t time = 0;
-    get_current_time(&time);
+    channel_init(&channel, &channel_config);
 
-    // decimation filter
-    uint16_t count = 0;
-    float accumulator = 0.0f;
-    int32_t tmp = 0;
-    while (buffer_read(&buffer, &tmp) == ESP_OK)
+    esp_err_t ret = lockin_init(&lockin, OD_PERIOD_SAMPLES);
+    if (ret != ESP_OK)
     {
-        accumulator += toFloat(tmp);
-        count++;
+        return ret;
     }
 
-    // simple variable MVA
-    float averageOD = accumulator / (float)count;
+    gpio_set_direction(OD_PIN_LED, GPIO_MODE_OUTPUT);
+    gpio_set_level(OD_PIN_LED, 0);
 
-    // post downsapled sensor reading
-    measurement_t measurement = {
-        .timestamp = time,
-        .type = "OD",
-        .value = averageOD};
-    if (xQueueSend(xMeasurementQueue, &measurement, pdTICKS_TO_MS(500)) != pdPASS)
+    adc_oneshot_unit_init_cfg_t unit_config = {
+        .unit_id = OD_ADC_UNIT,
+    };
+    ret = adc_oneshot_new_unit(&unit_config, &adc_handle);
+    if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Cannot insert message into queue");
+        ESP_LOGE(TAG, "Failed to set up ADC");
+        return ret;
     }
 
+    adc_oneshot_chan_cfg_t channel_cfg = {
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+    ret = adc_oneshot_config_channel(adc_handle, OD_ADC_CHANNEL, &channel_cfg);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set up ADC channel");
+        return ret;
+    }
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    ret = gptimer_new_timer(&timer_config, &timer);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set up sample timer");
+        return ret;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = od_on_sample,
+    };
+    ret = gptimer_register_event_callbacks(timer, &callbacks, NULL);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = 1000000 / OD_SAMPLE_FREQUENCY,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    return gptimer_set_alarm_action(timer, &alarm_config);
+}
+
+esp_err_t od_start()
+{
+    // runs every task cycle, evaluates a finished window without ever waiting for one
+    if (state == OD_ACQUIRING && acquired)
+    {
+        od_finish_acquisition();
+    }
+    else if (state == OD_IDLE && requested)
+    {
+        od_try_acquisition();
+    }
+    return ESP_OK;
+}
+
+esp_err_t od_update()
+{
+    if (requested || state != OD_IDLE)
+    {
+        ESP_LOGW(TAG, "Previous acquisition still pending");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    requested = true;
+    deferred = false;
+    request_time = esp_timer_get_time();
+
+    od_try_acquisition();
+    return ESP_OK;
+}
+
+esp_err_t od_publish()
+{
+    channel_publish(&channel);
+
+    ESP_LOGI(TAG, "Scheduling: %lu acquisitions, latency avg %lu us max %lu us, %lu deferred, %lu aborted, %lu invalid",
+             schedule_stats.decisions,
+             (schedule_stats.decisions > 0) ? (uint32_t)(schedule_stats.latency_sum_us / schedule_stats.decisions) : 0,
+             schedule_stats.latency_max_us, schedule_stats.deferred, schedule_stats.aborted,
+             schedule_stats.invalid);
+    memset(&schedule_stats, 0, sizeof(schedule_stats));
+
     return ESP_OK;
 }
 
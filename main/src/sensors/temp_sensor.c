@@ -5,28 +5,70 @@
 #include "esp_err.h"
 #include "esp_log.h"
 
-#include "timer.h"
-#include "measurement.h"
-#include "ringbuffer.h"
+#include "channel.h"
+#include "metrics.h"
 #include "sensors/temp_sensor.h"
-#include "i2c_user.h"
+#include "tasks/tec.h"
 
 #include "sht3x.h"
 
 static const char *TAG = "TEMP";
 
-extern QueueHandle_t xMeasurementQueue;
-static ringbuffer_t buffer;
+// must match the period of the tec control loop
+#define TEMP_PERIODIC_MODE PERIODIC_TEN_MPS_HIGH_RELIABILITY
+
+static const channel_config_t channel_config = {
+    .type = "Temperature",
+    .outlier_window = 15,
+    .outlier_threshold = 3.0f,
+    .outlier_min_deviation = 0.2f,
+    .decimation_order = 2,
+    .decimation_ratio = 20,
+    .deadband_absolute = 0.05f,
+    .heartbeat_interval = 5ULL * 60ULL * 1000ULL,
+    .raw_series = true,
+};
+static const channel_config_t humidity_config = {
+    .type = "Humidity",
+    .outlier_window = 15,
+    .outlier_threshold = 3.0f,
+    .outlier_min_deviation = 1.0f,
+    .decimation_order = 2,
+    .decimation_ratio = 20,
+    .deadband_absolute = 0.5f,
+    .heartbeat_interval = 5ULL * 60ULL * 1000ULL,
+};
+static channel_t channel;
+static channel_t humidity_channel;
+
+// both come from the same reading and are uploaded as one record
+static channel_t *const channels[] = {&channel, &humidity_channel};
 
 static sht3x_device_t sht3x_dev;
 
+static metric_t *crc_errors_metric;
+static uint32_t reported_crc_errors = 0;
+
 esp_err_t temp_init()
 {
-    // TODO: init temp sensor and tec driver
-    sht3x_init(&sht3x_dev, address_A, I2C_USER_PORT);
+    channel_init(&channel, &channel_config);
+    channel_init(&humidity_channel, &humidity_config);
+    crc_errors_metric = metrics_counter("sht3x_crc_errors");
 
+    esp_err_t ret = sht3x_init(&sht3x_dev, address_A);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
 
-    return ESP_OK;
+    // let the sensor free-run so the control loop only fetches the latest result
+    ret = sht3x_start_periodic(&sht3x_dev, TEMP_PERIODIC_MODE);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return tec_init(&sht3x_dev);
 }
 
 esp_err_t temp_start()
@@ -34,51 +76,38 @@ esp_err_t temp_start()
     return ESP_OK;
 }
 
-static uint32_t tmp_counter = 0;
 esp_err_t temp_update()
 {
-    // take temp sensor reading
-    sht3x_start_measurement(&sht3x_dev, SINGLE_SHOT_CLOCK_STRETCHING_ENABLED_HIGH_RELIABILITY);
-
-    sht3x_measurement_t measurement;
-    sht3x_read_measurement(&sht3x_dev, &measurement);
-
-    // float temp = sinf(tmp_counter++ / 250.0) * 20.0 + 10.0; // FIXME
-    float temp = measurement.temperature_degC;
-
-    buffer_write(&buffer, toFixed(temp));
-    ESP_LOGD(TAG, "Temp: %f", temp);
+    // readings are taken by the tec control loop
+    tec_sample_t sample;
+    while (tec_receive_sample(&sample))
+    {
+        channel_update(&channel, sample.temperature);
+        channel_update(&humidity_channel, sample.humidity);
+        ESP_LOGD(TAG, "Temp: %f, RH: %f, TEC: %f", sample.temperature, sample.humidity, sample.output);
+    }
 
-    // perform tec control loop
     return ESP_OK;
 }
 
 esp_err_t temp_publish()
 {
-    uint32_t time = 0;
-    get_current_time(&time);
-
-    // decimation filter
-    uint16_t count = 0;
-    float accumulator = 0.0f;
-    int32_t tmp = 0;
-    while (buffer_read(&buffer, &tmp) == ESP_OK)
+    channel_publish_group(channels, sizeof(channels) / sizeof(channels[0]));
+
+    // surface sensor alerts and recover from resets once per window
+    sht3x_status_t status;
+    if (sht3x_check_status(&sht3x_dev, &status) != ESP_OK)
     {
-        accumulator += toFloat(tmp);
-        count++;
+        ESP_LOGW(TAG, "Status check failed");
     }
 
-    // simple variable MVA
-    float averageTemp = accumulator / (float)count;
-
-    // post downsapled sensor reading
-    measurement_t measurement = {
-        .timestamp = time,
-        .type = "Temperature",
-        .value = averageTemp};
-    if (xQueueSend(xMeasurementQueue, &measurement, pdTICKS_TO_MS(500)) != pdPASS)
+    // readings that failed the crc never reach the channels, so report them here
+    uint32_t crc_errors = sht3x_dev.crc_errors;
+    if (crc_errors != reported_crc_errors)
     {
-        ESP_LOGE(TAG, "Cannot insert message into queue");
+        ESP_LOGW(TAG, "%lu CRC errors since last publish", crc_errors - reported_crc_errors);
+        metrics_add(crc_errors_metric, crc_errors - reported_crc_errors);
+        reported_crc_errors = crc_errors;
     }
 
     return ESP_OK;
@@ -0,0 +1,249 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "series.h"
+
+// worst case encoding of one sample: '1111' + 32 bit delta-of-delta, '11' + 5 + 5 + 32 bit value
+#define SERIES_MAX_SAMPLE_BITS (4 + 32 + 2 + 5 + 5 + 32)
+#define SERIES_NO_WINDOW 0xff
+
+static inline uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void write_bits(series_block_t *block, uint32_t value, uint8_t bits)
+{
+    while (bits > 0)
+    {
+        bits--;
+        if ((value >> bits) & 1)
+        {
+            block->data[block->bit_length / 8] |= 0x80 >> (block->bit_length % 8);
+        }
+        block->bit_length++;
+    }
+}
+
+static uint32_t read_bits(series_decoder_t *decoder, uint8_t bits)
+{
+    uint32_t value = 0;
+    while (bits > 0)
+    {
+        bits--;
+        value <<= 1;
+        if (decoder->bit_pos < decoder->length * 8)
+        {
+            value |= (decoder->data[decoder->bit_pos / 8] >> (7 - decoder->bit_pos % 8)) & 1;
+        }
+        decoder->bit_pos++;
+    }
+    return value;
+}
+
+void series_block_reset(series_block_t *block, const char *type)
+{
+    block->type = type;
+    block->count = 0;
+    block->bit_length = 0;
+    block->first_timestamp = 0;
+    block->prev_timestamp = 0;
+    block->prev_delta = 0;
+    block->prev_value = 0;
+    block->prev_leading = SERIES_NO_WINDOW;
+    block->prev_trailing = 0;
+    memset(block->data, 0, sizeof(block->data));
+}
+
+static void encode_timestamp(series_block_t *block, uint32_t timestamp)
+{
+    int32_t delta = (int32_t)(timestamp - block->prev_timestamp);
+    int32_t dod = (int32_t)((uint32_t)delta - (uint32_t)block->prev_delta);
+
+    if (dod == 0)
+    {
+        write_bits(block, 0x0, 1);
+    }
+    else if (dod >= -63 && dod <= 64)
+    {
+        write_bits(block, 0x2, 2);
+        write_bits(block, dod + 63, 7);
+    }
+    else if (dod >= -255 && dod <= 256)
+    {
+        write_bits(block, 0x6, 3);
+        write_bits(block, dod + 255, 9);
+    }
+    else if (dod >= -2047 && dod <= 2048)
+    {
+        write_bits(block, 0xe, 4);
+        write_bits(block, dod + 2047, 12);
+    }
+    else
+    {
+        write_bits(block, 0xf, 4);
+        write_bits(block, (uint32_t)dod, 32);
+    }
+
+    block->prev_timestamp = timestamp;
+    block->prev_delta = delta;
+}
+
+static void encode_value(series_block_t *block, uint32_t value)
+{
+    uint32_t xor = value ^ block->prev_value;
+    block->prev_value = value;
+
+    if (xor == 0)
+    {
+        write_bits(block, 0x0, 1);
+        return;
+    }
+
+    uint8_t leading = __builtin_clz(xor);
+    uint8_t trailing = __builtin_ctz(xor);
+    if (leading > 31)
+    {
+        leading = 31;
+    }
+
+    if (block->prev_leading != SERIES_NO_WINDOW && leading >= block->prev_leading && trailing >= block->prev_trailing)
+    {
+        // meaningful bits fit into the previous window
+        uint8_t meaningful = 32 - block->prev_leading - block->prev_trailing;
+        write_bits(block, 0x2, 2);
+        write_bits(block, xor >> block->prev_trailing, meaningful);
+    }
+    else
+    {
+        uint8_t meaningful = 32 - leading - trailing;
+        write_bits(block, 0x3, 2);
+        write_bits(block, leading, 5);
+        write_bits(block, meaningful - 1, 5);
+        write_bits(block, xor >> trailing, meaningful);
+
+        block->prev_leading = leading;
+        block->prev_trailing = trailing;
+    }
+}
+
+bool series_block_append(series_block_t *block, uint32_t timestamp, float value)
+{
+    if (block->bit_length + SERIES_MAX_SAMPLE_BITS > SERIES_BLOCK_BYTES * 8 || block->count == UINT16_MAX)
+    {
+        return false;
+    }
+
+    if (block->count == 0)
+    {
+        block->first_timestamp = timestamp;
+        block->prev_timestamp = timestamp;
+        block->prev_value = float_bits(value);
+        write_bits(block, timestamp, 32);
+        write_bits(block, block->prev_value, 32);
+    }
+    else
+    {
+        encode_timestamp(block, timestamp);
+        encode_value(block, float_bits(value));
+    }
+
+    block->count++;
+    return true;
+}
+
+size_t series_block_size(const series_block_t *block)
+{
+    return (block->bit_length + 7) / 8;
+}
+
+void series_decoder_init(series_decoder_t *decoder, const uint8_t *data, size_t length, uint16_t count)
+{
+    decoder->data = data;
+    decoder->length = length;
+    decoder->bit_pos = 0;
+    decoder->count = count;
+    decoder->index = 0;
+    decoder->prev_timestamp = 0;
+    decoder->prev_delta = 0;
+    decoder->prev_value = 0;
+    decoder->prev_leading = 0;
+    decoder->prev_trailing = 0;
+}
+
+bool series_decoder_next(series_decoder_t *decoder, uint32_t *timestamp, float *value)
+{
+    if (decoder->index >= decoder->count)
+    {
+        return false;
+    }
+
+    if (decoder->index == 0)
+    {
+        decoder->prev_timestamp = read_bits(decoder, 32);
+        decoder->prev_value = read_bits(decoder, 32);
+    }
+    else
+    {
+        // delta-of-delta bucket
+        int32_t dod;
+        if (read_bits(decoder, 1) == 0)
+        {
+            dod = 0;
+        }
+        else if (read_bits(decoder, 1) == 0)
+        {
+            dod = (int32_t)read_bits(decoder, 7) - 63;
+        }
+        else if (read_bits(decoder, 1) == 0)
+        {
+            dod = (int32_t)read_bits(decoder, 9) - 255;
+        }
+        else if (read_bits(decoder, 1) == 0)
+        {
+            dod = (int32_t)read_bits(decoder, 12) - 2047;
+        }
+        else
+        {
+            dod = (int32_t)read_bits(decoder, 32);
+        }
+
+        decoder->prev_delta = (int32_t)((uint32_t)decoder->prev_delta + (uint32_t)dod);
+        decoder->prev_timestamp += (uint32_t)decoder->prev_delta;
+
+        // XOR value
+        if (read_bits(decoder, 1) == 1)
+        {
+            if (read_bits(decoder, 1) == 1)
+            {
+                decoder->prev_leading = read_bits(decoder, 5);
+                uint8_t meaningful = read_bits(decoder, 5) + 1;
+                decoder->prev_trailing = 32 - decoder->prev_leading - meaningful;
+            }
+            uint8_t meaningful = 32 - decoder->prev_leading - decoder->prev_trailing;
+            decoder->prev_value ^= read_bits(decoder, meaningful) << decoder->prev_trailing;
+        }
+    }
+
+    if (decoder->bit_pos > decoder->length * 8)
+    {
+        // truncated block
+        decoder->index = decoder->count;
+        return false;
+    }
+
+    decoder->index++;
+    *timestamp = decoder->prev_timestamp;
+    *value = bits_float(decoder->prev_value);
+    return true;
+}
@@ -1,142 +1,271 @@
 #include "sdkconfig.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_pm.h"
+#include "esp_heap_caps.h"
+#include <cJSON.h>
 
-#define STATS_DURATION pdMS_TO_TICKS(2000)
-#define STATS_BLINDTIME pdMS_TO_TICKS(20000)
-#define ARRAY_SIZE_OFFSET 5 // Increase this if print_real_time_stats returns ESP_ERR_INVALID_SIZE
+#include "client.h"
+#include "endpoints.h"
+#include "timer.h"
+#include "metrics.h"
+#include "i2c_user.h"
+#include "tasks/tec.h"
+
+#define STATS_INTERVAL pdMS_TO_TICKS(60000)
+// snapshots are static, increase this if the task table reports too many tasks
+#define STATS_MAX_TASKS 32
+#define PM_DUMP_LENGTH 1024
+#define TMP_BUFFER_LENGTH 32
 
 static const char *TAG = "STATS";
 
-static esp_err_t print_real_time_stats(TickType_t xTicksToWait)
+// two snapshots sorted by task number, cpu time is the difference of consecutive ones
+static TaskStatus_t snapshots[2][STATS_MAX_TASKS];
+static UBaseType_t snapshot_sizes[2];
+static configRUN_TIME_COUNTER_TYPE snapshot_times[2];
+static uint8_t current = 0;
+
+static char pm_dump[PM_DUMP_LENGTH];
+
+// system state sampled on every export, next to whatever the rest of the firmware registered
+// event counts are counters, a float gauge would stop counting exactly past 2^24
+static struct
+{
+    metric_t *heap_free;
+    metric_t *heap_min_free;
+    metric_t *heap_largest_block;
+    metric_t *psram_free;
+    metric_t *i2c_transactions;
+    metric_t *i2c_errors;
+    metric_t *i2c_dropped;
+    metric_t *i2c_utilization;
+    metric_t *i2c_latency_max_us;
+    metric_t *tec_overruns;
+    metric_t *tec_sensor_misses;
+    metric_t *tec_jitter_max_us;
+    metric_t *tec_compute_max_us;
+} sampled;
+
+static int compare_task_number(const void *a, const void *b)
+{
+    UBaseType_t x = ((const TaskStatus_t *)a)->xTaskNumber;
+    UBaseType_t y = ((const TaskStatus_t *)b)->xTaskNumber;
+    return (x > y) - (x < y);
+}
+
+static esp_err_t take_snapshot()
 {
-    TaskStatus_t *start_array = NULL, *end_array = NULL;
-    UBaseType_t start_array_size, end_array_size;
-    configRUN_TIME_COUNTER_TYPE start_run_time, end_run_time;
-    esp_err_t ret;
-
-    // Allocate array to store current task states
-    start_array_size = uxTaskGetNumberOfTasks() + ARRAY_SIZE_OFFSET;
-    start_array = malloc(sizeof(TaskStatus_t) * start_array_size);
-    if (start_array == NULL)
+    current ^= 1;
+    snapshot_sizes[current] = uxTaskGetSystemState(snapshots[current], STATS_MAX_TASKS, &snapshot_times[current]);
+    if (snapshot_sizes[current] == 0)
     {
-        ret = ESP_ERR_NO_MEM;
-        goto exit;
+        ESP_LOGE(TAG, "More than %d tasks", STATS_MAX_TASKS);
+        return ESP_ERR_INVALID_SIZE;
     }
-    // Get current task states
-    start_array_size = uxTaskGetSystemState(start_array, start_array_size, &start_run_time);
-    if (start_array_size == 0)
+
+    // task numbers are unique and never reused, sorted snapshots match in a single pass
+    qsort(snapshots[current], snapshot_sizes[current], sizeof(TaskStatus_t), compare_task_number);
+    return ESP_OK;
+}
+
+static void update_sampled()
+{
+    metrics_set(sampled.heap_free, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    metrics_set(sampled.heap_min_free, heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    metrics_set(sampled.heap_largest_block, heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    metrics_set(sampled.psram_free, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+
+    i2c_user_stats_t i2c_stats;
+    i2c_user_get_stats(&i2c_stats);
+    // the bus and tec stats cover the time since the previous call, the counters add them up
+    metrics_add(sampled.i2c_transactions, i2c_stats.transactions);
+    metrics_add(sampled.i2c_errors, i2c_stats.errors);
+    metrics_add(sampled.i2c_dropped, i2c_stats.dropped);
+    metrics_set(sampled.i2c_utilization, i2c_stats.utilization);
+    metrics_set(sampled.i2c_latency_max_us, i2c_stats.latency_max_us);
+
+    tec_stats_t tec_stats;
+    tec_get_stats(&tec_stats);
+    metrics_add(sampled.tec_overruns, tec_stats.overruns);
+    metrics_add(sampled.tec_sensor_misses, tec_stats.sensor_misses);
+    metrics_set(sampled.tec_jitter_max_us, tec_stats.jitter_max_us);
+    metrics_set(sampled.tec_compute_max_us, tec_stats.compute_max_us);
+}
+
+// cpu share since the previous snapshot and the stack high water mark of every task
+static cJSON *serialize_tasks()
+{
+    cJSON *tasks = cJSON_CreateArray();
+    if (tasks == NULL)
     {
-        ret = ESP_ERR_INVALID_SIZE;
-        goto exit;
+        return NULL;
+    }
+
+    const TaskStatus_t *now = snapshots[current];
+    const TaskStatus_t *before = snapshots[current ^ 1];
+    UBaseType_t before_size = snapshot_sizes[current ^ 1];
+    uint32_t total_elapsed_time = snapshot_times[current] - snapshot_times[current ^ 1];
+
+    UBaseType_t j = 0;
+    for (UBaseType_t i = 0; i < snapshot_sizes[current]; i++)
+    {
+        // tasks only in the previous snapshot were deleted since
+        while (j < before_size && before[j].xTaskNumber < now[i].xTaskNumber)
+        {
+            j++;
+        }
+
+        // a task created since has no baseline yet
+        float percentage = -1.0f;
+        if (j < before_size && before[j].xTaskNumber == now[i].xTaskNumber && total_elapsed_time > 0)
+        {
+            uint32_t task_elapsed_time = now[i].ulRunTimeCounter - before[j].ulRunTimeCounter;
+            percentage = (float)task_elapsed_time * 100.0f / ((float)total_elapsed_time * CONFIG_FREERTOS_NUMBER_OF_CORES);
+        }
+
+        cJSON *task = cJSON_CreateObject();
+        if (task == NULL ||
+            cJSON_AddStringToObject(task, "name", now[i].pcTaskName) == NULL ||
+            cJSON_AddNumberToObject(task, "cpu", percentage) == NULL ||
+            cJSON_AddNumberToObject(task, "stack_free", now[i].usStackHighWaterMark) == NULL)
+        {
+            cJSON_Delete(task);
+            cJSON_Delete(tasks);
+            return NULL;
+        }
+        cJSON_AddItemToArray(tasks, task);
     }
 
-    vTaskDelay(xTicksToWait);
+    return tasks;
+}
+
+static cJSON *serialize_metrics()
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON *tasks = serialize_tasks();
+    cJSON *metrics = metrics_to_json();
+    uint32_t timestamp = 0;
+    get_current_time(&timestamp);
 
-    // Allocate array to store tasks states post delay
-    end_array_size = uxTaskGetNumberOfTasks() + ARRAY_SIZE_OFFSET;
-    end_array = malloc(sizeof(TaskStatus_t) * end_array_size);
-    if (end_array == NULL)
+    if (json == NULL || tasks == NULL || metrics == NULL ||
+        cJSON_AddNumberToObject(json, "timestamp", timestamp) == NULL)
     {
-        ret = ESP_ERR_NO_MEM;
-        goto exit;
+        cJSON_Delete(metrics);
+        cJSON_Delete(tasks);
+        cJSON_Delete(json);
+        return NULL;
     }
-    // Get post delay task states
-    end_array_size = uxTaskGetSystemState(end_array, end_array_size, &end_run_time);
-    if (end_array_size == 0)
+    cJSON_AddItemToObject(json, "tasks", tasks);
+    cJSON_AddItemToObject(json, "metrics", metrics);
+
+    // the pm driver only offers a text dump, it goes out as is
+    FILE *dump = fmemopen(pm_dump, sizeof(pm_dump), "w");
+    if (dump != NULL)
     {
-        ret = ESP_ERR_INVALID_SIZE;
-        goto exit;
+        esp_pm_dump_locks(dump);
+        fclose(dump);
+        pm_dump[sizeof(pm_dump) - 1] = '\0';
+        cJSON_AddStringToObject(json, "pm_locks", pm_dump);
     }
 
-    // Calculate total_elapsed_time in units of run time stats clock period.
-    uint32_t total_elapsed_time = (end_run_time - start_run_time);
-    if (total_elapsed_time == 0)
+    return json;
+}
+
+static esp_err_t post_metrics(const char *json_string)
+{
+    char tmp_buf[TMP_BUFFER_LENGTH];
+
+    // the client comes up after this task, nothing is sent before
+    esp_http_client_config_t *config = get_config();
+    if (config == NULL)
     {
-        ret = ESP_ERR_INVALID_STATE;
-        goto exit;
+        return ESP_ERR_INVALID_STATE;
     }
-    printf("\nTask            Run Time Percentage\n");
-    // Match each task in start_array to those in the end_array
-    for (int i = 0; i < start_array_size; i++)
+    config->url = API_V1_POST_METRICS;
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    esp_http_client_set_method(client, HTTP_METHOD_POST);
+
+    sprintf(tmp_buf, "%d", 1); // FIXME
+    esp_http_client_set_header(client, "Device-Id", tmp_buf);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_post_field(client, json_string, strlen(json_string));
+
+    esp_err_t ret = esp_http_client_perform(client);
+    if (ret == ESP_OK)
     {
-        int k = -1;
-        for (int j = 0; j < end_array_size; j++)
-        {
-            if (start_array[i].xHandle == end_array[j].xHandle)
-            {
-                k = j;
-                // Mark that task have been matched by overwriting their handles
-                start_array[i].xHandle = NULL;
-                end_array[j].xHandle = NULL;
-                break;
-            }
-        }
-        // Check if matching task found
-        if (k >= 0)
-        {
-            uint32_t task_elapsed_time = end_array[k].ulRunTimeCounter - start_array[i].ulRunTimeCounter;
-            uint32_t percentage_time = (task_elapsed_time * 100UL) / (total_elapsed_time * CONFIG_FREERTOS_NUMBER_OF_CORES);
-            printf("%-15s %-8lu %02lu%% [", start_array[i].pcTaskName, task_elapsed_time, percentage_time);
-
-            const uint8_t bar_length = 50;
-            for(uint8_t i = 0; i < bar_length; i++) {
-                float percentage = ((i+1.0f) / (float)bar_length) * 100.0f;
-
-                if(percentage_time >= percentage)   {
-                    printf("*");
-                }   else    {
-                    printf(" ");
-                }
-            }
-            printf("]\n");
-        }
+        ESP_LOGI(TAG, "HTTP POST Status = %d, %zu bytes of metrics",
+                 esp_http_client_get_status_code(client), strlen(json_string));
     }
+    else
+    {
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(ret));
+    }
+
+    esp_http_client_cleanup(client);
+    release_config();
+    return ret;
+}
 
-    // Print unmatched tasks
-    for (int i = 0; i < start_array_size; i++)
+static esp_err_t export_metrics()
+{
+    if (take_snapshot() != ESP_OK)
     {
-        if (start_array[i].xHandle != NULL)
-        {
-            printf("| %-15s | Deleted\n", start_array[i].pcTaskName);
-        }
+        return ESP_ERR_INVALID_SIZE;
     }
-    for (int i = 0; i < end_array_size; i++)
+    update_sampled();
+
+    cJSON *json = serialize_metrics();
+    if (json == NULL)
     {
-        if (end_array[i].xHandle != NULL)
-        {
-            printf("| %-15s | Created\n", end_array[i].pcTaskName);
-        }
+        return ESP_ERR_NO_MEM;
     }
-    printf("\n");
-    ESP_ERROR_CHECK(esp_pm_dump_locks(stdout));
-    printf("\n");
 
-    ret = ESP_OK;
+    char *json_string = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    if (json_string == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
 
-exit: // Common return path
-    free(start_array);
-    free(end_array);
+    esp_err_t ret = post_metrics(json_string);
+    free(json_string);
     return ret;
 }
 
 void stats_task(void *arg)
 {
-    // Print real time stats periodically
+    sampled.heap_free = metrics_gauge("heap_free");
+    sampled.heap_min_free = metrics_gauge("heap_min_free");
+    sampled.heap_largest_block = metrics_gauge("heap_largest_block");
+    sampled.psram_free = metrics_gauge("psram_free");
+    sampled.i2c_transactions = metrics_counter("i2c_transactions");
+    sampled.i2c_errors = metrics_counter("i2c_errors");
+    sampled.i2c_dropped = metrics_counter("i2c_dropped");
+    sampled.i2c_utilization = metrics_gauge("i2c_utilization");
+    sampled.i2c_latency_max_us = metrics_gauge("i2c_latency_max_us");
+    sampled.tec_overruns = metrics_counter("tec_overruns");
+    sampled.tec_sensor_misses = metrics_counter("tec_sensor_misses");
+    sampled.tec_jitter_max_us = metrics_gauge("tec_jitter_max_us");
+    sampled.tec_compute_max_us = metrics_gauge("tec_compute_max_us");
+
+    // the first snapshot is only the baseline for the cpu shares
+    take_snapshot();
+
+    // export periodically, the cpu shares cover the whole interval
     while (1)
     {
-        ESP_LOGI(TAG, "\n\nGetting realtime stats over %" PRIu32 " ticks\n", STATS_DURATION);
-        if (print_real_time_stats(STATS_DURATION) != ESP_OK)
+        vTaskDelay(STATS_INTERVAL);
+        esp_err_t ret = export_metrics();
+        if (ret != ESP_OK)
         {
-            ESP_LOGE(TAG, "Error getting real time stats\n");
+            ESP_LOGE(TAG, "Error exporting metrics: %s", esp_err_to_name(ret));
         }
-        vTaskDelay(STATS_BLINDTIME);
     }
 }
@@ -5,10 +5,13 @@
 #include "esp_log.h"
 #include "esp_system.h"
 #include <cJSON.h>
+#include <string.h>
 
 #include "interval_task.h"
 #include "client.h"
 #include "task_manager.h"
+#include "sensors/camera.h"
+#include "tasks/tec.h"
 
 #include "endpoints.h"
 
@@ -23,6 +26,61 @@ static uint8_t fail_count = 0;
 
 char local_response_buffer[MAX_HTTP_OUTPUT_BUFFER + 1] = {0};
 
+// actions are one-shot requests, either a plain name or an object with an "action" name
+static void handleAction(cJSON *action)
+{
+    const char *name = NULL;
+    if (cJSON_IsString(action))
+    {
+        name = action->valuestring;
+    }
+    else
+    {
+        cJSON *action_name = cJSON_GetObjectItem(action, "action");
+        if (cJSON_IsString(action_name))
+        {
+            name = action_name->valuestring;
+        }
+    }
+
+    if (!name)
+    {
+        ESP_LOGW(TAG, "Action without name");
+        return;
+    }
+
+    if (strcmp(name, "capture_full_frame") == 0)
+    {
+        camera_request_full_frame();
+    }
+    else if (strcmp(name, "capture_burst") == 0)
+    {
+        camera_request_burst();
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Unknown action %s", name);
+    }
+}
+
+// controller settings, the tec stays off until a setpoint and all three gains were received
+static void handleSettings(cJSON *settings)
+{
+    cJSON *setpoint = cJSON_GetObjectItem(settings, "tec_setpoint");
+    if (cJSON_IsNumber(setpoint))
+    {
+        tec_set_setpoint((float)setpoint->valuedouble);
+    }
+
+    cJSON *kp = cJSON_GetObjectItem(settings, "tec_kp");
+    cJSON *ki = cJSON_GetObjectItem(settings, "tec_ki");
+    cJSON *kd = cJSON_GetObjectItem(settings, "tec_kd");
+    if (cJSON_IsNumber(kp) && cJSON_IsNumber(ki) && cJSON_IsNumber(kd))
+    {
+        tec_set_gains((float)kp->valuedouble, (float)ki->valuedouble, (float)kd->valuedouble);
+    }
+}
+
 static esp_err_t parseState()
 {
     esp_err_t ret_val = ESP_FAIL;
@@ -88,12 +146,19 @@ static esp_err_t parseState()
     if (settings)
     {
         printf("Settings: %s\n", cJSON_Print(settings));
+        handleSettings(settings);
     }
 
     cJSON *actions = cJSON_GetObjectItem(root, "actions");
     if (actions)
     {
         printf("Actions: %s\n", cJSON_Print(actions));
+
+        cJSON *action;
+        cJSON_ArrayForEach(action, actions)
+        {
+            handleAction(action);
+        }
     }
     ret_val = ESP_OK;
 
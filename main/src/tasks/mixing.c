@@ -1,9 +1,143 @@
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
 #include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 
 #include "tasks/mixing.h"
 
+#include "cat9555.h"
+
+static const char *TAG = "Mixing";
+
+#define MIXING_PIN_PUMP CAT_PIN_MASK(CAT_PORT_0, CAT_PIN_1)
+#define MIXING_PIN_AERATOR CAT_PIN_MASK(CAT_PORT_0, CAT_PIN_2)
+
+#define MIXING_ACTIVE_MS CONFIG_MIXING_ACTIVE_MS
+#define MIXING_SETTLING_MS CONFIG_MIXING_SETTLING_MS
+#define MIXING_QUIET_MS CONFIG_MIXING_QUIET_MS
+// the phase timer runs in the shared esp_timer task, a pin write that would block is retried after this
+#define MIXING_RETRY_MS 10
+
+extern cat_state_t cat_device;
+
+static EventGroupHandle_t events = NULL;
+static esp_timer_handle_t phase_timer = NULL;
+
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct
+{
+    bool running;
+    mixing_phase_t phase;
+    int64_t since;
+    int64_t until;
+    uint32_t cycle;
+} state = {
+    .phase = MIXING_QUIET,
+};
+
+static void mixing_enter(mixing_phase_t phase)
+{
+    uint32_t duration_ms = 0;
+    esp_err_t ret = ESP_OK;
+
+    switch (phase)
+    {
+    case MIXING_ACTIVE:
+        // nobody may start a quiet measurement once the pumps are about to run
+        xEventGroupClearBits(events, MIXING_QUIET_BIT);
+        ret = tryWritePins(&cat_device, MIXING_PIN_PUMP | MIXING_PIN_AERATOR, MIXING_PIN_PUMP | MIXING_PIN_AERATOR);
+        duration_ms = MIXING_ACTIVE_MS;
+        break;
+    case MIXING_SETTLING:
+        ret = tryWritePins(&cat_device, MIXING_PIN_PUMP | MIXING_PIN_AERATOR, 0);
+        duration_ms = MIXING_SETTLING_MS;
+        break;
+    case MIXING_QUIET:
+        duration_ms = MIXING_QUIET_MS;
+        break;
+    }
+
+    if (ret != ESP_OK)
+    {
+        // stay in the current phase, the next tick tries the same transition again
+        ESP_LOGD(TAG, "Phase %d deferred: %s", phase, esp_err_to_name(ret));
+        esp_timer_start_once(phase_timer, MIXING_RETRY_MS * 1000ULL);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&state_lock);
+    state.phase = phase;
+    state.since = now;
+    state.until = now + duration_ms * 1000LL;
+    if (phase == MIXING_ACTIVE)
+    {
+        state.cycle++;
+    }
+    taskEXIT_CRITICAL(&state_lock);
+
+    if (phase == MIXING_QUIET)
+    {
+        xEventGroupSetBits(events, MIXING_QUIET_BIT);
+    }
+
+    ESP_LOGD(TAG, "Phase %d for %lu ms", phase, duration_ms);
+    esp_timer_start_once(phase_timer, duration_ms * 1000ULL);
+}
+
+static void mixing_on_timer(void *arg)
+{
+    switch (state.phase)
+    {
+    case MIXING_ACTIVE:
+        mixing_enter(MIXING_SETTLING);
+        break;
+    case MIXING_SETTLING:
+        mixing_enter(MIXING_QUIET);
+        break;
+    case MIXING_QUIET:
+        mixing_enter(MIXING_ACTIVE);
+        break;
+    }
+}
+
 esp_err_t mixing_init()
 {
+    events = xEventGroupCreate();
+    if (events == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // phase changes happen on time, not on the task cadence
+    const esp_timer_create_args_t timer_args = {
+        .callback = mixing_on_timer,
+        .name = "mixing",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &phase_timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    setDirections(&cat_device, MIXING_PIN_PUMP | MIXING_PIN_AERATOR, CAT_DIR_output);
+    ret = clearPins(&cat_device, MIXING_PIN_PUMP | MIXING_PIN_AERATOR);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set up pump and aerator");
+        return ret;
+    }
+
+    taskENTER_CRITICAL(&state_lock);
+    state.running = true;
+    taskEXIT_CRITICAL(&state_lock);
+
+    mixing_enter(MIXING_ACTIVE);
     return ESP_OK;
 }
 
@@ -26,3 +160,37 @@ esp_err_t mixing_end()
 {
     return ESP_OK;
 }
+
+EventGroupHandle_t mixing_get_events()
+{
+    return events;
+}
+
+mixing_phase_t mixing_get_phase()
+{
+    return state.phase;
+}
+
+bool mixing_get_quiet_window(int64_t *since_us, int64_t *until_us, uint32_t *cycle)
+{
+    bool quiet;
+
+    taskENTER_CRITICAL(&state_lock);
+    if (!state.running)
+    {
+        *since_us = 0;
+        *until_us = INT64_MAX;
+        *cycle = 0;
+        quiet = true;
+    }
+    else
+    {
+        *since_us = state.since;
+        *until_us = state.until;
+        *cycle = state.cycle;
+        quiet = state.phase == MIXING_QUIET;
+    }
+    taskEXIT_CRITICAL(&state_lock);
+
+    return quiet;
+}
@@ -0,0 +1,365 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gptimer.h"
+#include "driver/ledc.h"
+
+#include "pid.h"
+#include "tasks/tec.h"
+
+#include "cat9555.h"
+
+static const char *TAG = "TEC";
+
+// h-bridge: pwm sets the power, the expander pin the direction
+// the camera, the od sensor, the i2c bus, the expander interrupt (13) and the psram (16, 17) take
+// every other pin, gpio 12 (MTDI) would select the flash voltage if the bridge pulled it high
+// U0RXD is free since nothing reads the console, the rom pulls it up during reset
+// so the bridge input needs a pull down strong enough to keep the tec off until the channel is set up
+#define TEC_PWM_GPIO 3
+#define TEC_PWM_TIMER LEDC_TIMER_2
+#define TEC_PWM_CHANNEL LEDC_CHANNEL_2
+#define TEC_PWM_FREQUENCY 20000
+#define TEC_PWM_RESOLUTION LEDC_TIMER_10_BIT
+#define TEC_PWM_MAX_DUTY ((1 << TEC_PWM_RESOLUTION) - 1)
+#define TEC_DIRECTION_PIN CAT_PIN_MASK(CAT_PORT_0, CAT_PIN_0)
+
+// outputs this small are treated as off, so the direction does not chatter around 0
+#define TEC_OUTPUT_DEADBAND 0.02f
+// without a reading for this long the tec is switched off
+#define TEC_SENSOR_TIMEOUT_US ((int64_t)(10ULL * TEC_PERIOD_US))
+
+#define TEC_SAMPLE_QUEUE_LENGTH 16
+
+extern cat_state_t cat_device;
+
+// gains come from the server, the output stays off until they and a setpoint were received
+static pid_config_t pid_config = {
+    .output_min = -1.0f,
+    .output_max = 1.0f,
+    .slew_rate = 0.5f,
+};
+static bool gains_valid = false;
+static bool gains_changed = false;
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static pid_controller_t pid;
+
+static sht3x_device_t *sensor = NULL;
+static TaskHandle_t tec_task_handle = NULL;
+static gptimer_handle_t timer = NULL;
+static QueueHandle_t sample_queue = NULL;
+
+static volatile float setpoint = NAN;
+static bool cooling = false;
+static bool direction_pending = false;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct
+{
+    uint64_t jitter_sum_us;
+    uint64_t compute_sum_us;
+    uint32_t jitter_max_us;
+    uint32_t compute_max_us;
+    uint32_t cycles;
+    uint32_t overruns;
+    uint32_t sensor_misses;
+} stats;
+
+static bool IRAM_ATTR tec_on_alarm(gptimer_handle_t gptimer, const gptimer_alarm_event_data_t *edata, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(tec_task_handle, &woken);
+    return woken == pdTRUE;
+}
+
+static void tec_apply(float output)
+{
+    if (output > -TEC_OUTPUT_DEADBAND && output < TEC_OUTPUT_DEADBAND)
+    {
+        output = 0.0f;
+    }
+
+    // never switch the bridge under load: the output goes off and the direction write is only queued,
+    // power comes back on a later cycle once the expander reports the write done
+    bool cool = output < 0.0f;
+    if (output != 0.0f && cool != cooling)
+    {
+        ledc_set_duty(LEDC_LOW_SPEED_MODE, TEC_PWM_CHANNEL, 0);
+        ledc_update_duty(LEDC_LOW_SPEED_MODE, TEC_PWM_CHANNEL);
+        // skipped while another task holds the expander, the next cycle tries again
+        if (tryWritePins(&cat_device, TEC_DIRECTION_PIN, cool ? TEC_DIRECTION_PIN : 0) == ESP_OK)
+        {
+            cooling = cool;
+            direction_pending = true;
+        }
+        return;
+    }
+
+    if (direction_pending)
+    {
+        if (!catWritesComplete(&cat_device))
+        {
+            // repeats the write if it failed, otherwise there is nothing to send
+            tryWritePins(&cat_device, TEC_DIRECTION_PIN, cooling ? TEC_DIRECTION_PIN : 0);
+            return;
+        }
+        direction_pending = false;
+    }
+
+    float magnitude = (output < 0.0f) ? -output : output;
+    ledc_set_duty(LEDC_LOW_SPEED_MODE, TEC_PWM_CHANNEL, (uint32_t)(magnitude * TEC_PWM_MAX_DUTY));
+    ledc_update_duty(LEDC_LOW_SPEED_MODE, TEC_PWM_CHANNEL);
+}
+
+static void tec_task(void *pvparameters)
+{
+    sht3x_measurement_t measurements[SHT3X_RESULT_QUEUE_LENGTH];
+    int64_t last_cycle = 0;
+    int64_t last_reading = esp_timer_get_time();
+
+    while (1)
+    {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start = esp_timer_get_time();
+
+        // new gains take effect between cycles and restart the controller
+        taskENTER_CRITICAL(&config_lock);
+        bool reconfigure = gains_changed;
+        bool enabled = gains_valid && !isnan(setpoint);
+        pid_config_t config = pid_config;
+        gains_changed = false;
+        taskEXIT_CRITICAL(&config_lock);
+        if (reconfigure)
+        {
+            pid_init(&pid, &config);
+        }
+
+        // only returns what earlier cycles fetched and queues the next fetch
+        uint8_t fetched = 0;
+        esp_err_t err = sht3x_read_measurements(sensor, measurements, SHT3X_RESULT_QUEUE_LENGTH, &fetched);
+        if (err == ESP_OK)
+        {
+            float dt = pid.primed ? (float)(start - last_reading) / 1e6f : (float)TEC_PERIOD_US / 1e6f;
+            last_reading = start;
+
+            const sht3x_measurement_t *latest = &measurements[fetched - 1];
+            float output = enabled ? pid_update(&pid, setpoint, latest->temperature_degC, dt) : 0.0f;
+            tec_apply(output);
+
+            for (uint8_t i = 0; i < fetched; i++)
+            {
+                tec_sample_t sample = {
+                    .temperature = measurements[i].temperature_degC,
+                    .humidity = measurements[i].relative_humidity,
+                    .output = output,
+                };
+                // a slow consumer loses samples, the loop never waits for it
+                xQueueSend(sample_queue, &sample, 0);
+            }
+        }
+        else if (start - last_reading > TEC_SENSOR_TIMEOUT_US && pid.primed)
+        {
+            ESP_LOGW(TAG, "No reading, switching off");
+            pid_reset(&pid);
+            tec_apply(0.0f);
+        }
+
+        int64_t end = esp_timer_get_time();
+
+        uint32_t jitter = 0;
+        if (last_cycle != 0)
+        {
+            jitter = (uint32_t)llabs(start - last_cycle - (int64_t)TEC_PERIOD_US);
+        }
+        last_cycle = start;
+        uint32_t compute = (uint32_t)(end - start);
+
+        taskENTER_CRITICAL(&stats_lock);
+        stats.cycles++;
+        stats.overruns += pending - 1;
+        if (err != ESP_OK)
+        {
+            stats.sensor_misses++;
+        }
+        stats.jitter_sum_us += jitter;
+        stats.compute_sum_us += compute;
+        if (jitter > stats.jitter_max_us)
+        {
+            stats.jitter_max_us = jitter;
+        }
+        if (compute > stats.compute_max_us)
+        {
+            stats.compute_max_us = compute;
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+static esp_err_t tec_init_pwm()
+{
+    ledc_timer_config_t timer_config = {
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .duty_resolution = TEC_PWM_RESOLUTION,
+        .timer_num = TEC_PWM_TIMER,
+        .freq_hz = TEC_PWM_FREQUENCY,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t ret = ledc_timer_config(&timer_config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ledc_channel_config_t channel_config = {
+        .gpio_num = TEC_PWM_GPIO,
+        .speed_mode = LEDC_LOW_SPEED_MODE,
+        .channel = TEC_PWM_CHANNEL,
+        .timer_sel = TEC_PWM_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    ret = ledc_channel_config(&channel_config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    setDirections(&cat_device, TEC_DIRECTION_PIN, CAT_DIR_output);
+    return clearPins(&cat_device, TEC_DIRECTION_PIN);
+}
+
+static esp_err_t tec_init_timer()
+{
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000,
+    };
+    esp_err_t ret = gptimer_new_timer(&timer_config, &timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = tec_on_alarm,
+    };
+    ret = gptimer_register_event_callbacks(timer, &callbacks, NULL);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = TEC_PERIOD_US,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    ret = gptimer_set_alarm_action(timer, &alarm_config);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    // the driver holds a pm lock while enabled, the period stays exact with light sleep configured
+    ret = gptimer_enable(timer);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    return gptimer_start(timer);
+}
+
+esp_err_t tec_init(sht3x_device_t *dev)
+{
+    sensor = dev;
+    pid_init(&pid, &pid_config);
+
+    sample_queue = xQueueCreate(TEC_SAMPLE_QUEUE_LENGTH, sizeof(tec_sample_t));
+    if (sample_queue == NULL)
+    {
+        ESP_LOGE(TAG, "Cannot create Queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = tec_init_pwm();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to set up output");
+        return ret;
+    }
+
+    // above every interval task and next to the i2c bus, away from the wifi core
+    if (xTaskCreatePinnedToCore(&tec_task, "TEC", 3072, NULL, configMAX_PRIORITIES - 1, &tec_task_handle, 1) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Cannot create control task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = tec_init_timer();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start control timer");
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Control loop running every %llu us", TEC_PERIOD_US);
+    return ESP_OK;
+}
+
+void tec_set_setpoint(float temperature)
+{
+    setpoint = temperature;
+}
+
+void tec_set_gains(float kp, float ki, float kd)
+{
+    taskENTER_CRITICAL(&config_lock);
+    if (!gains_valid || kp != pid_config.kp || ki != pid_config.ki || kd != pid_config.kd)
+    {
+        pid_config.kp = kp;
+        pid_config.ki = ki;
+        pid_config.kd = kd;
+        gains_valid = true;
+        gains_changed = true;
+    }
+    taskEXIT_CRITICAL(&config_lock);
+}
+
+float tec_get_setpoint()
+{
+    return setpoint;
+}
+
+bool tec_receive_sample(tec_sample_t *sample)
+{
+    if (sample_queue == NULL)
+    {
+        return false;
+    }
+    return xQueueReceive(sample_queue, sample, 0) == pdPASS;
+}
+
+void tec_get_stats(tec_stats_t *out)
+{
+    taskENTER_CRITICAL(&stats_lock);
+    out->cycles = stats.cycles;
+    out->overruns = stats.overruns;
+    out->sensor_misses = stats.sensor_misses;
+    out->jitter_avg_us = (stats.cycles > 0) ? (uint32_t)(stats.jitter_sum_us / stats.cycles) : 0;
+    out->jitter_max_us = stats.jitter_max_us;
+    out->compute_avg_us = (stats.cycles > 0) ? (uint32_t)(stats.compute_sum_us / stats.cycles) : 0;
+    out->compute_max_us = stats.compute_max_us;
+
+    memset(&stats, 0, sizeof(stats));
+    taskEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,40 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "decimator.h"
+
+#define BENCH_SAMPLES 20000000
+
+int main(void)
+{
+    static const struct
+    {
+        uint8_t order;
+        uint16_t ratio;
+    } configs[] = {{1, 10}, {2, 20}, {3, 10}, {4, 16}};
+
+    printf("order ratio   Msamples/s\n");
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        decimator_t dec;
+        CHECK(decimator_init(&dec, configs[c].order, configs[c].ratio) == ESP_OK);
+
+        volatile float sink = 0.0f;
+        double start = now_seconds();
+        for (int i = 0; i < BENCH_SAMPLES; i++)
+        {
+            float out;
+            if (decimator_push(&dec, (float)(i & 0xff) * 0.125f, &out))
+            {
+                sink = out;
+            }
+        }
+        double elapsed = now_seconds() - start;
+        (void)sink;
+
+        printf("%5u %5u   %10.1f\n", configs[c].order, configs[c].ratio, BENCH_SAMPLES / elapsed * 1e-6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "image_stats.h"
+
+// the 1/8 scale preview of a uxga frame and the default roi
+#define WIDTH 200
+#define HEIGHT 150
+#define FRAMES 20000
+
+int main(void)
+{
+    static uint8_t image[WIDTH * HEIGHT * 2];
+    uint32_t seed = 1;
+    for (size_t i = 0; i < sizeof(image); i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        image[i] = seed >> 24;
+    }
+
+    image_roi_t roi = {.x = 50, .y = 20, .width = 100, .height = 110};
+    image_roi_t all = {.x = 0, .y = 0, .width = WIDTH, .height = HEIGHT};
+    image_stats_t stats;
+    volatile float sink = 0.0f;
+
+    double start = now_seconds();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &roi, &stats) == ESP_OK);
+        sink = stats.mean_g;
+    }
+    double elapsed = now_seconds() - start;
+    printf("stats roi: %.1f Mpx/s on %ux%u\n", (double)roi.width * roi.height * FRAMES / elapsed * 1e-6, roi.width, roi.height);
+
+    start = now_seconds();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &all, &stats) == ESP_OK);
+        sink = stats.mean_g;
+    }
+    elapsed = now_seconds() - start;
+    printf("stats frame: %.1f Mpx/s on %ux%u\n", (double)WIDTH * HEIGHT * FRAMES / elapsed * 1e-6, WIDTH, HEIGHT);
+
+    volatile uint64_t hash = 0;
+    start = now_seconds();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        hash = image_dhash_rgb565(image, WIDTH, HEIGHT);
+    }
+    elapsed = now_seconds() - start;
+    printf("dhash: %.1f us per %ux%u frame\n", elapsed / FRAMES * 1e6, WIDTH, HEIGHT);
+
+    (void)sink;
+    (void)hash;
+    return 0;
+}
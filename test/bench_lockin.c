@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "lockin.h"
+
+#define PERIOD 16
+#define BLOCK 800
+#define BLOCKS 200000
+
+int main(void)
+{
+    static int16_t samples[BLOCK];
+    for (size_t n = 0; n < BLOCK; n++)
+    {
+        samples[n] = (int16_t)(((n % PERIOD) < PERIOD / 2 ? 100 : 0) + (n * 7919) % 41);
+    }
+
+    lockin_t lockin;
+    CHECK(lockin_init(&lockin, PERIOD) == ESP_OK);
+
+    volatile float sink = 0.0f;
+    double start = now_seconds();
+    for (int block = 0; block < BLOCKS; block++)
+    {
+        lockin_reset(&lockin);
+        lockin_push(&lockin, samples, BLOCK);
+
+        lockin_result_t result;
+        lockin_result(&lockin, &result);
+        sink = result.amplitude;
+    }
+    double elapsed = now_seconds() - start;
+    (void)sink;
+
+    printf("lockin: %.1f Msamples/s in windows of %d\n", (double)BLOCK * BLOCKS / elapsed * 1e-6, BLOCK);
+    return 0;
+}
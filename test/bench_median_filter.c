@@ -0,0 +1,36 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "test.h"
+#include "median_filter.h"
+
+#define BENCH_SAMPLES 2000000
+
+int main(void)
+{
+    static const uint16_t sizes[] = {16, 64, 256, 1024};
+    uint32_t seed = 1;
+
+    printf("window   ns/push\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        rolling_median_t rm;
+        CHECK(rolling_median_init(&rm, sizes[i]) == ESP_OK);
+
+        volatile float sink = 0.0f;
+        double start = now_seconds();
+        for (int n = 0; n < BENCH_SAMPLES; n++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            rolling_median_push(&rm, (float)(seed >> 8));
+            sink = rolling_median_get(&rm);
+        }
+        double elapsed = now_seconds() - start;
+        (void)sink;
+
+        printf("%6u   %7.1f\n", sizes[i], elapsed * 1e9 / BENCH_SAMPLES);
+        rolling_median_free(&rm);
+    }
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cJSON.h"
+
+static cJSON *cjson_new(int type)
+{
+    cJSON *item = calloc(1, sizeof(cJSON));
+    if (item != NULL)
+    {
+        item->type = type;
+    }
+    return item;
+}
+
+cJSON *cJSON_CreateObject(void)
+{
+    return cjson_new(cJSON_Object);
+}
+
+cJSON *cJSON_CreateArray(void)
+{
+    return cjson_new(cJSON_Array);
+}
+
+cJSON *cJSON_CreateNumber(double number)
+{
+    cJSON *item = cjson_new(cJSON_Number);
+    if (item != NULL)
+    {
+        item->valuedouble = number;
+        item->valueint = (int)number;
+    }
+    return item;
+}
+
+cJSON *cJSON_CreateString(const char *string)
+{
+    cJSON *item = cjson_new(cJSON_String);
+    if (item != NULL && (item->valuestring = strdup(string)) == NULL)
+    {
+        free(item);
+        return NULL;
+    }
+    return item;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item != NULL)
+    {
+        cJSON *next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+bool cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    if (array == NULL || item == NULL || array == item)
+    {
+        return false;
+    }
+
+    if (array->child == NULL)
+    {
+        array->child = item;
+        item->prev = item;
+    }
+    else
+    {
+        // like cJSON the first child's prev points at the last one
+        cJSON *last = array->child->prev;
+        last->next = item;
+        item->prev = last;
+        array->child->prev = item;
+    }
+    item->next = NULL;
+    return true;
+}
+
+bool cJSON_AddItemToObject(cJSON *object, const char *name, cJSON *item)
+{
+    if (object == NULL || name == NULL || item == NULL)
+    {
+        return false;
+    }
+
+    char *key = strdup(name);
+    if (key == NULL)
+    {
+        return false;
+    }
+    free(item->string);
+    item->string = key;
+    return cJSON_AddItemToArray(object, item);
+}
+
+static cJSON *cjson_add(cJSON *object, const char *name, cJSON *item)
+{
+    if (cJSON_AddItemToObject(object, name, item))
+    {
+        return item;
+    }
+    cJSON_Delete(item);
+    return NULL;
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name)
+{
+    return cjson_add(object, name, cJSON_CreateObject());
+}
+
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name)
+{
+    return cjson_add(object, name, cJSON_CreateArray());
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number)
+{
+    return cjson_add(object, name, cJSON_CreateNumber(number));
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string)
+{
+    return cjson_add(object, name, cJSON_CreateString(string));
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int size = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, array)
+    {
+        size++;
+    }
+    return size;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    cJSON *item;
+    cJSON_ArrayForEach(item, array)
+    {
+        if (index-- == 0)
+        {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name)
+{
+    cJSON *item;
+    cJSON_ArrayForEach(item, object)
+    {
+        if (item->string != NULL && strcasecmp(item->string, name) == 0)
+        {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+bool cJSON_IsNumber(const cJSON *item)
+{
+    return item != NULL && item->type == cJSON_Number;
+}
+
+bool cJSON_IsArray(const cJSON *item)
+{
+    return item != NULL && item->type == cJSON_Array;
+}
+
+bool cJSON_IsObject(const cJSON *item)
+{
+    return item != NULL && item->type == cJSON_Object;
+}
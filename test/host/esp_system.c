@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+
+static atomic_llong timer_offset = 0;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return monotonic_us() + atomic_load(&timer_offset);
+}
+
+void host_timer_advance(int64_t us)
+{
+    atomic_fetch_add(&timer_offset, us);
+}
+
+struct host_timer
+{
+    esp_timer_create_args_t args;
+    uint64_t timeout_us;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    *handle = calloc(1, sizeof(struct host_timer));
+    if (*handle == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    (*handle)->args = *args;
+    return ESP_OK;
+}
+
+static void *host_timer_entry(void *arg)
+{
+    esp_timer_handle_t timer = arg;
+    struct timespec delay = {
+        .tv_sec = timer->timeout_us / 1000000,
+        .tv_nsec = (long)(timer->timeout_us % 1000000) * 1000L,
+    };
+    nanosleep(&delay, NULL);
+    timer->args.callback(timer->args.arg);
+    return NULL;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->timeout_us = timeout_us;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, host_timer_entry, timer) != 0)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    int64_t end = monotonic_us() + us;
+    while (monotonic_us() < end)
+    {
+    }
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
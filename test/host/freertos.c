@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct host_queue
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+    // recursive mutexes only
+    pthread_t owner;
+    UBaseType_t depth;
+};
+
+typedef struct
+{
+    TaskFunction_t function;
+    void *parameters;
+} host_task_start_t;
+
+static void *host_task_entry(void *arg)
+{
+    host_task_start_t start = *(host_task_start_t *)arg;
+    free(arg);
+    start.function(start.parameters);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *parameters,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+
+    host_task_start_t *start = malloc(sizeof(host_task_start_t));
+    if (start == NULL)
+    {
+        return pdFAIL;
+    }
+    start->function = function;
+    start->parameters = parameters;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, host_task_entry, start) != 0)
+    {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+
+    if (handle != NULL)
+    {
+        *handle = (TaskHandle_t)start;
+    }
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (long)(ticks % 1000) * 1000000L,
+    };
+    nanosleep(&delay, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct host_queue));
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+
+    queue->items = calloc(length, item_size > 0 ? item_size : 1);
+    if (queue->items == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&queue->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&queue->mutex, NULL);
+
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue);
+}
+
+// waits for the condition to change, false once the ticks ran out
+static bool host_queue_wait(QueueHandle_t queue, TickType_t ticks, const struct timespec *deadline)
+{
+    if (ticks == 0)
+    {
+        return false;
+    }
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(&queue->changed, &queue->mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(&queue->changed, &queue->mutex, deadline) == 0;
+}
+
+static struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += ticks / 1000;
+    deadline.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length)
+    {
+        if (!host_queue_wait(queue, ticks, &deadline))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+    }
+
+    if (queue->item_size > 0)
+    {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken)
+{
+    if (woken != NULL)
+    {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0)
+    {
+        if (!host_queue_wait(queue, ticks, &deadline))
+        {
+            pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+    }
+
+    if (queue->item_size > 0)
+    {
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if (mutex != NULL)
+    {
+        mutex->count = 1;
+    }
+    return mutex;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    struct timespec deadline = host_deadline(ticks);
+
+    pthread_mutex_lock(&mutex->mutex);
+    if (mutex->depth > 0 && pthread_equal(mutex->owner, pthread_self()))
+    {
+        mutex->depth++;
+        pthread_mutex_unlock(&mutex->mutex);
+        return pdPASS;
+    }
+
+    while (mutex->count == 0)
+    {
+        if (!host_queue_wait(mutex, ticks, &deadline))
+        {
+            pthread_mutex_unlock(&mutex->mutex);
+            return pdFAIL;
+        }
+    }
+    mutex->count = 0;
+    mutex->owner = pthread_self();
+    mutex->depth = 1;
+
+    pthread_mutex_unlock(&mutex->mutex);
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+    pthread_mutex_lock(&mutex->mutex);
+    if (mutex->depth == 0 || !pthread_equal(mutex->owner, pthread_self()))
+    {
+        pthread_mutex_unlock(&mutex->mutex);
+        return pdFAIL;
+    }
+
+    if (--mutex->depth == 0)
+    {
+        mutex->count = 1;
+        pthread_cond_broadcast(&mutex->changed);
+    }
+    pthread_mutex_unlock(&mutex->mutex);
+    return pdPASS;
+}
@@ -0,0 +1,51 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "driver/gpio.h"
+
+static bool service_installed = false;
+static struct
+{
+    gpio_isr_t handler;
+    void *arg;
+} handlers[HOST_GPIO_COUNT];
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    return (config->pin_bit_mask >> HOST_GPIO_COUNT) ? ESP_ERR_INVALID_ARG : ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    if (service_installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    service_installed = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    if (!service_installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handlers[gpio].handler = handler;
+    handlers[gpio].arg = arg;
+    return ESP_OK;
+}
+
+bool host_gpio_trigger(gpio_num_t gpio)
+{
+    if (gpio < 0 || gpio >= HOST_GPIO_COUNT || handlers[gpio].handler == NULL)
+    {
+        return false;
+    }
+    handlers[gpio].handler(handlers[gpio].arg);
+    return true;
+}
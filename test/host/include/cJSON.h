@@ -0,0 +1,49 @@
+#pragma once
+#ifndef HOST_CJSON_H
+#define HOST_CJSON_H
+
+#include <stdbool.h>
+
+// the part of the cJSON tree api the firmware builds its exports with, no parser or printer
+// types and layout follow cJSON so the firmware code compiles unchanged
+
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array (1 << 5)
+#define cJSON_Object (1 << 6)
+
+typedef struct cJSON
+{
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+#define cJSON_ArrayForEach(element, array) for (element = (array != NULL) ? (array)->child : NULL; element != NULL; element = element->next)
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateArray(void);
+cJSON *cJSON_CreateNumber(double number);
+cJSON *cJSON_CreateString(const char *string);
+void cJSON_Delete(cJSON *item);
+
+bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+bool cJSON_AddItemToObject(cJSON *object, const char *name, cJSON *item);
+cJSON *cJSON_AddObjectToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddArrayToObject(cJSON *object, const char *name);
+cJSON *cJSON_AddNumberToObject(cJSON *object, const char *name, double number);
+cJSON *cJSON_AddStringToObject(cJSON *object, const char *name, const char *string);
+
+int cJSON_GetArraySize(const cJSON *array);
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *name);
+bool cJSON_IsNumber(const cJSON *item);
+bool cJSON_IsArray(const cJSON *item);
+bool cJSON_IsObject(const cJSON *item);
+
+#endif
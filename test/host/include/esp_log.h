@@ -0,0 +1,23 @@
+#pragma once
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+// errors and warnings go to stderr, everything else is compiled but never printed
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define HOST_LOG_NONE(tag, format, ...)                       \
+    do                                                        \
+    {                                                         \
+        if (0)                                                \
+        {                                                     \
+            fprintf(stderr, "%s" format, tag, ##__VA_ARGS__); \
+        }                                                     \
+    } while (0)
+#define ESP_LOGI(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG_NONE(tag, format, ##__VA_ARGS__)
+
+#endif
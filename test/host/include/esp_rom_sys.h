@@ -0,0 +1,10 @@
+#pragma once
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+// busy waits like the rom function so that simulated bus time shows up as cpu time
+void esp_rom_delay_us(uint32_t us);
+
+#endif
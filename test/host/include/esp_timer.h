@@ -0,0 +1,29 @@
+#pragma once
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef struct host_timer *esp_timer_handle_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+// microseconds on the monotonic clock
+int64_t esp_timer_get_time(void);
+
+// one shot timers only, each start runs the callback on its own thread
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+
+// host only: moves esp_timer_get_time forward, lets tests skip sensor measurement periods
+void host_timer_advance(int64_t us);
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// FreeRTOS on top of pthreads, just enough to run the bus manager and drivers on the host
+// ticks are milliseconds and critical sections are a plain mutex
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {PTHREAD_MUTEX_INITIALIZER}
+
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL_ISR(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux) taskEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+#endif
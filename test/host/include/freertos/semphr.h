@@ -0,0 +1,21 @@
+#pragma once
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// a binary semaphore is a queue of one empty item, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), NULL, 0)
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive((semaphore), NULL, (ticks))
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+
+// the same queue with an owner, the owning thread may take it again and has to give it as often
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#endif
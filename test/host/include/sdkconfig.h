@@ -0,0 +1,7 @@
+#pragma once
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// menuconfig options are set per target by test/CMakeLists.txt
+
+#endif
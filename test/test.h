@@ -0,0 +1,40 @@
+#pragma once
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// minimal assertions for the host tests, a failed check ends the test binary
+
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        if (!(condition))                                                       \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                             \
+    do                                                                          \
+    {                                                                           \
+        double _a = (a), _b = (b);                                              \
+        if (!(_a - _b <= (tolerance) && _b - _a <= (tolerance)))                \
+        {                                                                       \
+            fprintf(stderr, "%s:%d: %s = %g, expected %g +- %g\n",              \
+                    __FILE__, __LINE__, #a, _a, _b, (double)(tolerance));       \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+static inline double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
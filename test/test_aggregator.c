@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "test.h"
+#include "aggregator.h"
+
+#define SAMPLES 1000
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+static void test_empty(void)
+{
+    aggregator_t agg;
+    aggregator_reset(&agg);
+    CHECK(agg.count == 0);
+    CHECK(aggregator_variance(&agg) == 0.0f);
+
+    // a single sample has no spread
+    aggregator_add(&agg, 42, 3.5f);
+    CHECK(agg.count == 1);
+    CHECK(agg.mean == 3.5f && agg.min == 3.5f && agg.max == 3.5f);
+    CHECK(agg.first_timestamp == 42 && agg.last_timestamp == 42);
+    CHECK(aggregator_variance(&agg) == 0.0f);
+}
+
+// the streaming summary against a two pass reference in double
+static void test_reference(float offset, float spread)
+{
+    static float values[SAMPLES];
+    aggregator_t agg;
+    aggregator_reset(&agg);
+
+    double sum = 0.0;
+    float min = INFINITY, max = -INFINITY;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        values[i] = offset + spread * ((float)(next_random() % 20001) / 10000.0f - 1.0f);
+        aggregator_add(&agg, 1000 + i * 100, values[i]);
+        sum += values[i];
+        min = fminf(min, values[i]);
+        max = fmaxf(max, values[i]);
+    }
+
+    double mean = sum / SAMPLES;
+    double m2 = 0.0;
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        m2 += (values[i] - mean) * (values[i] - mean);
+    }
+    double variance = m2 / (SAMPLES - 1);
+
+    CHECK(agg.count == SAMPLES);
+    CHECK(agg.first_timestamp == 1000);
+    CHECK(agg.last_timestamp == 1000 + (SAMPLES - 1) * 100);
+    CHECK(agg.min == min && agg.max == max);
+    CHECK_NEAR(agg.mean, mean, fabs(offset) * 1e-6 + spread * 1e-4);
+    CHECK_NEAR(aggregator_variance(&agg), variance, variance * 1e-3);
+
+    // a reset window starts over
+    aggregator_reset(&agg);
+    CHECK(agg.count == 0);
+    aggregator_add(&agg, 5, -1.0f);
+    CHECK(agg.mean == -1.0f && agg.min == -1.0f && agg.max == -1.0f);
+    CHECK(agg.first_timestamp == 5);
+}
+
+int main(void)
+{
+    test_empty();
+    test_reference(0.0f, 1.0f);
+    test_reference(-45.0f, 100.0f);
+    // a large offset with little spread, the case a naive sum of squares loses
+    test_reference(10000.0f, 0.5f);
+    printf("aggregator: ok\n");
+    return 0;
+}
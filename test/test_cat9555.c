@@ -0,0 +1,215 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#include "test.h"
+#include "i2c_user.h"
+#include "i2c/sim.h"
+#include "cat9555.h"
+
+#define CAT9555_ADDRESS 0b0100111
+
+#define PIN_A CAT_PIN_MASK(CAT_PORT_0, CAT_PIN_1)
+#define PIN_B CAT_PIN_MASK(CAT_PORT_0, CAT_PIN_2)
+#define PIN_C CAT_PIN_MASK(CAT_PORT_1, CAT_PIN_0)
+#define PIN_D CAT_PIN_MASK(CAT_PORT_1, CAT_PIN_5)
+#define INT_GPIO 13
+
+static cat_state_t cat;
+static uint32_t test_reads = 0;
+
+// a blocking transfer returns after everything queued before it, the register pair is read back
+static uint16_t read_register_pair(cat_command_t reg_0)
+{
+    uint8_t reg = reg_0;
+    uint8_t rx[2];
+    CHECK(i2c_user_transfer(cat.i2c_dev, &reg, 1, rx, 2, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    test_reads++;
+    return rx[0] | (rx[1] << 8);
+}
+
+// transactions the driver put on the bus since the previous call, the test's own reads excluded
+static uint32_t bus_writes(void)
+{
+    read_register_pair(CAT_CMD_OUTPUT_0);
+    i2c_user_stats_t stats;
+    i2c_user_get_stats(&stats);
+    CHECK(stats.errors == 0);
+
+    uint32_t writes = stats.transactions - test_reads;
+    test_reads = 0;
+    return writes;
+}
+
+static void test_init(void)
+{
+    CHECK(initlizeCat(&cat, 0x10) == ESP_FAIL);
+    CHECK(initlizeCat(&cat, CAT9555_ADDRESS) == ESP_OK);
+
+    // the power up state is unknown to the driver, every register is written once
+    CHECK(bus_writes() == 3);
+    CHECK(catWritesComplete(&cat));
+    CHECK(sim_cat9555_get_outputs() == 0x0000);
+    CHECK(read_register_pair(CAT_CMD_POLARITY_0) == 0x0000);
+    CHECK(read_register_pair(CAT_CMD_CONFIG_0) == 0x0000);
+}
+
+static void test_shadow(void)
+{
+    // one write per changed register, pins already at their level cost nothing
+    CHECK(setPins(&cat, PIN_A | PIN_B) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(sim_cat9555_get_outputs() == (PIN_A | PIN_B));
+
+    CHECK(setPins(&cat, PIN_A) == ESP_OK);
+    CHECK(clearPins(&cat, PIN_C) == ESP_OK);
+    CHECK(writePins(&cat, PIN_A | PIN_C, PIN_A) == ESP_OK);
+    CHECK(bus_writes() == 0);
+
+    // both ports of a pair go out in one auto incrementing write
+    CHECK(writePins(&cat, PIN_A | PIN_B | PIN_C, PIN_C) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(sim_cat9555_get_outputs() == PIN_C);
+
+    CHECK(togglePins(&cat, PIN_A | PIN_C) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(sim_cat9555_get_outputs() == PIN_A);
+
+    CHECK(setLevel(&cat, CAT_PORT_1, CAT_PIN_0, CAT_LEVEL_HIGH) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(sim_cat9555_get_outputs() == (PIN_A | PIN_C));
+
+    CHECK(tryWritePins(&cat, PIN_A | PIN_C, 0) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(sim_cat9555_get_outputs() == 0x0000);
+    CHECK(catWritesComplete(&cat));
+}
+
+static void test_coalesced(void)
+{
+    // inside a transaction only the shadow changes, the commit writes each register once
+    CHECK(catBeginTransaction(&cat) == ESP_OK);
+    CHECK(setPins(&cat, PIN_A) == ESP_OK);
+    CHECK(setPins(&cat, PIN_B) == ESP_OK);
+    CHECK(setPins(&cat, PIN_C) == ESP_OK);
+    CHECK(setDirections(&cat, PIN_C, CAT_DIR_INPUT) == ESP_OK);
+    CHECK(setPolarities(&cat, PIN_C, CAT_POLARITY_INVERT) == ESP_OK);
+    CHECK(bus_writes() == 0);
+    CHECK(sim_cat9555_get_outputs() == 0x0000);
+
+    // nested transactions write on the outermost commit
+    CHECK(catBeginTransaction(&cat) == ESP_OK);
+    CHECK(clearPins(&cat, PIN_A) == ESP_OK);
+    CHECK(catCommitTransaction(&cat) == ESP_OK);
+    CHECK(bus_writes() == 0);
+
+    CHECK(catCommitTransaction(&cat) == ESP_OK);
+    CHECK(bus_writes() == 3);
+    CHECK(sim_cat9555_get_outputs() == (PIN_B | PIN_C));
+    CHECK(read_register_pair(CAT_CMD_POLARITY_0) == PIN_C);
+    CHECK(read_register_pair(CAT_CMD_CONFIG_0) == PIN_C);
+
+    // changes that cancel out inside a transaction never reach the bus
+    CHECK(catBeginTransaction(&cat) == ESP_OK);
+    CHECK(togglePins(&cat, PIN_A | PIN_B) == ESP_OK);
+    CHECK(togglePins(&cat, PIN_A | PIN_B) == ESP_OK);
+    CHECK(setDirections(&cat, PIN_C, CAT_DIR_output) == ESP_OK);
+    CHECK(setDirections(&cat, PIN_C, CAT_DIR_INPUT) == ESP_OK);
+    CHECK(catCommitTransaction(&cat) == ESP_OK);
+    CHECK(bus_writes() == 0);
+
+    CHECK(catCommitTransaction(&cat) == ESP_ERR_INVALID_STATE);
+
+    // back to plain outputs for the tests after this one
+    CHECK(catBeginTransaction(&cat) == ESP_OK);
+    CHECK(clearPins(&cat, 0xffff) == ESP_OK);
+    CHECK(setDirections(&cat, 0xffff, CAT_DIR_output) == ESP_OK);
+    CHECK(setPolarities(&cat, 0xffff, CAT_POLARITY_NORMAL) == ESP_OK);
+    CHECK(catCommitTransaction(&cat) == ESP_OK);
+    CHECK(bus_writes() == 3);
+    CHECK(catWritesComplete(&cat));
+}
+
+typedef struct
+{
+    atomic_uint calls;
+    atomic_uint changed;
+    atomic_uint levels;
+} edge_record_t;
+
+static void record_edge(cat_state_t *dev, uint16_t changed, uint16_t levels, void *ctx)
+{
+    edge_record_t *record = ctx;
+    atomic_fetch_add(&record->calls, 1);
+    atomic_fetch_or(&record->changed, changed);
+    atomic_store(&record->levels, levels);
+}
+
+static void test_interrupt_cache(void)
+{
+    static edge_record_t rising, falling;
+
+    // port 1 as inputs, port 0 outputs read back what they drive
+    CHECK(setDirections(&cat, 0xff00, CAT_DIR_INPUT) == ESP_OK);
+    CHECK(setPins(&cat, PIN_A) == ESP_OK);
+    sim_cat9555_set_inputs(PIN_D);
+    CHECK(bus_writes() == 2);
+
+    // without the INT line every level is a bus read
+    CHECK(!cat.input_valid);
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_5) == CAT_LEVEL_HIGH);
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_0) == CAT_LEVEL_LOW);
+    CHECK(bus_writes() == 2);
+
+    CHECK(catSubscribe(&cat, 0, CAT_EDGE_ANY, record_edge, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(catSubscribe(&cat, PIN_C, CAT_EDGE_ANY, NULL, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(catSubscribe(&cat, PIN_C | PIN_D, CAT_EDGE_RISING, record_edge, &rising) == ESP_OK);
+    CHECK(catSubscribe(&cat, PIN_C | PIN_D, CAT_EDGE_FALLING, record_edge, &falling) == ESP_OK);
+
+    // enabling primes the cache with one read, the first snapshot is no edge
+    CHECK(catEnableInterrupt(&cat, INT_GPIO) == ESP_OK);
+    CHECK(bus_writes() == 1);
+    CHECK(cat.input_valid);
+    CHECK(getInputs(&cat) == (PIN_A | PIN_D));
+    CHECK(atomic_load(&rising.calls) == 0 && atomic_load(&falling.calls) == 0);
+
+    // levels come from the cache until the chip signals a change
+    sim_cat9555_set_inputs(PIN_C);
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_5) == CAT_LEVEL_HIGH);
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_0) == CAT_LEVEL_LOW);
+    CHECK(getLevel(&cat, CAT_PORT_0, CAT_PIN_1) == CAT_LEVEL_HIGH);
+    CHECK(bus_writes() == 0);
+
+    CHECK(host_gpio_trigger(INT_GPIO));
+    CHECK(bus_writes() == 1);
+    CHECK(getInputs(&cat) == (PIN_A | PIN_C));
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_5) == CAT_LEVEL_LOW);
+    CHECK(getLevel(&cat, CAT_PORT_1, CAT_PIN_0) == CAT_LEVEL_HIGH);
+
+    // each subscriber only sees its edges
+    CHECK(atomic_load(&rising.calls) == 1);
+    CHECK(atomic_load(&rising.changed) == PIN_C);
+    CHECK(atomic_load(&rising.levels) == (PIN_A | PIN_C));
+    CHECK(atomic_load(&falling.calls) == 1);
+    CHECK(atomic_load(&falling.changed) == PIN_D);
+
+    // an interrupt without a change in the subscribed pins calls nobody
+    CHECK(host_gpio_trigger(INT_GPIO));
+    CHECK(bus_writes() == 1);
+    CHECK(atomic_load(&rising.calls) == 1 && atomic_load(&falling.calls) == 1);
+}
+
+int main(void)
+{
+    CHECK(i2c_init() == ESP_OK);
+
+    test_init();
+    test_shadow();
+    test_coalesced();
+    test_interrupt_cache();
+    printf("cat9555: ok\n");
+    return 0;
+}
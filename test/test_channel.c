@@ -0,0 +1,196 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "test.h"
+#include "timer.h"
+#include "channel.h"
+#include "measurement.h"
+
+// the channel publishes into these, normally owned by measurement.c
+QueueHandle_t xMeasurementQueue;
+QueueHandle_t xSeriesQueue = NULL;
+
+// channels stamp samples and heartbeats with the wall clock, the test drives it by hand
+static uint32_t fake_time = 1000;
+
+esp_err_t get_current_time(uint32_t *time)
+{
+    *time = fake_time;
+    return ESP_OK;
+}
+
+// publishes one window of constant samples, true if a measurement was queued
+static bool publish_window(channel_t *channel, float value, measurement_t *out)
+{
+    channel_update(channel, value);
+    fake_time += 10;
+    channel_update(channel, value);
+    fake_time += 10;
+
+    CHECK(channel_publish(channel) == ESP_OK);
+    return xQueueReceive(xMeasurementQueue, out, 0) == pdPASS;
+}
+
+static void test_summary(void)
+{
+    static const channel_config_t config = {.type = "summary"};
+    channel_t channel;
+    measurement_t measurement;
+    CHECK(channel_init(&channel, &config) == ESP_OK);
+
+    // nothing sampled, nothing sent
+    CHECK(channel_publish(&channel) == ESP_ERR_NOT_FOUND);
+    CHECK(channel.total_empty == 1);
+
+    uint32_t first = fake_time;
+    const float values[] = {1.0f, 4.0f, 2.0f, 5.0f};
+    for (size_t i = 0; i < 4; i++)
+    {
+        channel_update(&channel, values[i]);
+        fake_time += 100;
+    }
+    CHECK(channel_publish(&channel) == ESP_OK);
+    CHECK(xQueueReceive(xMeasurementQueue, &measurement, 0) == pdPASS);
+    CHECK(measurement.count == 1);
+    CHECK(measurement.timestamp == fake_time);
+
+    const measurement_value_t *value = &measurement.values[0];
+    CHECK(strcmp(value->type, "summary") == 0);
+    CHECK(value->count == 4);
+    CHECK_NEAR(value->value, 3.0, 1e-6);
+    CHECK(value->min == 1.0f && value->max == 5.0f);
+    CHECK_NEAR(value->variance, 10.0 / 3.0, 1e-5);
+    CHECK(value->first_timestamp == first);
+    CHECK(value->last_timestamp == first + 300);
+
+    // without a deadband every window goes out
+    CHECK(publish_window(&channel, 3.0f, &measurement));
+    CHECK(publish_window(&channel, 3.0f, &measurement));
+    CHECK(channel.total_suppressed == 0);
+}
+
+static void test_deadband_absolute(void)
+{
+    static const channel_config_t config = {.type = "absolute", .deadband_absolute = 0.5f};
+    channel_t channel;
+    measurement_t measurement;
+    CHECK(channel_init(&channel, &config) == ESP_OK);
+
+    // the first window always reports
+    CHECK(publish_window(&channel, 20.0f, &measurement));
+
+    // changes are measured against the last published value, not the last window
+    CHECK(!publish_window(&channel, 20.3f, &measurement));
+    CHECK(!publish_window(&channel, 19.6f, &measurement));
+    CHECK(!publish_window(&channel, 20.5f, &measurement));
+    CHECK(channel.suppressed == 3);
+
+    CHECK(publish_window(&channel, 20.6f, &measurement));
+    CHECK_NEAR(measurement.values[0].value, 20.6, 1e-5);
+    CHECK(measurement.values[0].suppressed == 3);
+    CHECK(channel.suppressed == 0);
+    CHECK(channel.total_suppressed == 3);
+
+    CHECK(publish_window(&channel, 20.0f, &measurement));
+    CHECK(measurement.values[0].suppressed == 0);
+}
+
+static void test_deadband_relative(void)
+{
+    static const channel_config_t config = {.type = "relative", .deadband_relative = 0.01f};
+    channel_t channel;
+    measurement_t measurement;
+    CHECK(channel_init(&channel, &config) == ESP_OK);
+
+    CHECK(publish_window(&channel, 100.0f, &measurement));
+    CHECK(!publish_window(&channel, 100.9f, &measurement));
+    CHECK(!publish_window(&channel, 99.1f, &measurement));
+    CHECK(publish_window(&channel, 101.5f, &measurement));
+
+    // the band scales with the value
+    CHECK(!publish_window(&channel, 102.5f, &measurement));
+    CHECK(publish_window(&channel, 100.0f, &measurement));
+}
+
+static void test_heartbeat(void)
+{
+    static const channel_config_t config = {.type = "heartbeat", .deadband_absolute = 1.0f, .heartbeat_interval = 60000};
+    channel_t channel;
+    measurement_t measurement;
+    CHECK(channel_init(&channel, &config) == ESP_OK);
+
+    CHECK(publish_window(&channel, 5.0f, &measurement));
+    uint32_t published = fake_time;
+
+    // a steady value stays quiet until the interval since the last upload passed
+    fake_time = published + 30000;
+    CHECK(!publish_window(&channel, 5.0f, &measurement));
+    fake_time = published + 60000 - 30;
+    CHECK(!publish_window(&channel, 5.0f, &measurement));
+    CHECK(publish_window(&channel, 5.0f, &measurement));
+    CHECK(measurement.values[0].suppressed == 2);
+    published = fake_time;
+
+    // a report by exception restarts the interval
+    fake_time = published + 50000;
+    CHECK(publish_window(&channel, 7.0f, &measurement));
+    published = fake_time;
+    fake_time = published + 50000;
+    CHECK(!publish_window(&channel, 7.0f, &measurement));
+
+    // empty windows never send a heartbeat
+    fake_time = published + 120000;
+    CHECK(channel_publish(&channel) == ESP_ERR_NOT_FOUND);
+    CHECK(uxQueueMessagesWaiting(xMeasurementQueue) == 0);
+}
+
+static void test_group(void)
+{
+    static const channel_config_t quiet_config = {.type = "quiet", .deadband_absolute = 1.0f};
+    static const channel_config_t loud_config = {.type = "loud", .deadband_absolute = 1.0f};
+    channel_t quiet, loud;
+    channel_t *const group[] = {&quiet, &loud};
+    measurement_t measurement;
+    CHECK(channel_init(&quiet, &quiet_config) == ESP_OK);
+    CHECK(channel_init(&loud, &loud_config) == ESP_OK);
+
+    channel_update(&quiet, 1.0f);
+    channel_update(&loud, 1.0f);
+    CHECK(channel_publish_group(group, 2) == ESP_OK);
+    CHECK(xQueueReceive(xMeasurementQueue, &measurement, 0) == pdPASS);
+    CHECK(measurement.count == 2);
+
+    // only the channel that moved is in the record
+    channel_update(&quiet, 1.5f);
+    channel_update(&loud, 3.0f);
+    CHECK(channel_publish_group(group, 2) == ESP_OK);
+    CHECK(xQueueReceive(xMeasurementQueue, &measurement, 0) == pdPASS);
+    CHECK(measurement.count == 1);
+    CHECK(strcmp(measurement.values[0].type, "loud") == 0);
+
+    // everything suppressed sends nothing but is not an error
+    channel_update(&quiet, 1.2f);
+    channel_update(&loud, 3.2f);
+    CHECK(channel_publish_group(group, 2) == ESP_OK);
+    CHECK(uxQueueMessagesWaiting(xMeasurementQueue) == 0);
+
+    CHECK(channel_publish_group(group, 0) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void)
+{
+    xMeasurementQueue = xQueueCreate(4, sizeof(measurement_t));
+    CHECK(xMeasurementQueue != NULL);
+
+    test_summary();
+    test_deadband_absolute();
+    test_deadband_relative();
+    test_heartbeat();
+    test_group();
+    printf("channel: ok\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "test.h"
+#include "decimator.h"
+
+#define PI 3.14159265358979
+
+// magnitude of the order N, ratio R cic at f cycles per input sample
+static double cic_response(uint8_t order, uint16_t ratio, double f)
+{
+    double h = sin(PI * f * ratio) / (ratio * sin(PI * f));
+    return pow(fabs(h), order);
+}
+
+static void test_config(void)
+{
+    decimator_t dec;
+    CHECK(decimator_init(&dec, 0, 10) == ESP_ERR_INVALID_ARG);
+    CHECK(decimator_init(&dec, DECIMATOR_MAX_ORDER + 1, 10) == ESP_ERR_INVALID_ARG);
+    CHECK(decimator_init(&dec, 2, 0) == ESP_ERR_INVALID_ARG);
+    // 4 * log2(1024) = 40 bits of growth do not fit
+    CHECK(decimator_init(&dec, 4, 1024) == ESP_ERR_INVALID_ARG);
+    CHECK(decimator_init(&dec, 3, 1024) == ESP_OK);
+}
+
+static void test_dc(uint8_t order, uint16_t ratio)
+{
+    decimator_t dec;
+    CHECK(decimator_init(&dec, order, ratio) == ESP_OK);
+
+    int outputs = 0;
+    for (int i = 0; i < 100 * ratio; i++)
+    {
+        float out;
+        if (decimator_push(&dec, -21.375f, &out))
+        {
+            // unity gain and no start-up transient
+            CHECK(out == -21.375f);
+            outputs++;
+        }
+    }
+    CHECK(outputs == 100 - order);
+}
+
+// amplitude of a sine after decimation compared with the closed form response
+static void test_response(uint8_t order, uint16_t ratio, double f)
+{
+    const double amplitude = 10.0;
+    const double offset = 25.0;
+    const int samples = 20000 * ratio;
+
+    decimator_t dec;
+    CHECK(decimator_init(&dec, order, ratio) == ESP_OK);
+
+    double sum = 0.0, sum_squares = 0.0;
+    int outputs = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        float out;
+        if (decimator_push(&dec, (float)(offset + amplitude * sin(2.0 * PI * f * i)), &out))
+        {
+            sum += out;
+            sum_squares += (double)out * out;
+            outputs++;
+        }
+    }
+
+    double mean = sum / outputs;
+    double measured = sqrt(2.0 * (sum_squares / outputs - mean * mean)) / amplitude;
+    double expected = cic_response(order, ratio, f);
+
+    CHECK_NEAR(mean, offset, 0.01);
+    CHECK_NEAR(measured, expected, 0.01 + 0.02 * expected);
+}
+
+int main(void)
+{
+    static const struct
+    {
+        uint8_t order;
+        uint16_t ratio;
+    } configs[] = {{1, 10}, {2, 5}, {2, 20}, {3, 10}, {4, 16}};
+    // passband, transition and aliasing bands, chosen to avoid a whole or half cycle per output
+    static const double frequencies[] = {0.0013, 0.0171, 0.0437, 0.0913, 0.2371};
+
+    test_config();
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++)
+    {
+        test_dc(configs[c].order, configs[c].ratio);
+        for (size_t f = 0; f < sizeof(frequencies) / sizeof(frequencies[0]); f++)
+        {
+            test_response(configs[c].order, configs[c].ratio, frequencies[f]);
+        }
+        // first null of the response
+        test_response(configs[c].order, configs[c].ratio, 1.0 / configs[c].ratio);
+    }
+
+    printf("decimator: ok\n");
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "i2c_user.h"
+
+// stands in for components/i2c_user/i2c_trace.txt, which the firmware build embeds under this symbol
+const char host_trace[] asm("_binary_i2c_trace_txt_start") =
+    "I (1021) I2C_TRACE: @44 w:2737 r: e:0\n"
+    "I (1022) I2C_TRACE: @27 w:00 r:feff e:0\n"
+    "I (1130) I2C_TRACE: @44 w:e000 r: e:0\n"
+    "I (1131) I2C_TRACE: @44 w: r:6a1e4c7ffdae e:0\n"
+    "garbage without a record\n"
+    "I (1140) I2C_TRACE: @44 w:e000 r: e:0\n"
+    "I (1141) I2C_TRACE: @44 w: r: e:103\n"
+    "I (1150) I2C_TRACE: @27 w:02 r: e:0\n";
+
+int main(void)
+{
+    i2c_user_device_t *sht3x_dev;
+    i2c_user_device_t *cat_dev;
+    CHECK(i2c_init() == ESP_OK);
+    CHECK(i2c_user_add_device(0x44, 400000, &sht3x_dev) == ESP_OK);
+    CHECK(i2c_user_add_device(0x27, 400000, &cat_dev) == ESP_OK);
+
+    // records of the other device are skipped, not consumed
+    uint8_t rx[6];
+    const uint8_t read_inputs[] = {0x00};
+    CHECK(i2c_user_transfer(cat_dev, read_inputs, 1, rx, 2, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(rx[0] == 0xfe && rx[1] == 0xff);
+
+    const uint8_t start_periodic[] = {0x27, 0x37};
+    const uint8_t fetch[] = {0xe0, 0x00};
+    const uint8_t expected[] = {0x6a, 0x1e, 0x4c, 0x7f, 0xfd, 0xae};
+    CHECK(i2c_user_transfer(sht3x_dev, start_periodic, 2, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(i2c_user_transfer(sht3x_dev, fetch, 2, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(i2c_user_transfer(sht3x_dev, NULL, 0, rx, 6, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(memcmp(rx, expected, sizeof(expected)) == 0);
+
+    // recorded errors are returned as they happened
+    CHECK(i2c_user_transfer(sht3x_dev, fetch, 2, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(i2c_user_transfer(sht3x_dev, NULL, 0, rx, 6, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_ERR_INVALID_STATE);
+    CHECK(i2c_user_transfer(sht3x_dev, fetch, 2, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_FAIL);
+
+    // anything else than the recorded transaction is a divergence
+    const uint8_t write_outputs[] = {0x03};
+    CHECK(i2c_user_transfer(cat_dev, write_outputs, 1, NULL, 0, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_ERR_INVALID_RESPONSE);
+
+    printf("i2c replay: ok\n");
+    return 0;
+}
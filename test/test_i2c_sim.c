@@ -0,0 +1,328 @@
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "test.h"
+#include "esp_timer.h"
+#include "i2c_user.h"
+#include "i2c/sim.h"
+#include "sht3x.h"
+#include "scd4x.h"
+
+#define CAT9555_ADDRESS 0b0100111
+#define SCL_SPEED_HZ 400000
+
+#define THROUGHPUT_TRANSACTIONS 4000
+#define CRC_FETCHES 2000
+#define CRC_ERROR_RATE 0.1f
+
+static i2c_user_device_t *cat_dev;
+static sht3x_device_t sht3x_dev;
+static scd4x_device_t scd4x_dev;
+static atomic_uint completed = 0;
+static atomic_uint failed = 0;
+
+static void count_completion(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx)
+{
+    (void)rx;
+    (void)rx_len;
+    (void)ctx;
+    if (err != ESP_OK)
+    {
+        atomic_fetch_add(&failed, 1);
+    }
+    atomic_fetch_add(&completed, 1);
+}
+
+// everything queued before has been executed once a blocking transfer returns
+static void wait_for_bus(void)
+{
+    uint8_t reg = 0x00;
+    uint8_t rx[2];
+    CHECK(i2c_user_transfer(cat_dev, &reg, 1, rx, 2, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+}
+
+// back to back reads of both cat9555 input ports, the bus has to be the bottleneck
+static void test_throughput(void)
+{
+    i2c_user_stats_t stats;
+    i2c_user_get_stats(&stats);
+
+    i2c_user_transaction_t transaction = {
+        .dev = cat_dev,
+        .tx = {0x00},
+        .tx_len = 1,
+        .rx_len = 2,
+        .callback = count_completion,
+    };
+
+    double start = now_seconds();
+    for (unsigned submitted = 0; submitted < THROUGHPUT_TRANSACTIONS; submitted++)
+    {
+        // stay below the queue length so that nothing is dropped, sleeping leaves the cpu to the bus task
+        while (submitted - atomic_load(&completed) >= I2C_USER_QUEUE_LENGTH)
+        {
+            vTaskDelay(1);
+        }
+        CHECK(i2c_user_submit(&transaction) == ESP_OK);
+    }
+    while (atomic_load(&completed) < THROUGHPUT_TRANSACTIONS)
+    {
+        vTaskDelay(1);
+    }
+    double elapsed = now_seconds() - start;
+
+    i2c_user_get_stats(&stats);
+    CHECK(stats.transactions == THROUGHPUT_TRANSACTIONS);
+    CHECK(stats.errors == 0);
+    CHECK(stats.dropped == 0);
+    CHECK(atomic_load(&failed) == 0);
+
+    // address, register, address and two data bytes at 9 clocks each
+    double bus_us = 5 * 9 * 1e6 / SCL_SPEED_HZ;
+    double rate = THROUGHPUT_TRANSACTIONS / elapsed;
+    printf("throughput: %.0f transactions/s, bus limit %.0f, utilization %.2f, latency avg %lu us max %lu us\n",
+           rate, 1e6 / bus_us, stats.utilization, (unsigned long)stats.latency_avg_us, (unsigned long)stats.latency_max_us);
+
+    // the sim rounds the bus time down to whole microseconds
+    CHECK(elapsed >= THROUGHPUT_TRANSACTIONS * (int)bus_us * 1e-6);
+    CHECK(rate > 0.5 * 1e6 / bus_us);
+    CHECK(stats.utilization > 0.5f && stats.utilization <= 1.0f);
+    CHECK(stats.latency_max_us >= stats.latency_avg_us && stats.latency_avg_us >= bus_us);
+}
+
+// a full queue rejects submissions immediately and counts them as dropped
+static void test_dropped(void)
+{
+    i2c_user_stats_t stats;
+    i2c_user_get_stats(&stats);
+
+    i2c_user_transaction_t transaction = {
+        .dev = cat_dev,
+        .tx = {0x00},
+        .tx_len = 1,
+        .rx_len = 2,
+        .callback = count_completion,
+    };
+
+    atomic_store(&completed, 0);
+    uint32_t rejected = 0;
+    for (int i = 0; i < 4 * I2C_USER_QUEUE_LENGTH; i++)
+    {
+        if (i2c_user_submit(&transaction) == ESP_ERR_NO_MEM)
+        {
+            rejected++;
+        }
+    }
+    while (atomic_load(&completed) < 4 * I2C_USER_QUEUE_LENGTH - rejected)
+    {
+        vTaskDelay(1);
+    }
+
+    i2c_user_get_stats(&stats);
+    CHECK(rejected > 0);
+    CHECK(stats.dropped == rejected);
+    CHECK(stats.transactions == 4 * I2C_USER_QUEUE_LENGTH - rejected);
+
+    transaction.tx_len = 0;
+    transaction.rx_len = 0;
+    CHECK(i2c_user_submit(&transaction) == ESP_ERR_INVALID_ARG);
+    transaction.rx_len = I2C_USER_MAX_RX + 1;
+    CHECK(i2c_user_submit(&transaction) == ESP_ERR_INVALID_ARG);
+}
+
+#define CHAIN_SUBMITTERS 2
+#define CHAIN_LENGTH 3
+#define CHAINS_PER_SUBMITTER 200
+
+// completion order of the chained steps, the chain id of each step in the order the bus ran it
+static uintptr_t chain_log[CHAIN_SUBMITTERS * CHAINS_PER_SUBMITTER * CHAIN_LENGTH];
+static atomic_uint chain_logged = 0;
+static atomic_uint chain_submitters_done = 0;
+static atomic_uint chain_steps_done[CHAIN_SUBMITTERS];
+
+static void log_chain_step(esp_err_t err, const uint8_t *rx, size_t rx_len, void *ctx)
+{
+    chain_log[atomic_fetch_add(&chain_logged, 1)] = (uintptr_t)ctx;
+    atomic_fetch_add(&chain_steps_done[(uintptr_t)ctx / CHAINS_PER_SUBMITTER], 1);
+}
+
+static void chain_submitter(void *arg)
+{
+    uintptr_t first_id = (uintptr_t)arg;
+    for (uintptr_t id = first_id; id < first_id + CHAINS_PER_SUBMITTER; id++)
+    {
+        i2c_user_transaction_t steps[CHAIN_LENGTH];
+        for (int i = 0; i < CHAIN_LENGTH; i++)
+        {
+            steps[i] = (i2c_user_transaction_t){
+                .dev = cat_dev,
+                .tx = {0x00},
+                .tx_len = 1,
+                .rx_len = 2,
+                .callback = log_chain_step,
+                .ctx = (void *)id,
+            };
+        }
+        // a few chains in flight per submitter, together they stay below the queue length
+        while (id - first_id - atomic_load(&chain_steps_done[first_id / CHAINS_PER_SUBMITTER]) / CHAIN_LENGTH >=
+               I2C_USER_QUEUE_LENGTH / (2 * CHAIN_SUBMITTERS))
+        {
+            vTaskDelay(1);
+        }
+        CHECK(i2c_user_submit_chain(steps, CHAIN_LENGTH) == ESP_OK);
+    }
+    atomic_fetch_add(&chain_submitters_done, 1);
+}
+
+// chains from concurrent tasks never interleave on the bus
+static void test_chains(void)
+{
+    i2c_user_transaction_t steps[I2C_USER_MAX_CHAIN + 1] = {0};
+    CHECK(i2c_user_submit_chain(steps, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(i2c_user_submit_chain(steps, I2C_USER_MAX_CHAIN + 1) == ESP_ERR_INVALID_ARG);
+    // an invalid step rejects the whole chain
+    steps[0] = (i2c_user_transaction_t){.dev = cat_dev, .tx = {0x00}, .tx_len = 1};
+    CHECK(i2c_user_submit_chain(steps, 2) == ESP_ERR_INVALID_ARG);
+
+    for (uintptr_t s = 0; s < CHAIN_SUBMITTERS; s++)
+    {
+        CHECK(xTaskCreate(chain_submitter, "chains", 4096, (void *)(s * CHAINS_PER_SUBMITTER), 1, NULL) == pdPASS);
+    }
+    unsigned total = CHAIN_SUBMITTERS * CHAINS_PER_SUBMITTER * CHAIN_LENGTH;
+    while (atomic_load(&chain_submitters_done) < CHAIN_SUBMITTERS || atomic_load(&chain_logged) < total)
+    {
+        vTaskDelay(1);
+    }
+
+    for (unsigned i = 0; i < total; i += CHAIN_LENGTH)
+    {
+        for (unsigned j = 1; j < CHAIN_LENGTH; j++)
+        {
+            CHECK(chain_log[i + j] == chain_log[i]);
+        }
+    }
+}
+
+// post-command delays hold the bus, a blocking transfer gives up after its timeout and the bus cleans up
+static void test_transfer_timeout(void)
+{
+    i2c_user_transaction_t steps[I2C_USER_MAX_CHAIN];
+    for (int i = 0; i < I2C_USER_MAX_CHAIN; i++)
+    {
+        steps[i] = (i2c_user_transaction_t){.dev = cat_dev, .tx = {0x00}, .tx_len = 1, .rx_len = 2, .delay_us = 20000};
+    }
+
+    uint8_t rx[2];
+    double start = now_seconds();
+    CHECK(i2c_user_transfer_chain(steps, 2, rx, 2, I2C_USER_TRANSFER_TIMEOUT_MS) == ESP_OK);
+    CHECK(now_seconds() - start >= 0.04);
+
+    start = now_seconds();
+    CHECK(i2c_user_transfer_chain(steps, I2C_USER_MAX_CHAIN, rx, 2, 30) == ESP_ERR_TIMEOUT);
+    CHECK(now_seconds() - start < 0.09);
+
+    // queued behind the abandoned chain, returns once it ran to the end
+    wait_for_bus();
+    CHECK(now_seconds() - start >= 0.1);
+}
+
+// every periodic fetch either delivers a measurement or counts a crc error
+static void test_crc_errors(void)
+{
+    CHECK(sht3x_init(&sht3x_dev, address_A) == ESP_OK);
+    CHECK(sht3x_start_periodic(&sht3x_dev, PERIODIC_TEN_MPS_HIGH_RELIABILITY) == ESP_OK);
+    sim_sht3x_set_environment(21.0f, 40.0f, 0.0f);
+    sim_sht3x_set_crc_error_rate(CRC_ERROR_RATE);
+
+    i2c_user_stats_t stats;
+    i2c_user_get_stats(&stats);
+
+    uint32_t received = 0;
+    for (int i = 0; i <= CRC_FETCHES; i++)
+    {
+        if (i == CRC_FETCHES)
+        {
+            // the last call only collects, its own fetch comes too early and is not counted
+            i2c_user_get_stats(&stats);
+            CHECK(stats.errors == 0);
+        }
+        else
+        {
+            // skip ahead one measurement period so that the queued fetch finds a new result
+            host_timer_advance(100000);
+        }
+
+        sht3x_measurement_t measurements[SHT3X_RESULT_QUEUE_LENGTH];
+        uint8_t fetched;
+        esp_err_t err = sht3x_read_measurements(&sht3x_dev, measurements, SHT3X_RESULT_QUEUE_LENGTH, &fetched);
+        CHECK(err == ESP_OK || err == ESP_ERR_NOT_FOUND);
+        wait_for_bus();
+
+        for (uint8_t m = 0; m < fetched; m++)
+        {
+            CHECK_NEAR(measurements[m].temperature_degC, 21.0, 0.01);
+            CHECK_NEAR(measurements[m].relative_humidity, 40.0, 0.01);
+        }
+        received += fetched;
+    }
+
+    // a measurement is lost if either of its two words is corrupted
+    double expected = CRC_FETCHES * (1.0 - (1.0 - CRC_ERROR_RATE) * (1.0 - CRC_ERROR_RATE));
+    printf("crc errors: %lu of %d fetches, expected %.0f\n", (unsigned long)sht3x_dev.crc_errors, CRC_FETCHES, expected);
+    CHECK(received + sht3x_dev.crc_errors == CRC_FETCHES);
+    CHECK_NEAR(sht3x_dev.crc_errors, expected, 0.2 * expected);
+
+    sim_sht3x_set_crc_error_rate(0.0f);
+}
+
+// waiting for a co2 result sleeps until it is due instead of polling the bus
+static void test_scd4x_wait(void)
+{
+    CHECK(scd4x_init(&scd4x_dev) == ESP_OK);
+    CHECK(scd4x_start_periodic(&scd4x_dev) == ESP_OK);
+    sim_scd4x_set_environment(800.0f, 0.0f);
+
+    i2c_user_stats_t stats;
+    i2c_user_get_stats(&stats);
+
+    scd4x_measurement_t measurement;
+    double start = now_seconds();
+    CHECK(scd4x_wait(&scd4x_dev, &measurement, 200) == ESP_ERR_NOT_FOUND);
+    CHECK(now_seconds() - start >= 0.19);
+
+    // nothing is due yet, so the wait did not touch the bus
+    i2c_user_get_stats(&stats);
+    CHECK(stats.transactions == 0);
+
+    // one data-ready check, then the read of the result
+    host_timer_advance(SCD4X_PERIOD_MS * 1000LL);
+    CHECK(scd4x_wait(&scd4x_dev, &measurement, 1000) == ESP_OK);
+    CHECK(measurement.co2_ppm == 800);
+
+    i2c_user_get_stats(&stats);
+    CHECK(stats.transactions == 4);
+    CHECK(stats.errors == 0);
+    CHECK(scd4x_dev.crc_errors == 0);
+}
+
+int main(void)
+{
+    CHECK(i2c_init() == ESP_OK);
+    CHECK(i2c_user_add_device(CAT9555_ADDRESS, SCL_SPEED_HZ, &cat_dev) == ESP_OK);
+
+    i2c_user_device_t *missing;
+    CHECK(i2c_user_add_device(0x10, SCL_SPEED_HZ, &missing) == ESP_ERR_NOT_FOUND);
+
+    test_throughput();
+    test_dropped();
+    test_chains();
+    test_transfer_timeout();
+    test_crc_errors();
+    test_scd4x_wait();
+
+    printf("i2c sim: ok\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "image_stats.h"
+
+// the 1/8 scale preview of a uxga frame
+#define WIDTH 200
+#define HEIGHT 150
+
+static uint8_t image[WIDTH * HEIGHT * 2];
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+static void set_pixel(uint16_t x, uint16_t y, uint8_t r, uint8_t g, uint8_t b)
+{
+    uint16_t rgb = ((uint16_t)r << 11) | ((uint16_t)g << 5) | b;
+    image[((size_t)y * WIDTH + x) * 2] = rgb >> 8;
+    image[((size_t)y * WIDTH + x) * 2 + 1] = rgb & 0xff;
+}
+
+static void fill_random(void)
+{
+    for (uint16_t y = 0; y < HEIGHT; y++)
+    {
+        for (uint16_t x = 0; x < WIDTH; x++)
+        {
+            set_pixel(x, y, next_random() % 32, next_random() % 64, next_random() % 32);
+        }
+    }
+}
+
+// luma ramp along the rows, rising or falling
+static void fill_ramp(int rising)
+{
+    for (uint16_t y = 0; y < HEIGHT; y++)
+    {
+        for (uint16_t x = 0; x < WIDTH; x++)
+        {
+            uint16_t level = (rising ? x : WIDTH - 1 - x) * 32 / WIDTH;
+            set_pixel(x, y, level, level * 2, level);
+        }
+    }
+}
+
+static void test_roi_bounds(void)
+{
+    image_stats_t stats;
+    image_roi_t empty = {.x = 0, .y = 0, .width = 0, .height = 10};
+    image_roi_t right = {.x = 150, .y = 0, .width = 51, .height = 10};
+    image_roi_t bottom = {.x = 0, .y = 100, .width = 10, .height = 51};
+    image_roi_t all = {.x = 0, .y = 0, .width = WIDTH, .height = HEIGHT};
+
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &empty, &stats) == ESP_ERR_INVALID_ARG);
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &right, &stats) == ESP_ERR_INVALID_ARG);
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &bottom, &stats) == ESP_ERR_INVALID_ARG);
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &all, &stats) == ESP_OK);
+}
+
+// the kernel against a per pixel reference over an off center roi
+static void test_stats_reference(void)
+{
+    fill_random();
+    image_roi_t roi = {.x = 37, .y = 21, .width = 100, .height = 110};
+
+    uint32_t histogram_r[IMAGE_HISTOGRAM_BINS] = {0};
+    uint32_t histogram_g[IMAGE_HISTOGRAM_BINS] = {0};
+    uint32_t histogram_b[IMAGE_HISTOGRAM_BINS] = {0};
+    double sum_r = 0.0, sum_g = 0.0, sum_b = 0.0;
+    for (uint16_t y = roi.y; y < roi.y + roi.height; y++)
+    {
+        for (uint16_t x = roi.x; x < roi.x + roi.width; x++)
+        {
+            uint16_t rgb = ((uint16_t)image[((size_t)y * WIDTH + x) * 2] << 8) | image[((size_t)y * WIDTH + x) * 2 + 1];
+            unsigned r = rgb >> 11, g = (rgb >> 5) & 0x3f, b = rgb & 0x1f;
+            sum_r += r / 31.0;
+            sum_g += g / 63.0;
+            sum_b += b / 31.0;
+            histogram_r[r * IMAGE_HISTOGRAM_BINS / 32]++;
+            histogram_g[g * IMAGE_HISTOGRAM_BINS / 64]++;
+            histogram_b[b * IMAGE_HISTOGRAM_BINS / 32]++;
+        }
+    }
+    double pixels = (double)roi.width * roi.height;
+
+    image_stats_t stats;
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &roi, &stats) == ESP_OK);
+    CHECK(stats.pixels == roi.width * roi.height);
+    CHECK_NEAR(stats.mean_r, sum_r / pixels, 1e-5);
+    CHECK_NEAR(stats.mean_g, sum_g / pixels, 1e-5);
+    CHECK_NEAR(stats.mean_b, sum_b / pixels, 1e-5);
+    CHECK_NEAR(stats.green_red_ratio, sum_g / sum_r, 1e-4);
+    CHECK_NEAR(stats.biomass_index, (2.0 * sum_g - sum_r - sum_b) / (sum_r + sum_g + sum_b), 1e-4);
+    CHECK(memcmp(stats.histogram_r, histogram_r, sizeof(histogram_r)) == 0);
+    CHECK(memcmp(stats.histogram_g, histogram_g, sizeof(histogram_g)) == 0);
+    CHECK(memcmp(stats.histogram_b, histogram_b, sizeof(histogram_b)) == 0);
+}
+
+static void test_stats_black(void)
+{
+    memset(image, 0, sizeof(image));
+    image_roi_t all = {.x = 0, .y = 0, .width = WIDTH, .height = HEIGHT};
+
+    image_stats_t stats;
+    CHECK(image_stats_rgb565(image, WIDTH, HEIGHT, &all, &stats) == ESP_OK);
+    CHECK(stats.mean_r == 0.0f && stats.mean_g == 0.0f && stats.mean_b == 0.0f);
+    CHECK(stats.green_red_ratio == 0.0f);
+    CHECK(stats.biomass_index == 0.0f);
+    CHECK(stats.histogram_r[0] == WIDTH * HEIGHT);
+}
+
+static void test_dhash(void)
+{
+    fill_ramp(1);
+    CHECK(image_dhash_rgb565(image, WIDTH, HEIGHT) == UINT64_MAX);
+    fill_ramp(0);
+    CHECK(image_dhash_rgb565(image, WIDTH, HEIGHT) == 0);
+
+    // 200 columns do not split evenly into 9 blocks, a flat scene still has no gradient
+    for (uint16_t y = 0; y < HEIGHT; y++)
+    {
+        for (uint16_t x = 0; x < WIDTH; x++)
+        {
+            set_pixel(x, y, 12, 40, 20);
+        }
+    }
+    CHECK(image_dhash_rgb565(image, WIDTH, HEIGHT) == 0);
+
+    // sensor noise of one lsb moves only a few bits of an unchanged scene
+    fill_random();
+    uint64_t reference = image_dhash_rgb565(image, WIDTH, HEIGHT);
+    for (size_t i = 1; i < sizeof(image); i += 2)
+    {
+        image[i] ^= next_random() & 1;
+    }
+    CHECK(__builtin_popcountll(reference ^ image_dhash_rgb565(image, WIDTH, HEIGHT)) <= 8);
+}
+
+int main(void)
+{
+    test_roi_bounds();
+    test_stats_reference();
+    test_stats_black();
+    test_dhash();
+    printf("image stats: ok\n");
+    return 0;
+}
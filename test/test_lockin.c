@@ -0,0 +1,148 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "test.h"
+#include "lockin.h"
+
+// matches the od acquisition: 8 kHz sampling and the emitter toggled at 500 Hz
+#define SAMPLE_RATE 8000
+#define PERIOD 16
+#define MAX_WINDOW (SAMPLE_RATE / 2)
+
+#define SIGNAL_COUNTS 100.0
+#define AMBIENT_COUNTS 300.0
+#define NOISE_COUNTS 20.0
+#define TRIALS 200
+
+static uint32_t seed = 1;
+
+static double next_uniform(void)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return ((seed >> 8) + 0.5) / 16777216.0;
+}
+
+static double next_gaussian(void)
+{
+    return sqrt(-2.0 * log(next_uniform())) * cos(2.0 * M_PI * next_uniform());
+}
+
+static int16_t clip(double value)
+{
+    return (int16_t)fmax(-32768.0, fmin(32767.0, round(value)));
+}
+
+// photodiode counts: the emitter square wave on top of mains flicker and noise
+static void acquire(int16_t *samples, size_t count, double ambient_hz, double noise)
+{
+    double ambient_phase = 2.0 * M_PI * next_uniform();
+    for (size_t n = 0; n < count; n++)
+    {
+        double led = ((n % PERIOD) < PERIOD / 2) ? SIGNAL_COUNTS : 0.0;
+        double ambient = AMBIENT_COUNTS * (1.0 + sin(2.0 * M_PI * ambient_hz * n / SAMPLE_RATE + ambient_phase));
+        samples[n] = clip(led + ambient + noise * next_gaussian());
+    }
+}
+
+static void test_config(void)
+{
+    lockin_t lockin;
+    CHECK(lockin_init(&lockin, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(lockin_init(&lockin, 15) == ESP_ERR_INVALID_ARG);
+    CHECK(lockin_init(&lockin, LOCKIN_MAX_PERIOD + 2) == ESP_ERR_INVALID_ARG);
+    CHECK(lockin_init(&lockin, PERIOD) == ESP_OK);
+
+    // partial periods are not evaluated
+    lockin_result_t result;
+    int16_t samples[PERIOD + 1] = {0};
+    CHECK(!lockin_result(&lockin, &result));
+    lockin_push(&lockin, samples, PERIOD + 1);
+    CHECK(!lockin_result(&lockin, &result));
+}
+
+static void test_sine(void)
+{
+    static int16_t samples[64 * PERIOD];
+    lockin_t lockin;
+    CHECK(lockin_init(&lockin, PERIOD) == ESP_OK);
+
+    // amplitude and phase of a clean sine on a large offset
+    for (size_t n = 0; n < 64 * PERIOD; n++)
+    {
+        samples[n] = clip(2000.0 + 1000.0 * sin(2.0 * M_PI * n / PERIOD + 0.5));
+    }
+    lockin_push(&lockin, samples, 64 * PERIOD);
+
+    lockin_result_t result;
+    CHECK(lockin_result(&lockin, &result));
+    CHECK(result.periods == 64);
+    CHECK_NEAR(result.amplitude, 1000.0, 1.0);
+    CHECK_NEAR(result.phase, 0.5, 0.002);
+    CHECK_NEAR(result.dc, 2000.0, 0.01);
+}
+
+static void test_square(void)
+{
+    static int16_t samples[800];
+    lockin_t lockin;
+    CHECK(lockin_init(&lockin, PERIOD) == ESP_OK);
+
+    // fundamental of a 0 / 100 square wave is 4 / pi * 50, mains flicker over whole periods cancels
+    const double ambient_hz[] = {0.0, 50.0, 60.0};
+    for (size_t i = 0; i < sizeof(ambient_hz) / sizeof(ambient_hz[0]); i++)
+    {
+        acquire(samples, 800, ambient_hz[i], 0.0);
+        lockin_reset(&lockin);
+        lockin_push(&lockin, samples, 800);
+
+        lockin_result_t result;
+        CHECK(lockin_result(&lockin, &result));
+        CHECK_NEAR(result.amplitude, 4.0 / M_PI * SIGNAL_COUNTS / 2.0, 0.5);
+    }
+}
+
+// amplitude snr over repeated acquisitions, has to grow with the window length
+static double snr_db(size_t window)
+{
+    static int16_t samples[MAX_WINDOW];
+    lockin_t lockin;
+    CHECK(lockin_init(&lockin, PERIOD) == ESP_OK);
+
+    double sum = 0.0, sum_squares = 0.0;
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        acquire(samples, window, 50.0, NOISE_COUNTS);
+        lockin_reset(&lockin);
+        lockin_push(&lockin, samples, window);
+
+        lockin_result_t result;
+        CHECK(lockin_result(&lockin, &result));
+        sum += result.amplitude;
+        sum_squares += (double)result.amplitude * result.amplitude;
+    }
+
+    double mean = sum / TRIALS;
+    double deviation = sqrt(sum_squares / TRIALS - mean * mean);
+    return 20.0 * log10(mean / deviation);
+}
+
+int main(void)
+{
+    test_config();
+    test_sine();
+    test_square();
+
+    // 100, 200 and 500 ms windows
+    double snr_100 = snr_db(SAMPLE_RATE / 10);
+    double snr_200 = snr_db(SAMPLE_RATE / 5);
+    double snr_500 = snr_db(SAMPLE_RATE / 2);
+    printf("snr: %.1f dB at 100 ms, %.1f dB at 200 ms, %.1f dB at 500 ms\n", snr_100, snr_200, snr_500);
+
+    CHECK(snr_100 > 30.0);
+    CHECK(snr_200 > snr_100 && snr_500 > snr_200);
+    // white noise averages down with the square root of the window
+    CHECK_NEAR(snr_500 - snr_100, 10.0 * log10(5.0), 2.0);
+
+    printf("lockin: ok\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "test.h"
+#include "median_filter.h"
+
+static uint32_t seed = 1;
+
+static float next_value(void)
+{
+    seed = seed * 1664525u + 1013904223u;
+    // quantised so that the window holds plenty of equal values
+    return (float)((seed >> 16) % 64) * 0.5f - 16.0f;
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static float sorted_median(const float *history, size_t count, uint16_t size, float *scratch)
+{
+    size_t n = count < size ? count : size;
+    memcpy(scratch, history + count - n, n * sizeof(float));
+    qsort(scratch, n, sizeof(float), compare_float);
+    return (n % 2) ? scratch[n / 2] : (scratch[n / 2 - 1] + scratch[n / 2]) / 2.0f;
+}
+
+static void test_against_sort(uint16_t size)
+{
+    const size_t pushes = 3 * (size_t)size + 64;
+    float *history = malloc(pushes * sizeof(float));
+    float *scratch = malloc(size * sizeof(float));
+    CHECK(history != NULL && scratch != NULL);
+
+    rolling_median_t rm;
+    CHECK(rolling_median_init(&rm, size) == ESP_OK);
+    CHECK(isnan(rolling_median_get(&rm)));
+
+    for (size_t i = 0; i < pushes; i++)
+    {
+        history[i] = next_value();
+        rolling_median_push(&rm, history[i]);
+        CHECK(rolling_median_get(&rm) == sorted_median(history, i + 1, size, scratch));
+    }
+
+    rolling_median_free(&rm);
+    free(history);
+    free(scratch);
+}
+
+static void test_monotonic(uint16_t size)
+{
+    // strictly rising and falling inputs always evict from the same heap
+    rolling_median_t rm;
+    CHECK(rolling_median_init(&rm, size) == ESP_OK);
+
+    for (int i = 0; i < 4 * size; i++)
+    {
+        rolling_median_push(&rm, (float)i);
+    }
+    CHECK_NEAR(rolling_median_get(&rm), 4 * size - 1 - (size - 1) / 2.0, 1e-3);
+
+    for (int i = 4 * size; i > 0; i--)
+    {
+        rolling_median_push(&rm, (float)i);
+    }
+    CHECK_NEAR(rolling_median_get(&rm), 1 + (size - 1) / 2.0, 1e-3);
+
+    rolling_median_free(&rm);
+}
+
+static void test_invalid_size(void)
+{
+    rolling_median_t rm;
+    CHECK(rolling_median_init(&rm, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(rolling_median_init(&rm, MEDIAN_FILTER_MAX_WINDOW + 1) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_hampel(void)
+{
+    hampel_filter_t filter;
+    CHECK(hampel_init(&filter, 15, 3.0f, 0.1f) == ESP_OK);
+
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK(hampel_push(&filter, 20.0f + 0.05f * (i % 3)));
+    }
+    CHECK(!hampel_push(&filter, 80.0f));
+    CHECK(!hampel_push(&filter, NAN));
+    CHECK(hampel_push(&filter, 20.05f));
+    CHECK(filter.accepted == 101);
+    CHECK(filter.rejected == 2);
+
+    hampel_free(&filter);
+}
+
+int main(void)
+{
+    static const uint16_t sizes[] = {1, 2, 3, 4, 5, 8, 15, 16, 63, 64, 1023, MEDIAN_FILTER_MAX_WINDOW};
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        test_against_sort(sizes[i]);
+        test_monotonic(sizes[i]);
+    }
+    test_invalid_size();
+    test_hampel();
+
+    printf("median filter: ok\n");
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "test.h"
+#include "metrics.h"
+
+#define WRITERS 4
+#define WRITER_UPDATES 100000
+
+static metric_t *shared_counter;
+static metric_t *shared_histogram;
+
+static void test_registration(void)
+{
+    metric_t *counter = metrics_counter("test.counter");
+    CHECK(counter != NULL);
+    CHECK(metrics_counter("test.counter") == counter);
+    CHECK(metrics_find("test.counter") == counter);
+    CHECK(metrics_find("test.missing") == NULL);
+
+    // a name keeps its kind
+    CHECK(metrics_gauge("test.counter") == NULL);
+
+    static const uint32_t too_many[METRICS_HISTOGRAM_BUCKETS + 1] = {0};
+    CHECK(metrics_histogram("test.empty", too_many, 0) == NULL);
+    CHECK(metrics_histogram("test.wide", too_many, METRICS_HISTOGRAM_BUCKETS + 1) == NULL);
+
+    // updates of a failed registration are ignored
+    metrics_add(NULL, 1);
+    metrics_set(NULL, 1.0f);
+    metrics_observe(NULL, 1);
+}
+
+static void test_updates(void)
+{
+    metric_t *counter = metrics_counter("test.updates");
+    CHECK(metrics_counter_value(counter) == 0);
+    metrics_add(counter, 3);
+    metrics_add(counter, 4);
+    CHECK(metrics_counter_value(counter) == 7);
+
+    metric_t *gauge = metrics_gauge("test.gauge");
+    CHECK(metrics_gauge_value(gauge) == 0.0f);
+    metrics_set(gauge, 21.5f);
+    CHECK(metrics_gauge_value(gauge) == 21.5f);
+    metrics_set(gauge, -3.25f);
+    CHECK(metrics_gauge_value(gauge) == -3.25f);
+
+    // bounds are inclusive upper limits, the last bucket takes the rest
+    static const uint32_t bounds[] = {10, 100, 1000};
+    metric_t *histogram = metrics_histogram("test.histogram", bounds, 3);
+    CHECK(histogram != NULL);
+    const uint32_t values[] = {0, 10, 11, 100, 500, 1000, 1001, UINT32_MAX};
+    const uint32_t expected[] = {2, 2, 2, 2};
+    uint64_t sum = 0;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    {
+        metrics_observe(histogram, values[i]);
+        sum += values[i];
+    }
+    for (uint8_t i = 0; i <= 3; i++)
+    {
+        CHECK(atomic_load(&histogram->buckets[i]) == expected[i]);
+    }
+    CHECK(metrics_histogram_sum(histogram) == sum);
+
+    // the sum goes past 32 bits without wrapping
+    for (int i = 0; i < 4; i++)
+    {
+        metrics_observe(histogram, UINT32_MAX);
+        sum += UINT32_MAX;
+    }
+    CHECK(sum > UINT32_MAX);
+    CHECK(metrics_histogram_sum(histogram) == sum);
+}
+
+static void *writer(void *arg)
+{
+    for (uint32_t i = 0; i < WRITER_UPDATES; i++)
+    {
+        metrics_add(shared_counter, 1);
+        metrics_observe(shared_histogram, i % 4);
+    }
+    return NULL;
+}
+
+static void test_concurrent(void)
+{
+    static const uint32_t bounds[] = {1};
+    shared_counter = metrics_counter("test.concurrent");
+    shared_histogram = metrics_histogram("test.concurrent_histogram", bounds, 1);
+
+    pthread_t threads[WRITERS];
+    for (int i = 0; i < WRITERS; i++)
+    {
+        CHECK(pthread_create(&threads[i], NULL, writer, NULL) == 0);
+    }
+    for (int i = 0; i < WRITERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    CHECK(metrics_counter_value(shared_counter) == WRITERS * WRITER_UPDATES);
+    CHECK(atomic_load(&shared_histogram->buckets[0]) == WRITERS * WRITER_UPDATES / 2);
+    CHECK(atomic_load(&shared_histogram->buckets[1]) == WRITERS * WRITER_UPDATES / 2);
+    CHECK(metrics_histogram_sum(shared_histogram) == (uint64_t)WRITERS * WRITER_UPDATES / 4 * (0 + 1 + 2 + 3));
+}
+
+static void test_json(void)
+{
+    cJSON *json = metrics_to_json();
+    CHECK(cJSON_IsObject(json));
+    CHECK(cJSON_GetArraySize(json) == (int)metrics_count());
+
+    cJSON *counter = cJSON_GetObjectItem(json, "test.updates");
+    CHECK(cJSON_IsNumber(counter) && counter->valuedouble == 7);
+
+    cJSON *gauge = cJSON_GetObjectItem(json, "test.gauge");
+    CHECK(cJSON_IsNumber(gauge) && gauge->valuedouble == -3.25);
+
+    cJSON *histogram = cJSON_GetObjectItem(json, "test.histogram");
+    CHECK(cJSON_IsObject(histogram));
+    cJSON *bounds = cJSON_GetObjectItem(histogram, "bounds");
+    cJSON *buckets = cJSON_GetObjectItem(histogram, "buckets");
+    cJSON *sum = cJSON_GetObjectItem(histogram, "sum");
+    CHECK(cJSON_IsArray(bounds) && cJSON_GetArraySize(bounds) == 3);
+    CHECK(cJSON_IsArray(buckets) && cJSON_GetArraySize(buckets) == 4);
+    CHECK(cJSON_GetArrayItem(bounds, 0)->valuedouble == 10);
+    CHECK(cJSON_GetArrayItem(bounds, 2)->valuedouble == 1000);
+    CHECK(cJSON_GetArrayItem(buckets, 3)->valuedouble == 6);
+    CHECK(cJSON_IsNumber(sum));
+    CHECK(sum->valuedouble == (double)metrics_histogram_sum(metrics_find("test.histogram")));
+
+    // metrics come out in registration order
+    CHECK(strcmp(json->child->string, metrics_get(0)->name) == 0);
+    cJSON_Delete(json);
+}
+
+static void test_full(void)
+{
+    static char names[METRICS_MAX][16];
+    size_t registered = metrics_count();
+    for (size_t i = registered; i < METRICS_MAX; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "test.fill%zu", i);
+        CHECK(metrics_counter(names[i]) != NULL);
+    }
+    CHECK(metrics_count() == METRICS_MAX);
+    CHECK(metrics_counter("test.overflow") == NULL);
+    CHECK(metrics_get(METRICS_MAX) == NULL);
+
+    // existing metrics are still found
+    CHECK(metrics_counter("test.updates") != NULL);
+}
+
+int main(void)
+{
+    test_registration();
+    test_updates();
+    test_concurrent();
+    test_json();
+    test_full();
+    printf("metrics: ok\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "test.h"
+#include "pid.h"
+
+#define DT 0.1f
+
+// first order plant, the tec moves the bottle temperature towards ambient plus gain times output
+typedef struct
+{
+    float temperature;
+    float ambient;
+    float gain;
+    float time_constant;
+} plant_t;
+
+static float plant_step(plant_t *plant, float output, float dt)
+{
+    float target = plant->ambient + plant->gain * output;
+    plant->temperature += (target - plant->temperature) * dt / plant->time_constant;
+    return plant->temperature;
+}
+
+static void test_terms(void)
+{
+    const pid_config_t config = {.kp = 2.0f, .ki = 0.5f, .kd = 0.0f, .output_min = -100.0f, .output_max = 100.0f};
+    pid_controller_t pid;
+    pid_init(&pid, &config);
+
+    // proportional plus one step of integral
+    CHECK_NEAR(pid_update(&pid, 10.0f, 8.0f, DT), 2.0 * 2.0 + 0.5 * 2.0 * DT, 1e-5);
+    CHECK_NEAR(pid_update(&pid, 10.0f, 8.0f, DT), 2.0 * 2.0 + 0.5 * 2.0 * 2 * DT, 1e-5);
+
+    // no time passed, nothing changes
+    float output = pid.output;
+    CHECK(pid_update(&pid, 10.0f, 0.0f, 0.0f) == output);
+    CHECK(pid_update(&pid, 10.0f, 0.0f, -1.0f) == output);
+
+    pid_reset(&pid);
+    CHECK(pid.integral == 0.0f && pid.output == 0.0f && !pid.primed);
+}
+
+static void test_derivative_on_measurement(void)
+{
+    const pid_config_t config = {.kp = 0.0f, .ki = 0.0f, .kd = 1.0f, .output_min = -100.0f, .output_max = 100.0f};
+    pid_controller_t pid;
+    pid_init(&pid, &config);
+
+    // the first update has no history, a setpoint step does not kick the output
+    CHECK(pid_update(&pid, 20.0f, 10.0f, DT) == 0.0f);
+    CHECK(pid_update(&pid, 30.0f, 10.0f, DT) == 0.0f);
+
+    // a rising measurement pushes back
+    CHECK_NEAR(pid_update(&pid, 30.0f, 10.5f, DT), -0.5 / DT, 1e-4);
+}
+
+static void test_anti_windup(void)
+{
+    const pid_config_t config = {.kp = 10.0f, .ki = 2.0f, .kd = 0.0f, .output_min = -100.0f, .output_max = 100.0f};
+    pid_controller_t pid;
+    pid_init(&pid, &config);
+
+    // a large error held for a long time saturates the output but not the integral
+    for (int i = 0; i < 1000; i++)
+    {
+        CHECK(pid_update(&pid, 40.0f, 20.0f, DT) == 100.0f);
+    }
+    CHECK(pid.integral <= config.output_max);
+    float integral = pid.integral;
+
+    // once the error reverses the output leaves the limit at once instead of unwinding for minutes
+    float output = pid_update(&pid, 40.0f, 41.0f, DT);
+    CHECK(output < 100.0f);
+    CHECK(pid.integral < integral);
+
+    // the same at the lower limit
+    pid_reset(&pid);
+    for (int i = 0; i < 1000; i++)
+    {
+        CHECK(pid_update(&pid, 0.0f, 20.0f, DT) == -100.0f);
+    }
+    CHECK(pid.integral >= config.output_min);
+    CHECK(pid_update(&pid, 0.0f, -1.0f, DT) > -100.0f);
+}
+
+static void test_slew(void)
+{
+    const pid_config_t config = {.kp = 50.0f, .ki = 0.0f, .kd = 0.0f, .output_min = -100.0f, .output_max = 100.0f, .slew_rate = 20.0f};
+    pid_controller_t pid;
+    pid_init(&pid, &config);
+
+    // a setpoint step ramps the output at the slew rate
+    float previous = 0.0f;
+    int steps = 0;
+    while (previous < 100.0f)
+    {
+        float output = pid_update(&pid, 10.0f, 0.0f, DT);
+        CHECK(output - previous <= config.slew_rate * DT + 1e-4f);
+        previous = output;
+        steps++;
+        CHECK(steps <= 100);
+    }
+    CHECK(steps == 50);
+
+    // reversing the direction is limited just the same
+    float output = pid_update(&pid, -10.0f, 0.0f, DT);
+    CHECK_NEAR(output, 100.0f - config.slew_rate * DT, 1e-4);
+}
+
+// closed loop against the plant: settles on the setpoint without overshooting the limits
+static void test_closed_loop(void)
+{
+    const pid_config_t config = {.kp = 20.0f, .ki = 1.0f, .kd = 0.0f, .output_min = -100.0f, .output_max = 100.0f, .slew_rate = 50.0f};
+    pid_controller_t pid;
+    pid_init(&pid, &config);
+    plant_t plant = {.temperature = 20.0f, .ambient = 20.0f, .gain = 0.2f, .time_constant = 60.0f};
+
+    float peak = 0.0f;
+    float measurement = plant.temperature;
+    for (int i = 0; i < 20 * 60 * 10; i++)
+    {
+        float output = pid_update(&pid, 30.0f, measurement, DT);
+        CHECK(output >= config.output_min && output <= config.output_max);
+        measurement = plant_step(&plant, output, DT);
+        peak = fmaxf(peak, measurement);
+    }
+    CHECK_NEAR(measurement, 30.0, 0.05);
+    CHECK(peak < 31.0f);
+}
+
+int main(void)
+{
+    test_terms();
+    test_derivative_on_measurement();
+    test_anti_windup();
+    test_slew();
+    test_closed_loop();
+    printf("pid: ok\n");
+    return 0;
+}
@@ -0,0 +1,21 @@
+#include <stdint.h>
+
+#include "test.h"
+#include "sensirion_crc.h"
+
+int main(void)
+{
+    // examples from the sht3x and scd4x datasheets
+    const uint8_t beef[] = {0xbe, 0xef};
+    const uint8_t zero[] = {0x00, 0x00};
+    CHECK(sensirion_crc8(beef, 2) == 0x92);
+    CHECK(sensirion_crc8(zero, 2) == 0x81);
+
+    // a word followed by its own crc checks to zero
+    const uint8_t word[] = {0x66, 0x67, sensirion_crc8((const uint8_t[]){0x66, 0x67}, 2)};
+    CHECK(word[2] == 0xa2);
+    CHECK(sensirion_crc8(word, 3) == 0x00);
+
+    printf("sensirion crc: ok\n");
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "test.h"
+#include "series.h"
+
+typedef float (*signal_t)(uint32_t index);
+typedef uint32_t (*interval_t)(uint32_t index);
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+// sht3x temperature: slow drift quantised to the sensor resolution of 175 / 65535
+static float temperature(uint32_t index)
+{
+    uint16_t raw = (uint16_t)(26000 + 40.0 * sin(index * 0.01) + next_random() % 3);
+    return -45.0f + 175.0f * ((float)raw / 65535.0f);
+}
+
+static float constant(uint32_t index)
+{
+    (void)index;
+    return 21.5f;
+}
+
+static float noise(uint32_t index)
+{
+    (void)index;
+    uint32_t bits = next_random() << 8 | (next_random() & 0xff);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t regular(uint32_t index)
+{
+    (void)index;
+    return 100;
+}
+
+// task jitter of a few ms and an occasional long gap
+static uint32_t jittered(uint32_t index)
+{
+    if (index % 97 == 0)
+    {
+        return 60000 + next_random() % 5000;
+    }
+    return 98 + next_random() % 5;
+}
+
+static uint32_t irregular(uint32_t index)
+{
+    (void)index;
+    return next_random() % 100000;
+}
+
+// fills one block and checks that every sample decodes bit exact, returns the compression ratio
+static double round_trip(signal_t signal, interval_t interval, uint32_t start)
+{
+    static uint32_t timestamps[SERIES_BLOCK_BYTES * 8];
+    static float values[SERIES_BLOCK_BYTES * 8];
+
+    series_block_t block;
+    series_block_reset(&block, "Test");
+
+    uint32_t timestamp = start;
+    uint16_t count = 0;
+    while (1)
+    {
+        timestamps[count] = timestamp;
+        values[count] = signal(count);
+        if (!series_block_append(&block, timestamps[count], values[count]))
+        {
+            break;
+        }
+        count++;
+        timestamp += interval(count);
+    }
+    CHECK(block.count == count);
+    CHECK(series_block_size(&block) <= SERIES_BLOCK_BYTES);
+
+    series_decoder_t decoder;
+    series_decoder_init(&decoder, block.data, series_block_size(&block), block.count);
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint32_t decoded_timestamp;
+        float decoded_value;
+        CHECK(series_decoder_next(&decoder, &decoded_timestamp, &decoded_value));
+        CHECK(decoded_timestamp == timestamps[i]);
+        CHECK(memcmp(&decoded_value, &values[i], sizeof(float)) == 0);
+    }
+
+    uint32_t unused_timestamp;
+    float unused_value;
+    CHECK(!series_decoder_next(&decoder, &unused_timestamp, &unused_value));
+
+    // raw samples are a 32 bit timestamp and a 32 bit float
+    return (double)count * 8 / series_block_size(&block);
+}
+
+static void test_special_values(void)
+{
+    const float specials[] = {0.0f, -0.0f, INFINITY, -INFINITY, NAN, 1e-40f, -3.4e38f, 0.0f};
+
+    series_block_t block;
+    series_block_reset(&block, "Test");
+    for (uint16_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++)
+    {
+        CHECK(series_block_append(&block, 1000 + i, specials[i]));
+    }
+
+    series_decoder_t decoder;
+    series_decoder_init(&decoder, block.data, series_block_size(&block), block.count);
+    for (uint16_t i = 0; i < block.count; i++)
+    {
+        uint32_t timestamp;
+        float value;
+        CHECK(series_decoder_next(&decoder, &timestamp, &value));
+        CHECK(timestamp == 1000u + i);
+        CHECK(memcmp(&value, &specials[i], sizeof(float)) == 0);
+    }
+}
+
+int main(void)
+{
+    double ratio = round_trip(temperature, jittered, 1700000000);
+    printf("temperature, jittered: %.2f\n", ratio);
+    CHECK(ratio > 2.5);
+
+    ratio = round_trip(constant, regular, 0);
+    printf("constant, regular: %.2f\n", ratio);
+    CHECK(ratio > 20.0);
+
+    // incompressible input still has to fit and decode
+    ratio = round_trip(noise, irregular, UINT32_MAX - 1000000);
+    printf("noise, irregular: %.2f\n", ratio);
+    CHECK(ratio > 0.7);
+
+    test_special_values();
+
+    printf("series: ok\n");
+    return 0;
+}
@@ -1,3 +1,5 @@
+const fs = require('fs');
+const path = require('path');
 const express = require('express');
 const multer = require('multer');
 const app = express();
@@ -15,20 +17,134 @@ const upload = multer({storage: storage});
 
 app.use(express.json());
 
+// decoder for the Gorilla style compressed sample blocks, see main/src/series.c
+function decodeSeries(buffer, count) {
+  let bitPos = 0;
+  const readBits = (bits) => {
+    let value = 0;
+    for (let i = 0; i < bits; i++) {
+      const byte = buffer[bitPos >> 3] || 0;
+      value = ((value << 1) | ((byte >> (7 - (bitPos & 7))) & 1)) >>> 0;
+      bitPos++;
+    }
+    return value;
+  };
+  const toFloat = (bits) => {
+    const view = new DataView(new ArrayBuffer(4));
+    view.setUint32(0, bits);
+    return view.getFloat32(0);
+  };
+
+  const samples = [];
+  let timestamp = 0;
+  let delta = 0;
+  let value = 0;
+  let leading = 0;
+  let trailing = 0;
+
+  for (let i = 0; i < count; i++) {
+    if (i === 0) {
+      timestamp = readBits(32);
+      value = readBits(32);
+    } else {
+      let dod;
+      if (readBits(1) === 0) {
+        dod = 0;
+      } else if (readBits(1) === 0) {
+        dod = readBits(7) - 63;
+      } else if (readBits(1) === 0) {
+        dod = readBits(9) - 255;
+      } else if (readBits(1) === 0) {
+        dod = readBits(12) - 2047;
+      } else {
+        dod = readBits(32) | 0;
+      }
+      delta = (delta + dod) | 0;
+      timestamp = (timestamp + delta) >>> 0;
+
+      if (readBits(1) === 1) {
+        if (readBits(1) === 1) {
+          leading = readBits(5);
+          trailing = 32 - leading - (readBits(5) + 1);
+        }
+        const meaningful = 32 - leading - trailing;
+        value = (value ^ (readBits(meaningful) << trailing)) >>> 0;
+      }
+    }
+    if (bitPos > buffer.length * 8) {
+      throw new Error('truncated series block');
+    }
+    samples.push({timestamp, value: toFloat(value)});
+  }
+  return samples;
+}
+
 app.post('/api/v1/measurement', (req, res) => {
   const device_id = req.header('Device-Id');
   const timestamp = req.header('Timestamp');
-  const {measurement_type, value} = req.body;
 
-  console.log('measurement', device_id, timestamp, measurement_type, value)
+  // one record holds every channel read from the same acquisition
+  const {values} = req.body;
+  if (!Array.isArray(values) || values.length === 0) {
+    return res.status(400).send('Invalid request');
+  }
+
+  for (const entry of values) {
+    const {
+      measurement_type,
+      value,
+      count,
+      min,
+      max,
+      variance,
+      rejected,
+      suppressed,
+    } = entry;
+
+    console.log(
+        'measurement', device_id, timestamp, measurement_type, value,
+        {count, min, max, variance, rejected, suppressed});
+  }
 
   res.send({state: 'success'});
 });
 
+app.post(
+    '/api/v1/series',
+    express.raw({type: 'application/octet-stream', limit: '64kb'}),
+    (req, res) => {
+      const device_id = req.header('Device-Id');
+      const measurement_type = req.header('Measurement-Type');
+      const count = parseInt(req.header('Sample-Count'));
+
+      if (!device_id || !measurement_type || !(count > 0) ||
+          !Buffer.isBuffer(req.body)) {
+        return res.status(400).send('Invalid request');
+      }
+
+      let samples;
+      try {
+        samples = decodeSeries(req.body, count);
+      } catch (err) {
+        return res.status(422).send(err.message);
+      }
+
+      // raw size is a 32 bit timestamp and a 32 bit float per sample
+      const ratio = (count * 8) / req.body.length;
+      console.log(
+          'series', device_id, measurement_type, count, 'samples',
+          req.body.length, 'bytes', 'ratio', ratio.toFixed(2),
+          samples[0], samples[samples.length - 1]);
+
+      res.send({state: 'success'});
+    });
+
 app.post('/api/v1/image', upload.single('image'), async (req, res) => {
   const device_id = req.header('Device-Id');
   const timestamp = req.header('Timestamp');
   const image_mime = req.header('Form-Mime');
+  // roi, thumbnail or full, older firmware only sends full frames
+  const image_kind = req.header('Image-Kind') || 'full';
 
   if (!req.file) {
     return res.status(400).send('No files were uploaded.');
@@ -37,10 +153,140 @@ app.post('/api/v1/image', upload.single('image'), async (req, res) => {
     return res.status(400).send('Invalid request');
   }
 
-  console.log('image', device_id, timestamp, image_mime);
+  console.log('image', device_id, timestamp, image_mime, image_kind, req.file.size);
+  res.send({state: 'success'});
+});
+
+// periodic metrics export, see main/src/stats.c
+app.post('/api/v1/metrics', (req, res) => {
+  const device_id = req.header('Device-Id');
+  const {timestamp, tasks, metrics, pm_locks} = req.body;
+
+  if (!device_id || !Array.isArray(tasks) || typeof metrics !== 'object') {
+    return res.status(400).send('Invalid request');
+  }
+
+  console.log('metrics', device_id, timestamp);
+  for (const task of tasks) {
+    console.log(
+        '  task', task.name, task.cpu >= 0 ? task.cpu.toFixed(2) + '%' : 'new',
+        'stack free', task.stack_free);
+  }
+  for (const [name, value] of Object.entries(metrics)) {
+    console.log('  metric', name, JSON.stringify(value));
+  }
+  if (pm_locks) {
+    console.log(pm_locks);
+  }
+
   res.send({state: 'success'});
 });
 
+// resumable image uploads, see post_image in main/src/sensors/camera.c
+// partial images live on disk, a restarted server resumes where it stopped
+const partialDir = path.join('uploads', 'partial');
+fs.mkdirSync(partialDir, {recursive: true});
+
+// chance of losing a chunk, e.g. LOSS_RATE=0.2 node app.js
+// half the losses drop the chunk, the other half store it but drop the ack
+const lossRate = parseFloat(process.env.LOSS_RATE || '0');
+
+const completed = new Map(); // upload id -> length
+const uploadStats = new Map(); // upload id -> {received, duplicate, lost}
+
+const validUploadId = (id) => typeof id === 'string' && /^[\w.-]+$/.test(id);
+const partialPath = (id) => path.join(partialDir, id);
+const committedBytes = (id) => {
+  if (completed.has(id)) {
+    return completed.get(id);
+  }
+  try {
+    return fs.statSync(partialPath(id)).size;
+  } catch (err) {
+    return 0;
+  }
+};
+
+app.get('/api/v1/image/chunk/:id', (req, res) => {
+  const id = req.params.id;
+  if (!validUploadId(id)) {
+    return res.status(400).send('Invalid upload id');
+  }
+  if (!completed.has(id) && !fs.existsSync(partialPath(id))) {
+    return res.status(404).send({offset: 0});
+  }
+  res.send({offset: committedBytes(id)});
+});
+
+app.post(
+    '/api/v1/image/chunk',
+    express.raw({type: 'application/octet-stream', limit: '1mb'}),
+    (req, res) => {
+      const device_id = req.header('Device-Id');
+      const timestamp = req.header('Timestamp');
+      const image_mime = req.header('Form-Mime');
+      const image_kind = req.header('Image-Kind') || 'full';
+      const id = req.header('Upload-Id');
+      const offset = parseInt(req.header('Upload-Offset'));
+      const length = parseInt(req.header('Upload-Length'));
+
+      if (!device_id || !timestamp || !image_mime || !validUploadId(id) ||
+          !(offset >= 0) || !(length > 0) || !Buffer.isBuffer(req.body) ||
+          offset + req.body.length > length) {
+        return res.status(400).send('Invalid request');
+      }
+
+      const stats = uploadStats.get(id) || {received: 0, duplicate: 0, lost: 0};
+      uploadStats.set(id, stats);
+      stats.received += req.body.length;
+
+      if (completed.has(id)) {
+        stats.duplicate += req.body.length;
+        return res.send({offset: length, state: 'complete'});
+      }
+
+      let lostAck = false;
+      if (Math.random() < lossRate) {
+        stats.lost++;
+        if (Math.random() < 0.5) {
+          return req.socket.destroy();
+        }
+        lostAck = true;
+      }
+
+      // a gap can not be filled later, the device has to continue from here
+      let committed = committedBytes(id);
+      if (offset > committed) {
+        return res.status(409).send({offset: committed});
+      }
+
+      // whatever overlaps the stored bytes was sent before
+      const overlap = Math.min(committed - offset, req.body.length);
+      stats.duplicate += overlap;
+      if (overlap < req.body.length) {
+        fs.appendFileSync(partialPath(id), req.body.subarray(overlap));
+        committed += req.body.length - overlap;
+      }
+
+      if (committed >= length) {
+        const file = path.join('uploads', Date.now() + '-' + id + '.jpg');
+        fs.renameSync(partialPath(id), file);
+        completed.set(id, length);
+        console.log(
+            'image', device_id, timestamp, image_mime, image_kind, length,
+            'bytes', 'received', stats.received, 'duplicate', stats.duplicate,
+            'lost chunks', stats.lost);
+      }
+
+      if (lostAck) {
+        return req.socket.destroy();
+      }
+      if (committed >= length) {
+        return res.send({offset: committed, state: 'complete'});
+      }
+      res.send({offset: committed});
+    });
+
 const port = 8080;
 app.listen(port, () => {
   console.log('listening on', port);
@@ -0,0 +1,88 @@
+// uploads a random image the way the device does and counts the retransmitted bytes
+// start the server with loss injection first: LOSS_RATE=0.2 node app.js
+const http = require('http');
+const crypto = require('crypto');
+
+const host = process.env.HOST || 'localhost';
+const port = 8080;
+const imageSize = parseInt(process.env.IMAGE_SIZE || '153600');
+const chunkSize = 32 * 1024; // RESUMABLE_CHUNK_SIZE
+const maxRetries = 20;
+
+function request(method, path, headers, body) {
+  return new Promise((resolve, reject) => {
+    const req = http.request({host, port, method, path, headers}, (res) => {
+      let data = '';
+      res.on('data', (part) => data += part);
+      res.on('end', () => {
+        try {
+          resolve({status: res.statusCode, body: JSON.parse(data)});
+        } catch (err) {
+          reject(err);
+        }
+      });
+    });
+    req.on('error', reject);
+    req.end(body);
+  });
+}
+
+async function upload(image, id) {
+  const headers = {
+    'Device-Id': '1',
+    'Timestamp': '0',
+    'Form-Mime': 'image/jpeg',
+    'Image-Kind': 'full',
+    'Upload-Id': id,
+    'Upload-Length': String(image.length),
+    'Content-Type': 'application/octet-stream',
+  };
+
+  let offset = 0;
+  let sent = 0;
+  let retries = 0;
+
+  while (offset < image.length) {
+    const chunk = image.subarray(offset, offset + chunkSize);
+    try {
+      sent += chunk.length;
+      const res = await request(
+          'POST', '/api/v1/image/chunk',
+          {...headers, 'Upload-Offset': String(offset)}, chunk);
+      if (res.status >= 400 && res.status !== 409) {
+        throw new Error('status ' + res.status);
+      }
+      offset = res.body.offset;
+    } catch (err) {
+      if (++retries > maxRetries) {
+        throw err;
+      }
+      try {
+        const res = await request('GET', '/api/v1/image/chunk/' + id, {});
+        offset = res.body.offset;
+      } catch (err) {
+        // keep the own offset, the next chunk reports any gap
+      }
+    }
+  }
+
+  return {sent, retries};
+}
+
+(async () => {
+  const image = crypto.randomBytes(imageSize);
+  const runs = parseInt(process.env.RUNS || '20');
+  let sent = 0;
+  let retries = 0;
+
+  for (let i = 0; i < runs; i++) {
+    const result = await upload(image, 'loss-test-' + Date.now() + '-' + i);
+    sent += result.sent;
+    retries += result.retries;
+  }
+
+  const resent = sent - runs * image.length;
+  console.log(
+      runs, 'uploads of', image.length, 'bytes,', retries, 'retries,', resent,
+      'bytes retransmitted', (100 * resent / (runs * image.length)).toFixed(1) + '%');
+})();